@@ -24,6 +24,7 @@ enum wlc_backend_type {
    WLC_BACKEND_NONE,
    WLC_BACKEND_DRM,
    WLC_BACKEND_X11,
+   WLC_BACKEND_HEADLESS,
 };
 
 /** mask in wlc_event_loop_add_fd(); */
@@ -301,15 +302,43 @@ const struct wlc_size* wlc_output_get_resolution(wlc_handle output);
 /** Set resolution. */
 WLC_NONULL void wlc_output_set_resolution(wlc_handle output, const struct wlc_size *resolution);
 
+/**
+ * Place output in the global layout. Views reaching over the edge of their output are painted on the overlapping
+ * outputs of the layout as well, below their own views. Outputs that are not placed only paint their own views.
+ */
+WLC_NONULL void wlc_output_set_position(wlc_handle output, const struct wlc_origin *origin);
+
+/** Get position in the global layout, NULL if output is not placed. */
+const struct wlc_origin* wlc_output_get_position(wlc_handle output);
+
 /** Get current visibility bitmask. */
 uint32_t wlc_output_get_mask(wlc_handle output);
 
 /** Set visibility bitmask. */
 void wlc_output_set_mask(wlc_handle output, uint32_t mask);
 
-/** Get pixels. If you return true in callback, the rgba data will be not freed. Do this if you don't want to copy the buffer. */
+/**
+ * Get pixels. If you return true in callback, the rgba data will be not freed. Do this if you don't want to copy the buffer.
+ * Pixels are read back asynchronously when the renderer supports it, so the callback may run after the next frame.
+ * Size is in pixels of the output mode, which is larger or smaller than the resolution on scaled outputs.
+ */
 WLC_NONULL void wlc_output_get_pixels(wlc_handle output, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg);
 
+/** Get pixels of geometry in output resolution coordinates, clipped to the output. Callback works as in wlc_output_get_pixels. */
+WLC_NONULLV(2,3) void wlc_output_get_pixels_region(wlc_handle output, const struct wlc_geometry *geometry, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg);
+
+/**
+ * Stream frames to callback until wlc_output_stop_capture, replacing earlier capture of the output.
+ * Callback is called after each repaint that changed something, damage lists the rectangles changed since previous frame.
+ * rgba holds the whole output, rows as in wlc_output_get_pixels, and stays valid until two more frames have been delivered.
+ * Size and damage are in pixels of the output mode, as with wlc_output_get_pixels.
+ * Only damaged areas are read back from the renderer.
+ */
+WLC_NONULLV(2) bool wlc_output_start_capture(wlc_handle output, void (*frame)(const struct wlc_size *size, const uint8_t *rgba, const struct wlc_geometry *damage, size_t memb, void *arg), void *arg);
+
+/** Stop capture started with wlc_output_start_capture. */
+void wlc_output_stop_capture(wlc_handle output);
+
 /** Get views in stack order. Returned array is a direct reference, careful when moving and destroying handles. */
 const wlc_handle* wlc_output_get_views(wlc_handle output, size_t *out_memb);
 
@@ -11,51 +11,67 @@
 #include "resources/types/region.h"
 #include "resources/types/surface.h"
 
+// Container of wl_subsurface, surface stops being a sub-surface with it
+struct subsurface {
+   wlc_resource surface;
+};
+
+static void
+subsurface_release(struct subsurface *subsurface)
+{
+   assert(subsurface);
+   wlc_surface_set_parent(convert_from_wlc_resource(subsurface->surface, WLC_TYPE_SURFACE), NULL);
+}
+
 static void
 wl_cb_subsurface_set_position(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y)
 {
-   (void)client, (void)resource, (void)x, (void)y;
-   STUBL(resource);
+   (void)client;
+
+   struct wlc_surface *surface;
+   if (!(surface = convert_from_wlc_resource((wlc_resource)wl_resource_get_user_data(resource), WLC_TYPE_SURFACE)))
+      return;
+
+   surface->tree.pending_position = (struct wlc_origin){ x, y };
+}
+
+static void
+subsurface_place(struct wl_resource *resource, struct wl_resource *sibling_resource, bool above)
+{
+   struct wlc_surface *surface;
+   if (!(surface = convert_from_wlc_resource((wlc_resource)wl_resource_get_user_data(resource), WLC_TYPE_SURFACE)))
+      return;
+
+   if (!wlc_surface_place_subsurface(surface, convert_from_wl_resource(sibling_resource, WLC_TYPE_SURFACE), above))
+      wl_resource_post_error(resource, WL_SUBSURFACE_ERROR_BAD_SURFACE, "wl_surface@%d is not a sibling or the parent", wl_resource_get_id(sibling_resource));
 }
 
 static void
 wl_cb_subsurface_place_above(struct wl_client *client, struct wl_resource *resource, struct wl_resource *sibling_resource)
 {
-   (void)client, (void)resource, (void)sibling_resource;
-   STUBL(resource);
+   (void)client;
+   subsurface_place(resource, sibling_resource, true);
 }
 
 static void
 wl_cb_subsurface_place_below(struct wl_client *client, struct wl_resource *resource, struct wl_resource *sibling_resource)
 {
-   (void)client, (void)resource, (void)sibling_resource;
-   STUBL(resource);
+   (void)client;
+   subsurface_place(resource, sibling_resource, false);
 }
 
 static void
 wl_cb_subsurface_set_sync(struct wl_client *client, struct wl_resource *resource)
 {
    (void)client;
-
-   struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource((wlc_resource)wl_resource_get_user_data(resource), "surface")))
-      return;
-
-   if (surface)
-      surface->synchronized = true;
+   wlc_surface_set_synchronized(convert_from_wlc_resource((wlc_resource)wl_resource_get_user_data(resource), WLC_TYPE_SURFACE), true);
 }
 
 static void
 wl_cb_subsurface_set_desync(struct wl_client *client, struct wl_resource *resource)
 {
    (void)client;
-
-   struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource((wlc_resource)wl_resource_get_user_data(resource), "surface")))
-      return;
-
-   if (surface)
-      surface->synchronized = false;
+   wlc_surface_set_synchronized(convert_from_wlc_resource((wlc_resource)wl_resource_get_user_data(resource), WLC_TYPE_SURFACE), false);
 }
 
 static const struct wl_subsurface_interface wl_subsurface_implementation = {
@@ -82,12 +98,33 @@ wl_cb_subcompositor_get_subsurface(struct wl_client *client, struct wl_resource
       return;
    }
 
+   struct wlc_surface *s, *p;
+   if (!(s = convert_from_wlc_resource(surface, WLC_TYPE_SURFACE)) || !(p = convert_from_wlc_resource(parent, WLC_TYPE_SURFACE)))
+      return;
+
+   if (s->parent) {
+      wl_resource_post_error(resource, WL_SUBCOMPOSITOR_ERROR_BAD_SURFACE, "wl_surface@%d is already a sub-surface", wl_resource_get_id(surface_resource));
+      return;
+   }
+
+   for (struct wlc_surface *a = p; a; a = convert_from_wlc_resource(a->parent, WLC_TYPE_SURFACE)) {
+      if (a != s)
+         continue;
+
+      wl_resource_post_error(resource, WL_SUBCOMPOSITOR_ERROR_BAD_SURFACE, "wl_surface@%d is an ancestor of its parent", wl_resource_get_id(surface_resource));
+      return;
+   }
+
    wlc_resource r;
    if (!(r = wlc_resource_create(&compositor->subsurfaces, client, &wl_subsurface_interface, wl_resource_get_version(resource), 1, id)))
       return;
 
    wlc_resource_implement(r, &wl_subsurface_implementation, (void*)surface);
-   wlc_surface_set_parent(convert_from_wlc_resource(surface, "surface"), convert_from_wlc_resource(parent, "surface"));
+   ((struct subsurface*)convert_from_wlc_resource(r, WLC_TYPE_SUBSURFACE))->surface = surface;
+
+   // Sub-surfaces start synchronized
+   s->synchronized = true;
+   wlc_surface_set_parent(s, p);
 }
 
 static void
@@ -125,7 +162,7 @@ wl_cb_surface_create(struct wl_client *client, struct wl_resource *resource, uin
 
    wlc_resource_implement(r, wlc_surface_implementation(), compositor);
 
-   struct wlc_surface_event ev = { .surface = convert_from_wlc_resource(r, "surface"), .type = WLC_SURFACE_EVENT_CREATED };
+   struct wlc_surface_event ev = { .surface = convert_from_wlc_resource(r, WLC_TYPE_SURFACE), .type = WLC_SURFACE_EVENT_CREATED };
    wl_signal_emit(&wlc_system_signals()->surface, &ev);
 }
 
@@ -186,7 +223,7 @@ deactivate_tty(struct wlc_compositor *compositor)
 
    // check that all outputs are surfaceless
    struct wlc_output *o;
-   chck_pool_for_each(&compositor->outputs.pool, o) {
+   wlc_slab_for_each(&compositor->outputs.pool, o) {
       if (o->bsurface.display)
          return;
    }
@@ -220,14 +257,14 @@ activate_event(struct wl_listener *listener, void *data)
    if (!ev->active) {
       compositor->state.tty = DEACTIVATING;
       compositor->state.vt = ev->vt;
-      chck_pool_for_each_call(&compositor->outputs.pool, wlc_output_set_backend_surface, NULL);
+      wlc_slab_for_each_call(&compositor->outputs.pool, wlc_output_set_backend_surface, NULL);
       deactivate_tty(compositor);
    } else {
       compositor->state.tty = ACTIVATING;
       compositor->state.vt = 0;
       activate_tty(compositor);
       wlc_backend_update_outputs(&compositor->backend, &compositor->outputs.pool);
-      chck_pool_for_each_call(&compositor->outputs.pool, wlc_output_set_sleep_ptr, false);
+      wlc_slab_for_each_call(&compositor->outputs.pool, wlc_output_set_sleep_ptr, false);
    }
 }
 
@@ -274,13 +311,13 @@ attach_surface_to_view_or_create(struct wlc_compositor *compositor, struct wlc_s
       &view->xdg_surface,
    };
 
-   const char *name[WLC_SHELL_SURFACE_TYPE_LAST] = {
-      "shell-surface",
-      "xdg-surface",
+   const enum wlc_type types[WLC_SHELL_SURFACE_TYPE_LAST] = {
+      WLC_TYPE_SHELL_SURFACE,
+      WLC_TYPE_XDG_SURFACE,
    };
 
    *res[type] = shell_surface;
-   wl_resource_set_user_data(wl_resource_from_wlc_resource(shell_surface, name[type]), (void*)convert_to_wlc_handle(view));
+   wl_resource_set_user_data(wl_resource_from_wlc_resource(shell_surface, types[type]), (void*)convert_to_wlc_handle(view));
 }
 
 static void
@@ -294,9 +331,9 @@ attach_popup_to_view_or_create(struct wlc_compositor *compositor, struct wlc_sur
 
    view->xdg_popup = resource;
    view->pending.geometry.origin = *origin;
-   wlc_view_set_parent_ptr(view, convert_from_wlc_handle(parent->view, "view"));
+   wlc_view_set_parent_ptr(view, convert_from_wlc_handle(parent->view, WLC_TYPE_VIEW));
    wlc_view_set_type_ptr(view, WLC_BIT_POPUP, true);
-   wl_resource_set_user_data(wl_resource_from_wlc_resource(resource, "xdg-popup"), (void*)convert_to_wlc_handle(view));
+   wl_resource_set_user_data(wl_resource_from_wlc_resource(resource, WLC_TYPE_XDG_POPUP), (void*)convert_to_wlc_handle(view));
 }
 
 static void
@@ -318,16 +355,12 @@ surface_event(struct wl_listener *listener, void *data)
       case WLC_SURFACE_EVENT_DESTROYED:
       {
          struct wlc_view *v;
-         chck_pool_for_each(&compositor->views.pool, v) {
+         wlc_slab_for_each(&compositor->views.pool, v) {
             if (v->parent == ev->surface->view)
                wlc_view_set_parent_ptr(v, NULL);
          }
 
-         struct wlc_surface *s;
-         chck_pool_for_each(&compositor->surfaces.pool, s) {
-            if (s->parent == convert_to_wlc_resource(ev->surface))
-               wlc_surface_set_parent(s, NULL);
-         }
+         // Sub-surfaces are unlinked by wlc_surface_release
       }
       break;
 
@@ -339,7 +372,7 @@ static struct wlc_output*
 get_surfaceless_output(struct wlc_compositor *compositor)
 {
    struct wlc_output *o;
-   chck_pool_for_each(&compositor->outputs.pool, o) {
+   wlc_slab_for_each(&compositor->outputs.pool, o) {
       if (!o->bsurface.display)
          return o;
    }
@@ -359,7 +392,7 @@ active_output(struct wlc_compositor *compositor, struct wlc_output *output)
    if (compositor->active.output)
       WLC_INTERFACE_EMIT(output.focus, compositor->active.output, false);
 
-   wlc_output_schedule_repaint(convert_from_wlc_handle(compositor->active.output, "output"));
+   wlc_output_schedule_repaint(convert_from_wlc_handle(compositor->active.output, WLC_TYPE_OUTPUT));
    compositor->active.output = convert_to_wlc_handle(output);
 
    if (compositor->active.output) {
@@ -382,6 +415,7 @@ add_output(struct wlc_compositor *compositor, struct wlc_backend_surface *bsurfa
       return;
    }
 
+   output->layout.outputs = &compositor->layout;
    wlc_output_set_information(output, info);
    wlc_output_set_backend_surface(output, bsurface);
 
@@ -403,7 +437,7 @@ remove_output(struct wlc_compositor *compositor, struct wlc_output *output)
    assert(compositor && output);
 
    struct wlc_output *o, *alive = NULL;
-   chck_pool_for_each(&compositor->outputs.pool, o) {
+   wlc_slab_for_each(&compositor->outputs.pool, o) {
       if (!o->bsurface.display || o == output)
          continue;
 
@@ -451,6 +485,7 @@ output_event(struct wl_listener *listener, void *data)
          break;
 
       case WLC_OUTPUT_EVENT_SURFACE:
+         wlc_dmabuf_update(&compositor->dmabuf);
          respond_tty_activate(compositor);
          break;
    }
@@ -476,11 +511,11 @@ struct wlc_view*
 wlc_compositor_view_for_surface(struct wlc_compositor *compositor, struct wlc_surface *surface)
 {
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle(surface->view, "view")) && !(view = wlc_handle_create(&compositor->views)))
+   if (!(view = convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW)) && !(view = wlc_handle_create(&compositor->views)))
       return NULL;
 
    struct wlc_output *output;
-   if ((output = convert_from_wlc_handle(compositor->active.output, "output"))) {
+   if ((output = convert_from_wlc_handle(compositor->active.output, WLC_TYPE_OUTPUT))) {
       wlc_surface_attach_to_output(surface, output, wlc_surface_get_buffer(surface));
       wlc_view_set_mask_ptr(view, output->active.mask);
    }
@@ -505,18 +540,18 @@ wlc_get_outputs(size_t *out_memb)
 
    // Allocate linear array which we then return
    free(_g_compositor->tmp.outputs);
-   if (!(_g_compositor->tmp.outputs = chck_malloc_mul_of(_g_compositor->outputs.pool.items.count, sizeof(wlc_handle))))
+   if (!(_g_compositor->tmp.outputs = chck_malloc_mul_of(_g_compositor->outputs.pool.count, sizeof(wlc_handle))))
       return NULL;
 
    {
       size_t i = 0;
       struct wlc_output *o;
-      chck_pool_for_each(&_g_compositor->outputs.pool, o)
+      wlc_slab_for_each(&_g_compositor->outputs.pool, o)
          _g_compositor->tmp.outputs[i++] = convert_to_wlc_handle(o);
    }
 
    if (out_memb)
-      *out_memb = _g_compositor->outputs.pool.items.count;
+      *out_memb = _g_compositor->outputs.pool.count;
 
    return _g_compositor->tmp.outputs;
 }
@@ -589,8 +624,8 @@ wlc_compositor_terminate(struct wlc_compositor *compositor)
       wlc_log(WLC_LOG_INFO, "Terminating compositor...");
       compositor->state.terminating = true;
 
-      if (compositor->outputs.pool.items.count > 0) {
-         chck_pool_for_each_call(&compositor->outputs.pool, wlc_output_terminate);
+      if (compositor->outputs.pool.count > 0) {
+         wlc_slab_for_each_call(&compositor->outputs.pool, wlc_output_terminate);
          return;
       }
    }
@@ -605,14 +640,17 @@ wlc_compositor_is_good(struct wlc_compositor *compositor)
    assert(compositor);
 
    struct wlc_output *o;
-   chck_pool_for_each(&compositor->outputs.pool, o) {
+   wlc_slab_for_each(&compositor->outputs.pool, o) {
       if (o->context.context)
          return true;
    }
 
+   // Headless outputs may run without context, nothing is rendered then
+   if (compositor->backend.type == WLC_BACKEND_HEADLESS)
+      return true;
+
    // There were no outputs or all outputs failed context creation
    // wlc.c does this check and will return false in init
-   // XXX: Skip this check when we request headless mode
    return false;
 }
 
@@ -633,6 +671,8 @@ wlc_compositor_release(struct wlc_compositor *compositor)
    wlc_backend_release(&compositor->backend);
    wlc_shell_release(&compositor->shell);
    wlc_xdg_shell_release(&compositor->xdg_shell);
+   wlc_presentation_release(&compositor->presentation);
+   wlc_dmabuf_release(&compositor->dmabuf);
    wlc_seat_release(&compositor->seat);
 
    if (compositor->wl.subcompositor)
@@ -643,6 +683,7 @@ wlc_compositor_release(struct wlc_compositor *compositor)
 
    free(_g_compositor->tmp.outputs);
    wlc_source_release(&compositor->outputs);
+   chck_iter_pool_release(&compositor->layout);
    wlc_source_release(&compositor->views);
    wlc_source_release(&compositor->surfaces);
    wlc_source_release(&compositor->subsurfaces);
@@ -678,11 +719,12 @@ wlc_compositor(struct wlc_compositor *compositor)
    wl_signal_add(&wlc_system_signals()->output, &compositor->listener.output);
    wl_signal_add(&wlc_system_signals()->focus, &compositor->listener.focus);
 
-   if (!wlc_source(&compositor->outputs, "output", wlc_output, wlc_output_release, 4, sizeof(struct wlc_output)) ||
-       !wlc_source(&compositor->views, "view", wlc_view, wlc_view_release, 32, sizeof(struct wlc_view)) ||
-       !wlc_source(&compositor->surfaces, "surface", wlc_surface, wlc_surface_release, 32, sizeof(struct wlc_surface)) ||
-       !wlc_source(&compositor->subsurfaces, "subsurface", NULL, NULL, 32, sizeof(struct wlc_resource)) ||
-       !wlc_source(&compositor->regions, "region", NULL, wlc_region_release, 32, sizeof(struct wlc_region)))
+   if (!wlc_source(&compositor->outputs, WLC_TYPE_OUTPUT, wlc_output, wlc_output_release, 4, sizeof(struct wlc_output)) ||
+       !wlc_source(&compositor->views, WLC_TYPE_VIEW, wlc_view, wlc_view_release, 32, sizeof(struct wlc_view)) ||
+       !wlc_source(&compositor->surfaces, WLC_TYPE_SURFACE, wlc_surface, wlc_surface_release, 32, sizeof(struct wlc_surface)) ||
+       !wlc_source(&compositor->subsurfaces, WLC_TYPE_SUBSURFACE, NULL, subsurface_release, 32, sizeof(struct subsurface)) ||
+       !wlc_source(&compositor->regions, WLC_TYPE_REGION, NULL, wlc_region_release, 32, sizeof(struct wlc_region)) ||
+       !chck_iter_pool(&compositor->layout, 4, 0, sizeof(wlc_handle)))
       goto fail;
 
    if (!(compositor->wl.compositor = wl_global_create(wlc_display(), &wl_compositor_interface, 3, compositor, wl_compositor_bind)))
@@ -694,6 +736,8 @@ wlc_compositor(struct wlc_compositor *compositor)
    if (!wlc_seat(&compositor->seat) ||
        !wlc_shell(&compositor->shell) ||
        !wlc_xdg_shell(&compositor->xdg_shell) ||
+       !wlc_presentation(&compositor->presentation) ||
+       !wlc_dmabuf(&compositor->dmabuf) ||
        !wlc_backend(&compositor->backend))
       goto fail;
 
@@ -5,7 +5,10 @@
 #include <stdbool.h>
 #include <wayland-server.h>
 #include <wayland-util.h>
+#include <chck/pool/pool.h>
 #include "seat/seat.h"
+#include "dmabuf.h"
+#include "presentation.h"
 #include "shell/shell.h"
 #include "shell/xdg-shell.h"
 #include "xwayland/xwm.h"
@@ -20,9 +23,14 @@ struct wlc_compositor {
    struct wlc_seat seat;
    struct wlc_shell shell;
    struct wlc_xdg_shell xdg_shell;
+   struct wlc_presentation presentation;
+   struct wlc_dmabuf dmabuf;
    struct wlc_xwm xwm;
    struct wlc_source outputs, views, surfaces, subsurfaces, regions;
 
+   // Outputs placed with wlc_output_set_position, overlapping outputs paint each other's views
+   struct chck_iter_pool layout;
+
    struct {
       wlc_handle output;
    } active;
@@ -0,0 +1,434 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <wayland-server.h>
+#include <chck/overflow/overflow.h>
+#include "wayland-linux-dmabuf-unstable-v1-server-protocol.h"
+#include "internal.h"
+#include "macros.h"
+#include "dmabuf.h"
+#include "compositor.h"
+#include "output.h"
+#include "platform/render/render.h"
+
+static_assert_x((uint32_t)WLC_DMABUF_Y_INVERT == ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_Y_INVERT, dmabuf_y_invert_matches_params_flags);
+static_assert_x((uint32_t)WLC_DMABUF_INTERLACED == ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_INTERLACED, dmabuf_interlaced_matches_params_flags);
+static_assert_x((uint32_t)WLC_DMABUF_BOTTOM_FIRST == ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_BOTTOM_FIRST, dmabuf_bottom_first_matches_params_flags);
+
+// Container of zwp_linux_buffer_params_v1, collects planes until create
+struct params {
+   struct wlc_dmabuf_attributes attributes;
+   bool used;
+};
+
+static void
+attributes_close(struct wlc_dmabuf_attributes *attributes)
+{
+   assert(attributes);
+
+   for (uint32_t i = 0; i < WLC_DMABUF_MAX_PLANES; ++i) {
+      if (attributes->fd[i] >= 0)
+         close(attributes->fd[i]);
+
+      attributes->fd[i] = -1;
+   }
+}
+
+static struct wlc_output*
+get_output(struct wlc_dmabuf *dmabuf)
+{
+   assert(dmabuf);
+
+   struct wlc_compositor *compositor;
+   except((compositor = wl_container_of(dmabuf, compositor, dmabuf)));
+
+   // Contexts of outputs run on the same GPU, any of them can answer
+   struct wlc_output *o;
+   wlc_slab_for_each(&compositor->outputs.pool, o) {
+      if (o->context.context)
+         return o;
+   }
+
+   return NULL;
+}
+
+static bool
+format_supported(struct wlc_dmabuf *dmabuf, uint32_t format)
+{
+   assert(dmabuf);
+
+   uint32_t *f;
+   chck_iter_pool_for_each(&dmabuf->formats, f) {
+      if (*f == format)
+         return true;
+   }
+
+   return false;
+}
+
+static bool
+importable(struct wlc_dmabuf *dmabuf, const struct wlc_dmabuf_attributes *attributes)
+{
+   assert(dmabuf && attributes);
+
+   struct wlc_output *o;
+   if (!(o = get_output(dmabuf)))
+      return false;
+
+   return wlc_render_dmabuf_importable(&o->render, &o->context, attributes);
+}
+
+static void
+buffer_destroy(struct wl_resource *resource)
+{
+   struct wlc_dmabuf_attributes *attributes;
+   if (!(attributes = wl_resource_get_user_data(resource)))
+      return;
+
+   attributes_close(attributes);
+   free(attributes);
+}
+
+static const struct wl_buffer_interface wl_buffer_implementation = {
+   .destroy = wlc_cb_resource_destructor
+};
+
+const struct wlc_dmabuf_attributes*
+wlc_dmabuf_get_attributes(struct wl_resource *buffer)
+{
+   assert(buffer);
+
+   if (!wl_resource_instance_of(buffer, &wl_buffer_interface, &wl_buffer_implementation))
+      return NULL;
+
+   return wl_resource_get_user_data(buffer);
+}
+
+static struct wl_resource*
+buffer_create(struct wl_client *client, uint32_t id, struct params *params)
+{
+   assert(client && params);
+
+   struct wlc_dmabuf_attributes *attributes;
+   if (!(attributes = malloc(sizeof(struct wlc_dmabuf_attributes))))
+      return NULL;
+
+   struct wl_resource *resource;
+   if (!(resource = wl_resource_create(client, &wl_buffer_interface, 1, id))) {
+      free(attributes);
+      return NULL;
+   }
+
+   // Buffer owns the file descriptors from now on
+   memcpy(attributes, &params->attributes, sizeof(struct wlc_dmabuf_attributes));
+   for (uint32_t i = 0; i < WLC_DMABUF_MAX_PLANES; ++i)
+      params->attributes.fd[i] = -1;
+
+   wl_resource_set_implementation(resource, &wl_buffer_implementation, attributes, buffer_destroy);
+   return resource;
+}
+
+static bool
+params_validate(struct wl_resource *resource, struct params *params, int32_t width, int32_t height, uint32_t format, uint32_t flags)
+{
+   assert(resource && params);
+
+   if (params->used) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED, "params were already used to create a wl_buffer");
+      return false;
+   }
+
+   params->used = true;
+   struct wlc_dmabuf_attributes *a = &params->attributes;
+
+   if (!a->planes) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE, "no dmabuf has been added to the params");
+      return false;
+   }
+
+   // Planes must be consecutive from zero
+   for (uint32_t i = 0; i < a->planes; ++i) {
+      if (a->fd[i] >= 0)
+         continue;
+
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE, "no dmabuf has been added for plane %u", i);
+      return false;
+   }
+
+   if (width < 1 || height < 1) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS, "invalid width %d or height %d", width, height);
+      return false;
+   }
+
+   for (uint32_t i = 0; i < a->planes; ++i) {
+      if ((uint64_t)a->offset[i] + a->stride[i] > UINT32_MAX || (i == 0 && (uint64_t)a->offset[i] + (uint64_t)a->stride[i] * height > UINT32_MAX)) {
+         wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS, "size overflow for plane %u", i);
+         return false;
+      }
+
+      // Not every dmabuf exporter reports its size, checked when possible
+      const off_t size = lseek(a->fd[i], 0, SEEK_END);
+      if (size == -1)
+         continue;
+
+      if (a->offset[i] >= size || (uint64_t)a->offset[i] + a->stride[i] > (uint64_t)size || (i == 0 && (uint64_t)a->offset[i] + (uint64_t)a->stride[i] * height > (uint64_t)size)) {
+         wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS, "plane %u goes out of dmabuf bounds", i);
+         return false;
+      }
+   }
+
+   struct wlc_dmabuf *dmabuf;
+   if (!(dmabuf = wl_resource_get_user_data(resource)) || !format_supported(dmabuf, format)) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT, "format 0x%x is not supported", format);
+      return false;
+   }
+
+   a->width = width;
+   a->height = height;
+   a->format = format;
+   a->flags = flags;
+   return true;
+}
+
+static void
+zwp_cb_params_add(struct wl_client *client, struct wl_resource *resource, int32_t fd, uint32_t plane_idx, uint32_t offset, uint32_t stride, uint32_t modifier_hi, uint32_t modifier_lo)
+{
+   (void)client;
+
+   struct params *params;
+   if (!(params = convert_from_wl_resource(resource, WLC_TYPE_DMABUF_PARAMS)))
+      goto fail;
+
+   if (params->used) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED, "params were already used to create a wl_buffer");
+      goto fail;
+   }
+
+   if (plane_idx >= WLC_DMABUF_MAX_PLANES) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX, "plane index %u is too large", plane_idx);
+      goto fail;
+   }
+
+   struct wlc_dmabuf_attributes *a = &params->attributes;
+   if (a->fd[plane_idx] >= 0) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_SET, "plane %u was already set", plane_idx);
+      goto fail;
+   }
+
+   a->fd[plane_idx] = fd;
+   a->offset[plane_idx] = offset;
+   a->stride[plane_idx] = stride;
+   a->modifier[plane_idx] = ((uint64_t)modifier_hi << 32) | modifier_lo;
+   a->planes++;
+   return;
+
+fail:
+   close(fd);
+}
+
+static void
+zwp_cb_params_create(struct wl_client *client, struct wl_resource *resource, int32_t width, int32_t height, uint32_t format, uint32_t flags)
+{
+   struct params *params;
+   if (!(params = convert_from_wl_resource(resource, WLC_TYPE_DMABUF_PARAMS)) || !params_validate(resource, params, width, height, format, flags))
+      return;
+
+   // Buffers the renderer can't import are refused here, instead of failing silently on attach
+   struct wl_resource *buffer;
+   if (!importable(wl_resource_get_user_data(resource), &params->attributes) || !(buffer = buffer_create(client, 0, params))) {
+      zwp_linux_buffer_params_v1_send_failed(resource);
+      return;
+   }
+
+   zwp_linux_buffer_params_v1_send_created(resource, buffer);
+}
+
+static void
+zwp_cb_params_create_immed(struct wl_client *client, struct wl_resource *resource, uint32_t buffer_id, int32_t width, int32_t height, uint32_t format, uint32_t flags)
+{
+   struct params *params;
+   if (!(params = convert_from_wl_resource(resource, WLC_TYPE_DMABUF_PARAMS)) || !params_validate(resource, params, width, height, format, flags))
+      return;
+
+   if (!importable(wl_resource_get_user_data(resource), &params->attributes)) {
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER, "importing dmabuf failed");
+      return;
+   }
+
+   if (!buffer_create(client, buffer_id, params))
+      wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER, "failed to create wl_buffer");
+}
+
+static const struct zwp_linux_buffer_params_v1_interface zwp_linux_buffer_params_implementation = {
+   .destroy = wlc_cb_resource_destructor,
+   .add = zwp_cb_params_add,
+   .create = zwp_cb_params_create,
+   .create_immed = zwp_cb_params_create_immed,
+};
+
+static bool
+params_constructor(struct params *params)
+{
+   assert(params);
+
+   for (uint32_t i = 0; i < WLC_DMABUF_MAX_PLANES; ++i)
+      params->attributes.fd[i] = -1;
+
+   return true;
+}
+
+static void
+params_release(struct params *params)
+{
+   assert(params);
+   attributes_close(&params->attributes);
+}
+
+static void
+zwp_cb_dmabuf_create_params(struct wl_client *client, struct wl_resource *resource, uint32_t id)
+{
+   struct wlc_dmabuf *dmabuf;
+   if (!(dmabuf = wl_resource_get_user_data(resource)))
+      return;
+
+   wlc_resource r;
+   if (!(r = wlc_resource_create(&dmabuf->params, client, &zwp_linux_buffer_params_v1_interface, wl_resource_get_version(resource), 3, id)))
+      return;
+
+   wlc_resource_implement(r, &zwp_linux_buffer_params_implementation, dmabuf);
+}
+
+static const struct zwp_linux_dmabuf_v1_interface zwp_linux_dmabuf_implementation = {
+   .destroy = wlc_cb_resource_destructor,
+   .create_params = zwp_cb_dmabuf_create_params,
+};
+
+static void
+send_modifiers(struct wl_resource *resource, struct wlc_context *context, uint32_t format)
+{
+   assert(resource);
+
+   // Without a context only the implicit layout is advertised
+   EGLint num = 0;
+   EGLuint64KHR *modifiers = NULL;
+   if (context && wlc_context_query_dmabuf_modifiers(context, format, 0, NULL, &num) && num > 0 && (modifiers = chck_malloc_mul_of(num, sizeof(EGLuint64KHR)))) {
+      if (!wlc_context_query_dmabuf_modifiers(context, format, num, modifiers, &num))
+         num = 0;
+   } else {
+      num = 0;
+   }
+
+   // No explicit modifiers, buffers with implicit layout still work
+   if (num <= 0)
+      zwp_linux_dmabuf_v1_send_modifier(resource, format, WLC_DMABUF_MOD_INVALID >> 32, WLC_DMABUF_MOD_INVALID & 0xffffffff);
+
+   for (EGLint i = 0; i < num; ++i)
+      zwp_linux_dmabuf_v1_send_modifier(resource, format, modifiers[i] >> 32, modifiers[i] & 0xffffffff);
+
+   free(modifiers);
+}
+
+static void
+send_formats(struct wl_resource *resource, struct wlc_dmabuf *dmabuf)
+{
+   assert(resource && dmabuf);
+
+   struct wlc_output *o = get_output(dmabuf);
+   const bool modifiers = (wl_resource_get_version(resource) >= ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION);
+
+   uint32_t *f;
+   chck_iter_pool_for_each(&dmabuf->formats, f) {
+      if (modifiers) {
+         send_modifiers(resource, (o ? &o->context : NULL), *f);
+      } else {
+         zwp_linux_dmabuf_v1_send_format(resource, *f);
+      }
+   }
+}
+
+static void
+zwp_linux_dmabuf_bind(struct wl_client *client, void *data, unsigned int version, unsigned int id)
+{
+   struct wl_resource *resource;
+   if (!(resource = wl_resource_create_checked(client, &zwp_linux_dmabuf_v1_interface, version, 3, id)))
+      return;
+
+   wl_resource_set_implementation(resource, &zwp_linux_dmabuf_implementation, data, NULL);
+   send_formats(resource, data);
+}
+
+void
+wlc_dmabuf_update(struct wlc_dmabuf *dmabuf)
+{
+   assert(dmabuf);
+
+   struct wlc_output *o;
+   if (dmabuf->wl.dmabuf || !(o = get_output(dmabuf)))
+      return;
+
+   // Fails without EGL_EXT_image_dma_buf_import, clients then never see the global
+   EGLint num;
+   if (!wlc_context_query_dmabuf_formats(&o->context, 0, NULL, &num) || num <= 0)
+      return;
+
+   EGLint *formats;
+   if (!(formats = chck_malloc_mul_of(num, sizeof(EGLint))))
+      return;
+
+   if (!wlc_context_query_dmabuf_formats(&o->context, num, formats, &num))
+      goto fail;
+
+   chck_iter_pool_flush(&dmabuf->formats);
+   for (EGLint i = 0; i < num; ++i) {
+      const uint32_t format = formats[i];
+      if (!chck_iter_pool_push_back(&dmabuf->formats, &format))
+         goto fail;
+   }
+
+   if (!(dmabuf->wl.dmabuf = wl_global_create(wlc_display(), &zwp_linux_dmabuf_v1_interface, 3, dmabuf, zwp_linux_dmabuf_bind)))
+      goto dmabuf_interface_fail;
+
+   free(formats);
+   return;
+
+dmabuf_interface_fail:
+   wlc_log(WLC_LOG_WARN, "Failed to bind linux dmabuf interface");
+fail:
+   chck_iter_pool_flush(&dmabuf->formats);
+   free(formats);
+}
+
+void
+wlc_dmabuf_release(struct wlc_dmabuf *dmabuf)
+{
+   if (!dmabuf)
+      return;
+
+   if (dmabuf->wl.dmabuf)
+      wl_global_destroy(dmabuf->wl.dmabuf);
+
+   wlc_source_release(&dmabuf->params);
+   chck_iter_pool_release(&dmabuf->formats);
+   memset(dmabuf, 0, sizeof(struct wlc_dmabuf));
+}
+
+bool
+wlc_dmabuf(struct wlc_dmabuf *dmabuf)
+{
+   assert(dmabuf);
+   memset(dmabuf, 0, sizeof(struct wlc_dmabuf));
+
+   // Global is created by wlc_dmabuf_update, once there is a context to ask about import support
+   if (!chck_iter_pool(&dmabuf->formats, 16, 0, sizeof(uint32_t)))
+      goto fail;
+
+   if (!wlc_source(&dmabuf->params, WLC_TYPE_DMABUF_PARAMS, params_constructor, params_release, 8, sizeof(struct params)))
+      goto fail;
+
+   return true;
+
+fail:
+   wlc_dmabuf_release(dmabuf);
+   return false;
+}
@@ -0,0 +1,61 @@
+#ifndef _WLC_DMABUF_H_
+#define _WLC_DMABUF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "resources/resources.h"
+
+struct wl_resource;
+
+// EGL_EXT_image_dma_buf_import_modifiers goes up to four planes
+#define WLC_DMABUF_MAX_PLANES 4
+
+// Layout is left for the driver to pick, same value as DRM_FORMAT_MOD_INVALID
+#define WLC_DMABUF_MOD_INVALID ((UINT64_C(1) << 56) - 1)
+
+// Plain row-major layout, same value as DRM_FORMAT_MOD_LINEAR
+#define WLC_DMABUF_MOD_LINEAR UINT64_C(0)
+
+// Same bits as zwp_linux_buffer_params_v1.flags
+enum wlc_dmabuf_flags {
+   WLC_DMABUF_Y_INVERT = 1<<0,
+   WLC_DMABUF_INTERLACED = 1<<1,
+   WLC_DMABUF_BOTTOM_FIRST = 1<<2,
+};
+
+struct wlc_dmabuf_attributes {
+   int32_t width, height;
+   uint32_t format; // DRM_FORMAT code
+   uint32_t flags; // WLC_DMABUF_* bits
+   uint32_t planes;
+   int fd[WLC_DMABUF_MAX_PLANES];
+   uint32_t offset[WLC_DMABUF_MAX_PLANES];
+   uint32_t stride[WLC_DMABUF_MAX_PLANES];
+   uint64_t modifier[WLC_DMABUF_MAX_PLANES];
+};
+
+struct wlc_dmabuf {
+   struct wlc_source params;
+   struct chck_iter_pool formats; // uint32_t DRM_FORMAT codes the GPU imports, filled with the global
+
+   struct {
+      struct wl_global *dmabuf;
+   } wl;
+};
+
+/**
+ * Attributes of wl_buffer created through zwp_linux_dmabuf_v1, NULL for any other buffer.
+ * The file descriptors stay open for the lifetime of the wl_buffer.
+ */
+WLC_NONULL const struct wlc_dmabuf_attributes* wlc_dmabuf_get_attributes(struct wl_resource *buffer);
+
+/**
+ * Creates the zwp_linux_dmabuf_v1 global once an output context can import dmabufs.
+ * Called whenever outputs get a new context, does nothing after the global exists.
+ */
+WLC_NONULL void wlc_dmabuf_update(struct wlc_dmabuf *dmabuf);
+
+void wlc_dmabuf_release(struct wlc_dmabuf *dmabuf);
+WLC_NONULL bool wlc_dmabuf(struct wlc_dmabuf *dmabuf);
+
+#endif /* _WLC_DMABUF_H_ */
@@ -1,6 +1,7 @@
 #include "output.h"
 #include <stdlib.h>
 #include <limits.h>
+#include <math.h>
 #include <wayland-server.h>
 #include <chck/string/string.h>
 #include <chck/math/math.h>
@@ -10,11 +11,24 @@
 #include "macros.h"
 #include "output.h"
 #include "view.h"
+#include "presentation.h"
 #include "resources/types/surface.h"
+#include "resources/types/buffer.h"
 
 // FIXME: this is a hack
 static EGLNativeDisplayType INVALID_DISPLAY = (EGLNativeDisplayType)~0;
 
+// Past this many rectangles it is cheaper to paint the bounding box
+static const int MAX_PAINT_RECTS = 8;
+
+// View of another output that reaches into this output
+struct foreign_view {
+   wlc_handle view;
+   struct wlc_origin offset; // from owner output coordinates to ours
+   struct wlc_geometry bounds; // in our coordinates
+   pixman_region32_t clip; // area not occluded by our own views
+};
+
 WLC_PURE static const char*
 name_for_connector(enum wlc_connector_type connector)
 {
@@ -70,6 +84,17 @@ wlc_output_information_release(struct wlc_output_information *info)
    chck_string_release(&info->model);
 }
 
+static void
+send_geometry(struct wlc_output *output, struct wl_resource *resource)
+{
+   assert(output && resource);
+   wl_output_send_geometry(resource, output->information.x, output->information.y,
+                           output->information.physical_width, output->information.physical_height, output->information.subpixel,
+                           (output->information.make.data ? output->information.make.data : "unknown"),
+                           (output->information.model.data ? output->information.model.data : "model"),
+                           output->information.transform);
+}
+
 static void
 wl_output_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 {
@@ -83,15 +108,11 @@ wl_output_bind(struct wl_client *client, void *data, uint32_t version, uint32_t
    wlc_resource_implement(r, NULL, (void*)convert_to_wlc_handle(output));
 
    struct wl_resource *resource;
-   if (!(resource = wl_resource_from_wlc_resource(r, "output")))
+   if (!(resource = wl_resource_from_wlc_resource(r, WLC_TYPE_OUTPUT)))
       return;
 
    // FIXME: update on wlc_output_set_information
-   wl_output_send_geometry(resource, output->information.x, output->information.y,
-                           output->information.physical_width, output->information.physical_height, output->information.subpixel,
-                           (output->information.make.data ? output->information.make.data : "unknown"),
-                           (output->information.model.data ? output->information.model.data : "model"),
-                           output->information.transform);
+   send_geometry(output, resource);
 
    assert(output->information.scale > 0);
    if (version >= WL_OUTPUT_SCALE_SINCE_VERSION)
@@ -114,114 +135,1039 @@ view_visible(struct wlc_view *view, struct wlc_surface *surface, uint32_t mask)
    return (surface->commit.attached && (view->mask & mask));
 }
 
-static bool
-blit(bool *g, const struct wlc_size *r, const struct wlc_origin *a, const struct wlc_origin *b, bool should_blit)
-{
-   assert(g && r && a && b);
+static bool
+get_visible_views(struct wlc_output *output, struct chck_iter_pool *visible)
+{
+   assert(output);
+
+   // Walk views front to back, subtracting opaque areas from what is still uncovered
+   pixman_region32_t uncovered;
+   pixman_region32_init_rect(&uncovered, 0, 0, output->resolution.w, output->resolution.h);
+
+   wlc_handle *h;
+   chck_iter_pool_for_each_reverse(&output->views, h) {
+      struct wlc_view *v;
+      if (!(v = convert_from_wlc_handle(*h, WLC_TYPE_VIEW)))
+         continue;
+
+      pixman_region32_clear(&v->clip);
+
+      // Bounds and visibility were updated by damage_views
+      if (!v->painted.visible)
+         continue;
+
+      const struct wlc_geometry *b = &v->painted.bounds;
+      pixman_region32_intersect_rect(&v->clip, &uncovered, b->origin.x, b->origin.y, b->size.w, b->size.h);
+
+      if (!pixman_region32_not_empty(&v->clip)) {
+         wlc_dlog(WLC_DBG_RENDER_LOOP, "%" PRIuWLC " is not visible", *h);
+         continue;
+      }
+
+      struct wlc_geometry o;
+      if (wlc_view_get_opaque(v, &o)) {
+         pixman_region32_t opaque;
+         pixman_region32_init_rect(&opaque, o.origin.x, o.origin.y, o.size.w, o.size.h);
+         pixman_region32_subtract(&uncovered, &uncovered, &opaque);
+         pixman_region32_fini(&opaque);
+      }
+
+      chck_iter_pool_push_front(visible, &v);
+   }
+
+   // Views of other outputs are below ours
+   struct foreign_view *f;
+   chck_iter_pool_for_each_reverse(&output->foreign, f) {
+      pixman_region32_intersect_rect(&f->clip, &uncovered, f->bounds.origin.x, f->bounds.origin.y, f->bounds.size.w, f->bounds.size.h);
+
+      struct wlc_view *v;
+      struct wlc_geometry o;
+      if (pixman_region32_not_empty(&f->clip) && (v = convert_from_wlc_handle(f->view, WLC_TYPE_VIEW)) && wlc_view_get_opaque(v, &o)) {
+         pixman_region32_t opaque;
+         pixman_region32_init_rect(&opaque, o.origin.x + f->offset.x, o.origin.y + f->offset.y, o.size.w, o.size.h);
+         pixman_region32_subtract(&uncovered, &uncovered, &opaque);
+         pixman_region32_fini(&opaque);
+      }
+   }
+
+   const bool bg_visible = pixman_region32_not_empty(&uncovered);
+   pixman_region32_fini(&uncovered);
+   return bg_visible;
+}
+
+static void
+damage_to_surface(struct wlc_output *output, pixman_region32_t *damage, pixman_region32_t *out_damage)
+{
+   assert(output && damage && out_damage);
+
+   pixman_region32_init(out_damage);
+
+   if (!output->resolution.w || !output->resolution.h)
+      return;
+
+   if (wlc_size_equals(&output->mode, &output->resolution)) {
+      pixman_region32_copy(out_damage, damage);
+      return;
+   }
+
+   const float sw = (float)output->mode.w / output->resolution.w;
+   const float sh = (float)output->mode.h / output->resolution.h;
+
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(damage, &nrects);
+   for (int i = 0; i < nrects; ++i) {
+      const int32_t x1 = floorf(boxes[i].x1 * sw), y1 = floorf(boxes[i].y1 * sh);
+      const int32_t x2 = ceilf(boxes[i].x2 * sw), y2 = ceilf(boxes[i].y2 * sh);
+      pixman_region32_union_rect(out_damage, out_damage, x1, y1, x2 - x1, y2 - y1);
+   }
+}
+
+static void
+geometry_to_surface(struct wlc_output *output, const struct wlc_geometry *geometry, struct wlc_geometry *out_geometry)
+{
+   assert(output && geometry && out_geometry);
+
+   *out_geometry = *geometry;
+
+   if (!output->resolution.w || !output->resolution.h || wlc_size_equals(&output->mode, &output->resolution))
+      return;
+
+   // Surface is in mode size, round outwards so the whole geometry is covered
+   const float sw = (float)output->mode.w / output->resolution.w;
+   const float sh = (float)output->mode.h / output->resolution.h;
+   const int32_t x1 = chck_max32(floorf(geometry->origin.x * sw), 0), y1 = chck_max32(floorf(geometry->origin.y * sh), 0);
+   const int32_t x2 = chck_min32(ceilf((geometry->origin.x + (int32_t)geometry->size.w) * sw), output->mode.w);
+   const int32_t y2 = chck_min32(ceilf((geometry->origin.y + (int32_t)geometry->size.h) * sh), output->mode.h);
+   *out_geometry = (struct wlc_geometry){ { x1, y1 }, { chck_max32(x2 - x1, 0), chck_max32(y2 - y1, 0) } };
+}
+
+static uint8_t*
+pixels_buffer(struct wlc_output *output)
+{
+   assert(output);
+
+   size_t size;
+   const struct wlc_size *s = &output->task.pixels.geometry.size;
+   if (chck_mul_ofsz(s->w, s->h, &size) || chck_mul_ofsz(size, 4, &size))
+      return NULL;
+
+   if (output->pixels.size < size) {
+      uint8_t *rgba;
+      if (!(rgba = realloc(output->pixels.rgba, size)))
+         return NULL;
+
+      output->pixels.rgba = rgba;
+      output->pixels.size = size;
+   }
+
+   return output->pixels.rgba;
+}
+
+static void
+deliver_pixels(struct wlc_output *output, uint8_t *rgba)
+{
+   assert(output && output->task.pixels.cb);
+
+   // Callback may request pixels again, clear the task first
+   const struct wlc_size size = output->task.pixels.geometry.size;
+   bool (*pixels)(const struct wlc_size*, uint8_t*, void*) = output->task.pixels.cb;
+   void *arg = output->task.pixels.arg;
+   memset(&output->task.pixels, 0, sizeof(output->task.pixels));
+
+   // Callback keeps the buffer
+   if (rgba && pixels(&size, rgba, arg)) {
+      output->pixels.rgba = NULL;
+      output->pixels.size = 0;
+   }
+}
+
+static void
+read_pixels(struct wlc_output *output)
+{
+   assert(output);
+
+   if (!output->task.pixels.cb || output->task.pixels.queued)
+      return;
+
+   if (wlc_render_read_pixels_queue(&output->render, &output->context, WLC_READBACK_SLOT_PIXELS, &output->task.pixels.geometry)) {
+      output->task.pixels.queued = true;
+      return;
+   }
+
+   uint8_t *rgba;
+   if ((rgba = pixels_buffer(output)))
+      wlc_render_read_pixels(&output->render, &output->context, &output->task.pixels.geometry, rgba);
+
+   deliver_pixels(output, rgba);
+}
+
+static void
+fetch_pixels(struct wlc_output *output, bool wait)
+{
+   assert(output);
+
+   if (!output->task.pixels.queued)
+      return;
+
+   uint8_t *rgba;
+   if ((rgba = pixels_buffer(output))) {
+      switch (wlc_render_read_pixels_fetch(&output->render, &output->context, WLC_READBACK_SLOT_PIXELS, rgba, wait)) {
+         case WLC_READBACK_PENDING:
+            // Poll again shortly, repainting for it would only waste a frame
+            wl_event_source_timer_update(output->timer.readback, 1);
+            return;
+         case WLC_READBACK_FAILED:
+            rgba = NULL;
+            break;
+         case WLC_READBACK_DONE:
+            break;
+      }
+   }
+
+   deliver_pixels(output, rgba);
+}
+
+static void
+capture_release(struct wlc_output *output)
+{
+   assert(output);
+
+   if (!output->capture.cb)
+      return;
+
+   for (uint32_t i = 0; i < LENGTH(output->capture.buffers); ++i) {
+      free(output->capture.buffers[i].rgba);
+      pixman_region32_fini(&output->capture.buffers[i].stale);
+   }
+
+   free(output->capture.scratch.rgba);
+   chck_iter_pool_release(&output->capture.rects);
+   pixman_region32_fini(&output->capture.damage);
+   memset(&output->capture, 0, sizeof(output->capture));
+}
+
+static bool
+capture_resize(struct wlc_output *output)
+{
+   assert(output);
+
+   // Frames are read from the framebuffer, which is in mode size
+   if (wlc_size_equals(&output->capture.size, &output->mode))
+      return true;
+
+   size_t size;
+   if (chck_mul_ofsz(output->mode.w, output->mode.h, &size) || chck_mul_ofsz(size, 4, &size))
+      return false;
+
+   for (uint32_t i = 0; i < LENGTH(output->capture.buffers); ++i) {
+      uint8_t *rgba;
+      if (!(rgba = realloc(output->capture.buffers[i].rgba, size)))
+         return false;
+
+      output->capture.buffers[i].rgba = rgba;
+      pixman_region32_fini(&output->capture.buffers[i].stale);
+      pixman_region32_init_rect(&output->capture.buffers[i].stale, 0, 0, output->mode.w, output->mode.h);
+   }
+
+   pixman_region32_fini(&output->capture.damage);
+   pixman_region32_init_rect(&output->capture.damage, 0, 0, output->mode.w, output->mode.h);
+   output->capture.size = output->mode;
+   return true;
+}
+
+static uint8_t*
+capture_scratch(struct wlc_output *output)
+{
+   assert(output);
+
+   size_t size;
+   const struct wlc_size *s = &output->capture.queued.size;
+   if (chck_mul_ofsz(s->w, s->h, &size) || chck_mul_ofsz(size, 4, &size))
+      return NULL;
+
+   if (output->capture.scratch.size < size) {
+      uint8_t *rgba;
+      if (!(rgba = realloc(output->capture.scratch.rgba, size)))
+         return NULL;
+
+      output->capture.scratch.rgba = rgba;
+      output->capture.scratch.size = size;
+   }
+
+   return output->capture.scratch.rgba;
+}
+
+static void
+capture_deliver(struct wlc_output *output)
+{
+   assert(output && output->capture.cb);
+
+   const uint32_t b = output->capture.next;
+   const struct wlc_geometry *g = &output->capture.queued;
+
+   // Rows are bottom up, as with wlc_output_get_pixels
+   const size_t stride = output->capture.size.w * 4, row = g->size.w * 4;
+   const size_t bottom = output->capture.size.h - (g->origin.y + g->size.h);
+   for (size_t y = 0; y < g->size.h; ++y)
+      memcpy(output->capture.buffers[b].rgba + (bottom + y) * stride + g->origin.x * 4, output->capture.scratch.rgba + y * row, row);
+
+   pixman_region32_clear(&output->capture.buffers[b].stale);
+
+   chck_iter_pool_flush(&output->capture.rects);
+
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(&output->capture.damage, &nrects);
+   for (int i = 0; i < nrects; ++i) {
+      const struct wlc_geometry r = { { boxes[i].x1, boxes[i].y1 }, { boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1 } };
+      chck_iter_pool_push_back(&output->capture.rects, &r);
+   }
+
+   pixman_region32_clear(&output->capture.damage);
+   output->capture.next = (b + 1) % LENGTH(output->capture.buffers);
+
+   size_t memb;
+   const struct wlc_geometry *rects = chck_iter_pool_to_c_array(&output->capture.rects, &memb);
+   output->capture.cb(&output->capture.size, output->capture.buffers[b].rgba, rects, memb, output->capture.arg);
+}
+
+static void
+capture_fetch(struct wlc_output *output, bool wait)
+{
+   assert(output);
+
+   if (!output->capture.pending)
+      return;
+
+   uint8_t *rgba;
+   if ((rgba = capture_scratch(output))) {
+      switch (wlc_render_read_pixels_fetch(&output->render, &output->context, WLC_READBACK_SLOT_CAPTURE, rgba, wait)) {
+         case WLC_READBACK_PENDING:
+            // Poll again shortly, repainting for it would only waste a frame
+            wl_event_source_timer_update(output->timer.readback, 1);
+            return;
+         case WLC_READBACK_FAILED:
+            rgba = NULL;
+            break;
+         case WLC_READBACK_DONE:
+            break;
+      }
+   }
+
+   output->capture.pending = false;
+
+   // Failed area stays stale and is read again with the next frame
+   if (rgba)
+      capture_deliver(output);
+}
+
+static void
+capture_frame(struct wlc_output *output, pixman_region32_t *damage)
+{
+   assert(output && damage);
+
+   if (!output->capture.cb)
+      return;
+
+   // Waiting for the read back of an earlier frame would stall this one on the gpu
+   capture_fetch(output, false);
+
+   if (!output->capture.cb || !capture_resize(output))
+      return;
+
+   pixman_region32_t surface_damage;
+   damage_to_surface(output, damage, &surface_damage);
+   pixman_region32_intersect_rect(&surface_damage, &surface_damage, 0, 0, output->mode.w, output->mode.h);
+
+   for (uint32_t i = 0; i < LENGTH(output->capture.buffers); ++i)
+      pixman_region32_union(&output->capture.buffers[i].stale, &output->capture.buffers[i].stale, &surface_damage);
+
+   pixman_region32_union(&output->capture.damage, &output->capture.damage, &surface_damage);
+   pixman_region32_fini(&surface_damage);
+
+   // Slot is still busy, the damage is read with a later frame
+   if (output->capture.pending || !pixman_region32_not_empty(&output->capture.damage))
+      return;
+
+   // Read back only what changed since this buffer was last written
+   const pixman_box32_t *e = pixman_region32_extents(&output->capture.buffers[output->capture.next].stale);
+   output->capture.queued = (struct wlc_geometry){ { e->x1, e->y1 }, { e->x2 - e->x1, e->y2 - e->y1 } };
+
+   if (wlc_render_read_pixels_queue(&output->render, &output->context, WLC_READBACK_SLOT_CAPTURE, &output->capture.queued)) {
+      output->capture.pending = true;
+      return;
+   }
+
+   uint8_t *rgba;
+   if (!(rgba = capture_scratch(output)))
+      return;
+
+   wlc_render_read_pixels(&output->render, &output->context, &output->capture.queued, rgba);
+   capture_deliver(output);
+}
+
+static void
+finish_frame_tasks(struct wlc_output *output)
+{
+   assert(output);
+
+   fetch_pixels(output, false);
+   capture_fetch(output, false);
+
+   if (output->task.bsurface.display) {
+      wlc_output_set_backend_surface(output, (output->task.bsurface.display == INVALID_DISPLAY ? NULL : &output->task.bsurface));
+      memset(&output->task.bsurface, 0, sizeof(output->task.bsurface));
+   }
+
+   if (output->task.sleep) {
+      wlc_output_set_sleep_ptr(output, true);
+      output->task.sleep = false;
+   }
+
+   if (output->task.terminate) {
+      wlc_output_terminate(output);
+      output->task.terminate = false;
+   }
+}
+
+static bool
+intersects(const struct wlc_geometry *a, const struct wlc_geometry *b)
+{
+   assert(a && b);
+   return (a->origin.x < b->origin.x + (int32_t)b->size.w && b->origin.x < a->origin.x + (int32_t)a->size.w &&
+           a->origin.y < b->origin.y + (int32_t)b->size.h && b->origin.y < a->origin.y + (int32_t)a->size.h);
+}
+
+static void
+add_damage(struct wlc_output *output, const struct wlc_geometry *g)
+{
+   assert(output && g);
+
+   if (g->size.w == 0 || g->size.h == 0)
+      return;
+
+   pixman_region32_union_rect(&output->damage, &output->damage, g->origin.x, g->origin.y, g->size.w, g->size.h);
+}
+
+static void
+forward_damage(struct wlc_output *output, const struct wlc_geometry *g)
+{
+   assert(output && g);
+
+   if (!output->layout.placed || g->size.w == 0 || g->size.h == 0)
+      return;
+
+   // Damage of our views shows on overlapping outputs too
+   wlc_handle *h;
+   chck_iter_pool_for_each(output->layout.outputs, h) {
+      struct wlc_output *o;
+      if (!(o = convert_from_wlc_handle(*h, WLC_TYPE_OUTPUT)) || o == output)
+         continue;
+
+      const struct wlc_geometry d = { { g->origin.x + output->layout.origin.x - o->layout.origin.x, g->origin.y + output->layout.origin.y - o->layout.origin.y }, g->size };
+      if (!intersects(&d, &(struct wlc_geometry){ wlc_origin_zero, o->resolution }))
+         continue;
+
+      add_damage(o, &d);
+      wlc_output_schedule_repaint(o);
+   }
+}
+
+static void
+invalidate_foreign_views(struct wlc_output *output, bool self)
+{
+   assert(output);
+
+   if (!output->layout.placed)
+      return;
+
+   // Overlapping outputs collect our views again on their next repaint
+   wlc_handle *h;
+   chck_iter_pool_for_each(output->layout.outputs, h) {
+      struct wlc_output *o;
+      if ((o = convert_from_wlc_handle(*h, WLC_TYPE_OUTPUT)) && (self || o != output))
+         o->state.foreign_changed = true;
+   }
+}
+
+static void
+add_view_damage(struct wlc_output *output, const struct wlc_geometry *g)
+{
+   assert(output && g);
+   add_damage(output, g);
+   forward_damage(output, g);
+}
+
+static void
+release_foreign_views(struct wlc_output *output)
+{
+   assert(output);
+
+   struct foreign_view *f;
+   chck_iter_pool_for_each(&output->foreign, f)
+      pixman_region32_fini(&f->clip);
+
+   chck_iter_pool_flush(&output->foreign);
+}
+
+static void
+get_foreign_views(struct wlc_output *output)
+{
+   assert(output);
+
+   if (!output->state.foreign_changed)
+      return;
+
+   output->state.foreign_changed = false;
+   release_foreign_views(output);
+
+   if (!output->layout.placed)
+      return;
+
+   const struct wlc_geometry area = { wlc_origin_zero, output->resolution };
+
+   wlc_handle *h;
+   chck_iter_pool_for_each(output->layout.outputs, h) {
+      struct wlc_output *o;
+      if (!(o = convert_from_wlc_handle(*h, WLC_TYPE_OUTPUT)) || o == output)
+         continue;
+
+      // Textures of the views must be usable in our context
+      if (!wlc_context_shares(&o->context, &output->context))
+         continue;
+
+      const struct wlc_origin offset = { o->layout.origin.x - output->layout.origin.x, o->layout.origin.y - output->layout.origin.y };
+
+      // Owner output has committed the view state when it painted it, use that
+      wlc_handle *vh;
+      chck_iter_pool_for_each(&o->views, vh) {
+         struct wlc_view *v;
+         if (!(v = convert_from_wlc_handle(*vh, WLC_TYPE_VIEW)) || !v->painted.visible || v->painted.plane)
+            continue;
+
+         struct foreign_view f = { .view = *vh, .offset = offset, .bounds = v->painted.bounds };
+         f.bounds.origin.x += offset.x, f.bounds.origin.y += offset.y;
+         if (!intersects(&f.bounds, &area))
+            continue;
+
+         pixman_region32_init(&f.clip);
+         if (!chck_iter_pool_push_back(&output->foreign, &f))
+            pixman_region32_fini(&f.clip);
+      }
+   }
+}
+
+static void
+add_surface_damage(struct wlc_output *output, struct wlc_surface *surface, const struct wlc_geometry *visible)
+{
+   assert(output && surface && visible);
+
+   if (!pixman_region32_not_empty(&surface->commit.damage) || surface->size.w == 0 || surface->size.h == 0)
+      return;
+
+   // Surface damage is in surface coordinates, scale it to the area it is painted to.
+   // Linear filtering samples neighbouring texels when scaled, so grow the damage by one pixel.
+   const float sx = (float)visible->size.w / surface->size.w, sy = (float)visible->size.h / surface->size.h;
+   const int32_t margin = (sx != 1.0f || sy != 1.0f);
+
+   int nrects;
+   const pixman_box32_t *r = pixman_region32_rectangles(&surface->commit.damage, &nrects);
+   for (int i = 0; i < nrects; ++i) {
+      const int32_t x1 = floorf(visible->origin.x + r[i].x1 * sx) - margin;
+      const int32_t y1 = floorf(visible->origin.y + r[i].y1 * sy) - margin;
+      const int32_t x2 = ceilf(visible->origin.x + r[i].x2 * sx) + margin;
+      const int32_t y2 = ceilf(visible->origin.y + r[i].y2 * sy) + margin;
+      add_view_damage(output, &(struct wlc_geometry){ { x1, y1 }, { x2 - x1, y2 - y1 } });
+   }
+}
+
+static bool
+attach_subsurfaces(struct wlc_output *output, struct wlc_surface *surface)
+{
+   assert(output && surface);
+
+   // Sub-surfaces are painted on the output of their root, which may not have had one when they committed
+   bool attached = false;
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->tree.current, r) {
+      struct wlc_surface *child;
+      if (!*r || !(child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)))
+         continue;
+
+      struct wlc_buffer *buffer;
+      if (child->output != convert_to_wlc_handle(output) && (buffer = wlc_surface_get_buffer(child)))
+         attached = (wlc_surface_attach_to_output(child, output, buffer) || attached);
+
+      attached = (attach_subsurfaces(output, child) || attached);
+   }
+
+   return attached;
+}
+
+static void
+add_subsurface_bounds(struct wlc_surface *surface, const struct wlc_geometry *visible, struct wlc_geometry *bounds)
+{
+   assert(surface && visible && bounds);
+
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->tree.current, r) {
+      struct wlc_surface *child;
+      if (!*r || !(child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) || !child->commit.attached)
+         continue;
+
+      struct wlc_geometry g;
+      wlc_surface_get_subsurface_geometry(surface, child, visible, &g);
+
+      const int32_t x1 = chck_min32(bounds->origin.x, g.origin.x), y1 = chck_min32(bounds->origin.y, g.origin.y);
+      const int32_t x2 = chck_max32(bounds->origin.x + (int32_t)bounds->size.w, g.origin.x + (int32_t)g.size.w);
+      const int32_t y2 = chck_max32(bounds->origin.y + (int32_t)bounds->size.h, g.origin.y + (int32_t)g.size.h);
+      *bounds = (struct wlc_geometry){ { x1, y1 }, { x2 - x1, y2 - y1 } };
+
+      add_subsurface_bounds(child, &g, bounds);
+   }
+}
+
+static void
+damage_subsurfaces(struct wlc_output *output, struct wlc_surface *surface, const struct wlc_geometry *visible, bool add)
+{
+   assert(output && surface && visible);
+
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->tree.current, r) {
+      struct wlc_surface *child;
+      if (!*r || !(child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) || !child->commit.attached)
+         continue;
+
+      struct wlc_geometry g;
+      wlc_surface_get_subsurface_geometry(surface, child, visible, &g);
+
+      if (add)
+         add_surface_damage(output, child, &g);
+
+      pixman_region32_clear(&child->commit.damage);
+      damage_subsurfaces(output, child, &g, add);
+   }
+}
+
+static void
+damage_painted_view(struct wlc_output *output, struct wlc_view *view)
+{
+   assert(view);
+
+   if (output && view->painted.visible)
+      add_view_damage(output, &view->painted.bounds);
+
+   if (output)
+      invalidate_foreign_views(output, false);
+
+   view->painted.bounds = wlc_geometry_zero;
+   view->painted.visible = false;
+}
+
+static void
+damage_views(struct wlc_output *output)
+{
+   assert(output);
+
+   wlc_handle *h;
+   chck_iter_pool_for_each(&output->views, h) {
+      struct wlc_view *v;
+      struct wlc_surface *s;
+      const wlc_handle handle = *h;
+      if (!(v = convert_from_wlc_handle(handle, WLC_TYPE_VIEW)) ||
+          !(s = convert_from_wlc_resource(v->surface, WLC_TYPE_SURFACE)))
+         continue;
+
+      struct wlc_geometry b = wlc_geometry_zero, visible;
+      const bool is_visible = view_visible(v, s, output->active.mask);
+      bool changed = (is_visible != v->painted.visible);
+
+      if (is_visible) {
+         const struct wlc_view_state old = v->commit;
+         wlc_view_commit_state(v, &v->pending, &v->commit);
+
+         // View may have been closed during commit
+         if (convert_from_wlc_handle(handle, WLC_TYPE_VIEW) != v)
+            continue;
+
+         changed = (attach_subsurfaces(output, s) || changed);
+
+         // Sub-surfaces may reach outside of the view
+         wlc_view_get_bounds(v, &b, &visible);
+         add_subsurface_bounds(s, &visible, &b);
+         changed = (changed || s->tree.changed || memcmp(&old, &v->commit, sizeof(old)) || !wlc_geometry_equals(&b, &v->painted.bounds));
+         s->tree.changed = false;
+      }
+
+      if (changed) {
+         damage_painted_view(output, v);
+         add_view_damage(output, &b);
+      } else if (is_visible) {
+         add_surface_damage(output, s, &visible);
+      }
+
+      if (is_visible)
+         damage_subsurfaces(output, s, &visible, !changed);
+
+      pixman_region32_clear(&s->commit.damage);
+      v->painted.bounds = b;
+      v->painted.visible = is_visible;
+   }
+}
+
+static void
+get_frame_damage(struct wlc_output *output, pixman_region32_t *out_damage, pixman_region32_t *out_repaint)
+{
+   assert(output && out_damage && out_repaint);
+
+   pixman_region32_init_rect(out_repaint, 0, 0, output->resolution.w, output->resolution.h);
+   pixman_region32_init(out_damage);
+   pixman_region32_intersect(out_damage, out_repaint, &output->damage);
+   pixman_region32_clear(&output->damage);
+
+   // Back buffer holds the frame from age frames ago, repaint everything changed since.
+   // Without knowing the back buffer contents we have to paint everything.
+   const uint32_t age = wlc_context_get_buffer_age(&output->context);
+   if (age > 0 && age <= LENGTH(output->previous_damage) + 1) {
+      pixman_region32_copy(out_repaint, out_damage);
+      for (uint32_t i = 0; i + 1 < age; ++i)
+         pixman_region32_union(out_repaint, out_repaint, &output->previous_damage[i]);
+   }
+
+   const size_t last = LENGTH(output->previous_damage) - 1;
+   pixman_region32_fini(&output->previous_damage[last]);
+   memmove(&output->previous_damage[1], &output->previous_damage[0], last * sizeof(pixman_region32_t));
+   pixman_region32_init(&output->previous_damage[0]);
+   pixman_region32_copy(&output->previous_damage[0], out_damage);
+
+   wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Buffer age %u", age);
+}
+
+static void
+paint_view(struct wlc_output *output, struct wlc_view *view, pixman_region32_t *unoccluded, const struct wlc_origin *offset, const struct wlc_geometry *clip)
+{
+   assert(output && view && unoccluded && clip);
+
+   // Paint only the parts of the view that are not occluded
+   pixman_region32_t region;
+   pixman_region32_init(&region);
+   pixman_region32_intersect_rect(&region, unoccluded, clip->origin.x, clip->origin.y, clip->size.w, clip->size.h);
+
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(&region, &nrects);
+   if (nrects > MAX_PAINT_RECTS) {
+      boxes = pixman_region32_extents(&region);
+      nrects = 1;
+   }
+
+   // Renderer clips the paints itself, so the rectangles of the view end up in the same batch
+   for (int i = 0; i < nrects; ++i) {
+      const struct wlc_geometry g = { { boxes[i].x1, boxes[i].y1 }, { boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1 } };
+      wlc_render_view_paint(&output->render, &output->context, view, offset, &g);
+   }
+
+   pixman_region32_fini(&region);
+}
+
+static void
+render_view(struct wlc_output *output, struct wlc_view *view, const struct wlc_geometry *clip)
+{
+   assert(output && clip);
+
+   if (!view || !view->painted.visible || view->painted.plane || !intersects(&view->painted.bounds, clip))
+      return;
+
+   paint_view(output, view, &view->clip, NULL, clip);
+}
+
+static void
+render_foreign_view(struct wlc_output *output, struct foreign_view *foreign, const struct wlc_geometry *clip)
+{
+   assert(output && foreign && clip);
+
+   struct wlc_view *view;
+   if (!intersects(&foreign->bounds, clip) || !(view = convert_from_wlc_handle(foreign->view, WLC_TYPE_VIEW)))
+      return;
+
+   paint_view(output, view, &foreign->clip, &foreign->offset, clip);
+}
+
+static void
+queue_surface_callbacks(struct wlc_surface *surface, struct chck_iter_pool *callbacks)
+{
+   assert(surface && callbacks);
+
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->commit.frame_cbs, r)
+      chck_iter_pool_push_back(callbacks, r);
+   chck_iter_pool_flush(&surface->commit.frame_cbs);
+
+   // Sub-surfaces were shown in the same frame
+   chck_iter_pool_for_each(&surface->tree.current, r) {
+      struct wlc_surface *child;
+      if (*r && (child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) && child->commit.attached)
+         queue_surface_callbacks(child, callbacks);
+   }
+}
+
+static void
+queue_frame_callbacks(struct wlc_view *view, struct chck_iter_pool *callbacks)
+{
+   assert(callbacks);
+
+   struct wlc_surface *surface;
+   if (!view || !(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
+      return;
+
+   queue_surface_callbacks(surface, callbacks);
+}
+
+// Presentation feedback waiting for the frame to hit the screen
+struct feedback {
+   wlc_resource resource;
+   bool zero_copy;
+};
+
+static void
+queue_surface_feedbacks(struct wlc_output *output, struct wlc_surface *surface, bool zero_copy)
+{
+   assert(output && surface);
+
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->commit.feedbacks, r) {
+      struct feedback f = { *r, zero_copy };
+      if (!chck_iter_pool_push_back(&output->feedbacks, &f))
+         wlc_presentation_feedback_discarded(*r);
+   }
+   chck_iter_pool_flush(&surface->commit.feedbacks);
+
+   chck_iter_pool_for_each(&surface->tree.current, r) {
+      struct wlc_surface *child;
+      if (*r && (child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) && child->commit.attached)
+         queue_surface_feedbacks(output, child, zero_copy);
+   }
+}
+
+static void
+queue_feedbacks(struct wlc_output *output)
+{
+   assert(output);
+
+   // Every visible view shows its latest commit in this frame, whether painted, on a plane or scanned out
+   struct wlc_view **v;
+   chck_iter_pool_for_each(&output->visible, v) {
+      struct wlc_surface *surface;
+      if ((surface = convert_from_wlc_resource((*v)->surface, WLC_TYPE_SURFACE)))
+         queue_surface_feedbacks(output, surface, (output->state.scanout || (*v)->painted.plane));
+   }
+}
+
+static void
+send_feedbacks(struct wlc_output *output, const struct timespec *ts, uint64_t seq, uint32_t flags)
+{
+   assert(output && ts);
+
+   // Refresh must be zero when the output has no constant rate, we only know it when the mode tells
+   const struct wlc_output_mode *mode;
+   uint32_t refresh = 0;
+   if (output->active.mode != UINT_MAX && (mode = chck_iter_pool_get(&output->information.modes, output->active.mode)) && mode->refresh > 0)
+      refresh = 1000000000000LL / mode->refresh;
+
+   struct feedback *f;
+   chck_iter_pool_for_each(&output->feedbacks, f)
+      wlc_presentation_feedback_presented(f->resource, output, ts, refresh, seq, flags | (f->zero_copy ? WLC_FRAME_ZERO_COPY : 0));
+   chck_iter_pool_flush(&output->feedbacks);
+}
+
+// Buffer of the view if the hardware can show it as is, without the renderer
+static struct wlc_buffer*
+hardware_buffer(struct wlc_view *view)
+{
+   assert(view);
+
+   // Renderer dims inactive views
+   if (!(view->commit.state & WLC_BIT_ACTIVATED) && !(view->type & WLC_BIT_UNMANAGED))
+      return NULL;
+
+   // Renderer draws borders around letterboxed views
+   struct wlc_geometry b, v;
+   wlc_view_get_bounds(view, &b, &v);
+   if (!wlc_geometry_equals(&b, &v))
+      return NULL;
+
+   // Sub-surfaces are composited on top of the buffer
+   struct wlc_surface *surface;
+   if (!(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)) || surface->tree.current.items.count)
+      return NULL;
+
+   if (surface->commit.scale != 1 || surface->commit.transform != WL_OUTPUT_TRANSFORM_NORMAL || (surface->format != SURFACE_RGB && surface->format != SURFACE_RGBA))
+      return NULL;
+
+   // Planes show the buffer unscaled, scaled views are left for the renderer
+   if (!wlc_size_equals(&surface->size, &b.size))
+      return NULL;
+
+   // SHM buffers need to be copied anyway, only hardware buffers can be scanned out
+   struct wlc_buffer *buffer;
+   if (!(buffer = wlc_surface_get_buffer(surface)) || !buffer->y_inverted || wl_shm_buffer_get(convert_to_wl_resource(buffer, WLC_TYPE_BUFFER)))
+      return NULL;
+
+   return buffer;
+}
+
+static struct wlc_buffer*
+scanout_buffer(struct wlc_output *output)
+{
+   assert(output);
+
+   // Only a single view covering the whole output with nothing painted over it
+   if (output->state.overlay || output->task.pixels.cb || output->capture.cb || output->foreign.items.count || output->visible.items.count != 1 || !wlc_size_equals(&output->mode, &output->resolution))
+      return NULL;
+
+   struct wlc_view *view = *(struct wlc_view**)output->visible.items.buffer;
+   const struct wlc_geometry full = { wlc_origin_zero, output->resolution };
+
+   struct wlc_surface *surface;
+   if (!(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)) || !wlc_size_equals(&surface->size, &output->resolution))
+      return NULL;
+
+   struct wlc_geometry o;
+   if (!wlc_geometry_equals(&view->painted.bounds, &full) || !wlc_view_get_opaque(view, &o) || !wlc_geometry_equals(&o, &full))
+      return NULL;
+
+   return hardware_buffer(view);
+}
+
+static void
+assign_planes(struct wlc_output *output)
+{
+   assert(output);
+
+   wlc_backend_surface_assign_plane(&output->bsurface, NULL, NULL);
+
+   // Overlays are above everything the renderer paints and can't be scaled with the output
+   const bool usable = (output->bsurface.api.assign_plane && !output->state.overlay && !output->task.pixels.cb && !output->capture.cb && !output->foreign.items.count && wlc_size_equals(&output->mode, &output->resolution));
+
+   // Walk front to back, a view can be lifted to a plane only if nothing composited is above it
+   pixman_region32_t above;
+   pixman_region32_init(&above);
 
-   bool visible = false;
-   const size_t gsz = r->w * r->h;
-   assert(b->x - a->x >= 0);
-   assert(a->x >= 0 && b->x <= (int32_t)r->w && a->y >= 0 && b->y <= (int32_t)r->h);
-   for (int32_t y = a->y; y < b->y; ++y) {
-      const size_t off = a->x + y * r->w, memb = (b->x - a->x);
-      assert(off + memb <= gsz);
+   struct wlc_view **v;
+   chck_iter_pool_for_each_reverse(&output->visible, v) {
+      const struct wlc_geometry *b = &(*v)->painted.bounds;
 
-      if (!visible && memchr(g + off, false, memb)) {
-         visible = true;
+      bool plane = false;
+      if (usable && b->origin.x >= 0 && b->origin.y >= 0 &&
+          b->origin.x + b->size.w <= output->resolution.w && b->origin.y + b->size.h <= output->resolution.h &&
+          pixman_region32_contains_rectangle(&above, &(pixman_box32_t){ b->origin.x, b->origin.y, b->origin.x + b->size.w, b->origin.y + b->size.h }) == PIXMAN_REGION_OUT) {
+         struct wlc_buffer *buffer;
+         plane = ((buffer = hardware_buffer(*v)) && wlc_backend_surface_assign_plane(&output->bsurface, buffer, b));
+      }
 
-         if (!should_blit)
-            return true;
+      // Primary buffer has either stale or no content of the view
+      if (plane != (*v)->painted.plane) {
+         add_view_damage(output, b);
+         invalidate_foreign_views(output, false);
+         (*v)->painted.plane = plane;
       }
 
-      if (should_blit)
-         memset(g + off, true, memb);
+      if (!plane)
+         pixman_region32_union_rect(&above, &above, b->origin.x, b->origin.y, b->size.w, b->size.h);
    }
 
-   return visible;
+   pixman_region32_fini(&above);
 }
 
 static bool
-get_visible_views(struct wlc_output *output, struct chck_iter_pool *visible)
+scanout(struct wlc_output *output)
 {
-   assert(output && output->blit);
+   assert(output);
 
-   const size_t gsz = output->resolution.w * output->resolution.h;
-   memset(output->blit, false, gsz);
+   struct wlc_buffer *buffer;
+   if (!(buffer = scanout_buffer(output)) || !wlc_backend_surface_scanout(&output->bsurface, buffer))
+      return false;
 
-   wlc_handle *h;
-   chck_iter_pool_for_each_reverse(&output->views, h) {
-      struct wlc_view *v;
-      struct wlc_surface *s;
-      if (!(v = convert_from_wlc_handle(*h, "view")) ||
-          !(s = convert_from_wlc_resource(v->surface, "surface")))
-         continue;
+   // Frame went straight to screen, damage was not painted to any of our buffers
+   pixman_region32_clear(&output->damage);
+   output->state.scanout = true;
+   output->state.pending = true;
+   queue_feedbacks(output);
+   return true;
+}
 
-      if (!view_visible(v, s, output->active.mask))
-         continue;
+static void
+send_frame_callbacks(struct wlc_output *output)
+{
+   assert(output);
 
-      struct wlc_geometry o;
-      struct wlc_origin a, b;
-      const bool should_blit = wlc_view_get_opaque(v, &o);
-      a.x = chck_clamp32(o.origin.x, 0, output->resolution.w);
-      a.y = chck_clamp32(o.origin.y, 0, output->resolution.h);
-      b.x = chck_clamp32((o.origin.x + o.size.w), 1, output->resolution.w);
-      b.y = chck_clamp32((o.origin.y + o.size.h), 1, output->resolution.h);
-
-      if (!blit(output->blit, &output->resolution, &a, &b, should_blit)) {
-         wlc_dlog(WLC_DBG_RENDER_LOOP, "%" PRIuWLC " is not visible", *h);
-         continue;
-      }
+   struct wlc_view **v;
+   chck_iter_pool_for_each(&output->visible, v)
+      queue_frame_callbacks(*v, &output->callbacks);
+   chck_iter_pool_flush(&output->visible);
 
-      chck_iter_pool_push_front(visible, &v);
+   wlc_resource *r;
+   chck_iter_pool_for_each(&output->callbacks, r) {
+      struct wl_resource *resource;
+      if ((resource = wl_resource_from_wlc_resource(*r, WLC_TYPE_CALLBACK)))
+         wl_callback_send_done(resource, output->state.frame_time);
+      wlc_resource_release_ptr(r);
    }
+   chck_iter_pool_flush(&output->callbacks);
+}
 
-   return memchr(output->blit, false, gsz);
+static int64_t
+timespec_to_nsec(const struct timespec *ts)
+{
+   assert(ts);
+   return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
 }
 
-static void
-finish_frame_tasks(struct wlc_output *output)
+static int64_t
+refresh_nsec(struct wlc_output *output)
 {
    assert(output);
 
-   if (output->task.bsurface.display) {
-      wlc_output_set_backend_surface(output, (output->task.bsurface.display == INVALID_DISPLAY ? NULL : &output->task.bsurface));
-      memset(&output->task.bsurface, 0, sizeof(output->task.bsurface));
-   }
-
-   if (output->task.sleep) {
-      wlc_output_set_sleep_ptr(output, true);
-      output->task.sleep = false;
-   }
+   // Assume 60Hz when the mode doesn't tell
+   const struct wlc_output_mode *mode;
+   if (output->active.mode == UINT_MAX || !(mode = chck_iter_pool_get(&output->information.modes, output->active.mode)) || mode->refresh <= 0)
+      return 1000000000000LL / 60000;
 
-   if (output->task.terminate) {
-      wlc_output_terminate(output);
-      output->task.terminate = false;
-   }
+   return 1000000000000LL / mode->refresh;
 }
 
-static void
-render_view(struct wlc_output *output, struct wlc_view *view, struct chck_iter_pool *callbacks)
+// First vblank after now, extrapolated from the last presented frame
+static int64_t
+next_vblank(struct wlc_output *output, int64_t now)
 {
-   assert(output && callbacks);
+   assert(output);
 
-   if (!view)
-      return;
+   if (!output->schedule.vblank)
+      return now;
 
-   struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource(view->surface, "surface")))
-      return;
+   const int64_t refresh = refresh_nsec(output);
+   if (output->schedule.vblank > now)
+      return output->schedule.vblank + refresh;
 
-   if (!view_visible(view, surface, output->active.mask))
-      return;
+   return output->schedule.vblank + refresh * ((now - output->schedule.vblank) / refresh + 1);
+}
 
-   wlc_view_commit_state(view, &view->pending, &view->commit);
-   wlc_render_view_paint(&output->render, &output->context, view);
+static void
+schedule_repaint_timer(struct wlc_output *output)
+{
+   assert(output);
 
-   wlc_resource *r;
-   chck_iter_pool_for_each(&surface->commit.frame_cbs, r)
-      chck_iter_pool_push_back(callbacks, r);
-   chck_iter_pool_flush(&surface->commit.frame_cbs);
+   struct timespec ts;
+   wlc_get_time(&ts);
+   const int64_t now = timespec_to_nsec(&ts);
+
+   // Start composition margin before the vblank, or right away when already inside the margin
+   const int64_t refresh = refresh_nsec(output);
+   const int64_t margin = (output->options.repaint_margin < refresh ? output->options.repaint_margin : refresh);
+   const int64_t start = next_vblank(output, now) - margin;
+   const int32_t ms = (start > now ? (start - now) / 1000000 : 0);
+
+   wl_event_source_timer_update(output->timer.idle, chck_max32(ms, 1));
+   output->state.scheduled = true;
+   wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Repaint scheduled in %d ms", chck_max32(ms, 1));
 }
 
 static bool
@@ -244,6 +1190,12 @@ repaint(struct wlc_output *output)
       return false;
    }
 
+   {
+      struct timespec ts;
+      wlc_get_time(&ts);
+      output->schedule.target = next_vblank(output, timespec_to_nsec(&ts));
+   }
+
    wlc_render_time(&output->render, &output->context, output->state.frame_time);
    wlc_render_resolution(&output->render, &output->context, &output->mode, &output->resolution);
 
@@ -251,11 +1203,19 @@ repaint(struct wlc_output *output)
       // fake sleep
       wlc_render_clear(&output->render, &output->context);
       output->state.pending = true;
-      wlc_context_swap(&output->context, &output->bsurface);
+      wlc_context_swap(&output->context, &output->bsurface, NULL);
       wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Repaint");
       return true;
    }
 
+   damage_views(output);
+
+   output->state.overlay = false;
+   output->state.cursor = wlc_geometry_zero;
+   struct wlc_render_event ev = { .output = output, .type = WLC_RENDER_EVENT_DAMAGE };
+   wl_signal_emit(&wlc_system_signals()->render, &ev);
+
+   get_foreign_views(output);
    const bool bg_visible = get_visible_views(output, &output->visible);
 
    if (!output->state.background_visible && bg_visible) {
@@ -266,49 +1226,107 @@ repaint(struct wlc_output *output)
       output->state.background_visible = false;
    }
 
-   if (output->options.enable_bg && output->state.background_visible) {
-      wlc_render_background(&output->render, &output->context);
-   } else if (!output->options.enable_bg) {
-      wlc_render_clear(&output->render, &output->context);
+   if (scanout(output)) {
+      send_frame_callbacks(output);
+      wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Scanout");
+      return true;
    }
 
-
-   {
-      struct wlc_view **v;
-      chck_iter_pool_for_each(&output->visible, v)
-         render_view(output, *v, &output->callbacks);
-      chck_iter_pool_flush(&output->visible);
+   // Buffers were not updated while scanning out client buffer, repaint them fully
+   if (output->state.scanout) {
+      add_damage(output, &(struct wlc_geometry){ wlc_origin_zero, output->resolution });
+      output->state.scanout = false;
    }
 
-   struct wlc_render_event ev = { .output = output, .type = WLC_RENDER_EVENT_POINTER };
-   wl_signal_emit(&wlc_system_signals()->render, &ev);
+   assign_planes(output);
+
+   // Background is animated
+   if (output->options.enable_bg && output->state.background_visible)
+      add_damage(output, &(struct wlc_geometry){ wlc_origin_zero, output->resolution });
+
+   pixman_region32_t damage, repaint;
+   get_frame_damage(output, &damage, &repaint);
+
+   // Cursor is painted once over all rectangles, so everything under it must be repainted when any of it is
+   const struct wlc_geometry *cursor = &output->state.cursor;
+   pixman_box32_t cursor_box = { cursor->origin.x, cursor->origin.y, cursor->origin.x + (int32_t)cursor->size.w, cursor->origin.y + (int32_t)cursor->size.h };
+   const bool paint_cursor = (cursor->size.w > 0 && pixman_region32_contains_rectangle(&repaint, &cursor_box) != PIXMAN_REGION_OUT);
+   if (paint_cursor) {
+      pixman_region32_union_rect(&repaint, &repaint, cursor->origin.x, cursor->origin.y, cursor->size.w, cursor->size.h);
+      pixman_region32_intersect_rect(&repaint, &repaint, 0, 0, output->resolution.w, output->resolution.h);
+   }
 
    {
-      size_t sz;
-      void *rgba;
-      struct wlc_geometry g = { { 0, 0 }, output->resolution };
-      if (output->task.pixels.cb && !chck_mul_ofsz(g.size.w, g.size.h, &sz) && (rgba = chck_calloc_of(4, sz))) {
-         wlc_render_read_pixels(&output->render, &output->context, &g, rgba);
-         if (!output->task.pixels.cb(&g.size, rgba, output->task.pixels.arg))
-            free(rgba);
-         memset(&output->task.pixels, 0, sizeof(output->task.pixels));
+      int nrects;
+      const pixman_box32_t *boxes = pixman_region32_rectangles(&repaint, &nrects);
+      if (nrects > MAX_PAINT_RECTS) {
+         boxes = pixman_region32_extents(&repaint);
+         nrects = 1;
+      }
+
+      // Clear and background cover the whole output, so they need the scissor
+      if (!output->options.enable_bg || output->state.background_visible) {
+         for (int i = 0; i < nrects; ++i) {
+            const struct wlc_geometry clip = { { boxes[i].x1, boxes[i].y1 }, { boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1 } };
+            wlc_render_scissor(&output->render, &output->context, &clip);
+
+            if (output->options.enable_bg) {
+               wlc_render_background(&output->render, &output->context);
+            } else {
+               wlc_render_clear(&output->render, &output->context);
+            }
+         }
+
+         wlc_render_scissor(&output->render, &output->context, NULL);
+      }
+
+      // Views are clipped by the renderer, painting each of them over all rectangles in turn keeps its quads in one batch.
+      // The rectangles do not overlap, so stacking order only matters between views.
+      struct foreign_view *f;
+      chck_iter_pool_for_each(&output->foreign, f) {
+         for (int i = 0; i < nrects; ++i) {
+            const struct wlc_geometry clip = { { boxes[i].x1, boxes[i].y1 }, { boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1 } };
+            render_foreign_view(output, f, &clip);
+         }
+      }
+
+      struct wlc_view **v;
+      chck_iter_pool_for_each(&output->visible, v) {
+         for (int i = 0; i < nrects; ++i) {
+            const struct wlc_geometry clip = { { boxes[i].x1, boxes[i].y1 }, { boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1 } };
+            render_view(output, *v, &clip);
+         }
+      }
+
+      if (paint_cursor) {
+         wlc_render_scissor(&output->render, &output->context, cursor);
+         ev.type = WLC_RENDER_EVENT_POINTER;
+         wl_signal_emit(&wlc_system_signals()->render, &ev);
       }
+
+      wlc_render_flush(&output->render, &output->context);
+      wlc_render_scissor(&output->render, &output->context, NULL);
+      wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Painted %d damage rectangles", nrects);
    }
 
+   pixman_region32_fini(&repaint);
+
+   read_pixels(output);
+   capture_frame(output, &damage);
    output->state.pending = true;
-   wlc_context_swap(&output->context, &output->bsurface);
+
+   // Backends may finish the frame already during the swap
+   queue_feedbacks(output);
 
    {
-      wlc_resource *r;
-      chck_iter_pool_for_each(&output->callbacks, r) {
-         struct wl_resource *resource;
-         if ((resource = wl_resource_from_wlc_resource(*r, "callback")))
-            wl_callback_send_done(resource, output->state.frame_time);
-         wlc_resource_release_ptr(r);
-      }
-      chck_iter_pool_flush(&output->callbacks);
+      pixman_region32_t surface_damage;
+      damage_to_surface(output, &damage, &surface_damage);
+      wlc_context_swap(&output->context, &output->bsurface, &surface_damage);
+      pixman_region32_fini(&surface_damage);
+      pixman_region32_fini(&damage);
    }
 
+   send_frame_callbacks(output);
    wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Repaint");
    return true;
 }
@@ -317,12 +1335,31 @@ static int
 cb_idle_timer(void *data)
 {
    assert(data);
-   repaint(convert_from_wlc_handle((wlc_handle)data, "output"));
+   repaint(convert_from_wlc_handle((wlc_handle)data, WLC_TYPE_OUTPUT));
+   return 1;
+}
+
+static int
+cb_readback_timer(void *data)
+{
+   assert(data);
+
+   struct wlc_output *output;
+   if (!(output = convert_from_wlc_handle((wlc_handle)data, WLC_TYPE_OUTPUT)))
+      return 1;
+
+   fetch_pixels(output, false);
+   capture_fetch(output, false);
+
+   // Frames skipped while the capture slot was busy still need to be read
+   if (output->capture.cb && !output->capture.pending && pixman_region32_not_empty(&output->capture.damage))
+      wlc_output_schedule_repaint(output);
+
    return 1;
 }
 
 void
-wlc_output_finish_frame(struct wlc_output *output, const struct timespec *ts)
+wlc_output_finish_frame(struct wlc_output *output, const struct timespec *ts, uint64_t seq, uint32_t flags)
 {
    assert(ts);
 
@@ -331,20 +1368,22 @@ wlc_output_finish_frame(struct wlc_output *output, const struct timespec *ts)
 
    output->state.pending = false;
 
-   // XXX: uint32_t holds mostly for 50 days before overflowing
-   //      is this tied to wayland somewhere, or should we increase precision?
-   const uint32_t last = output->state.frame_time;
+   // wl_callback.done time wraps around, clients wanting precision use presentation feedback
    output->state.frame_time = ts->tv_sec * 1000 + ts->tv_nsec / 1000000;
-   const uint32_t ms = output->state.frame_time - last;
+   send_feedbacks(output, ts, seq, flags);
 
-   // TODO: handle presentation feedback here
+   const int64_t presented = timespec_to_nsec(ts);
+   if (output->schedule.target && presented > output->schedule.target + refresh_nsec(output) / 2) {
+      output->schedule.missed++;
+      wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Missed vblank by %.2f ms (%u missed)", (presented - output->schedule.target) / 1000000.0, output->schedule.missed);
+   }
+
+   output->schedule.vblank = presented;
+   output->schedule.target = 0;
 
    if (((output->options.enable_bg && output->state.background_visible) || output->state.activity) && !output->task.terminate) {
-      output->state.ims = chck_clampf(output->state.ims * (output->state.activity ? 0.9 : 1.1), 1, 41);
-      wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Interpolated idle time %f (%u : %d)", output->state.ims, ms, output->state.activity);
-      wl_event_source_timer_update(output->timer.idle, output->state.ims);
-      output->state.scheduled = true;
       output->state.activity = false;
+      schedule_repaint_timer(output);
    } else {
       output->state.scheduled = false;
    }
@@ -353,16 +1392,14 @@ wlc_output_finish_frame(struct wlc_output *output, const struct timespec *ts)
    finish_frame_tasks(output);
 }
 
-void
-wlc_output_surface_destroy(struct wlc_output *output, struct wlc_surface *surface)
+static void
+unlink_surface(struct wlc_output *output, struct wlc_surface *surface)
 {
-   if (!output)
-      return;
-
-   assert(surface && surface->output == convert_to_wlc_handle(output));
+   assert(output && surface);
 
-   wlc_render_surface_destroy(&output->render, &output->context, surface);
-   surface->output = 0;
+   struct wlc_view *view;
+   if ((view = convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW)))
+      damage_painted_view(output, view);
 
    wlc_output_schedule_repaint(output);
 
@@ -374,18 +1411,68 @@ wlc_output_surface_destroy(struct wlc_output *output, struct wlc_surface *surfac
       chck_iter_pool_remove(&output->surfaces, _I - 1);
       break;
    }
+}
+
+void
+wlc_output_surface_destroy(struct wlc_output *output, struct wlc_surface *surface)
+{
+   if (!output)
+      return;
+
+   assert(surface && surface->output == convert_to_wlc_handle(output));
+
+   wlc_render_surface_destroy(&output->render, &output->context, surface);
+   surface->output = 0;
+   unlink_surface(output, surface);
 
    wlc_dlog(WLC_DBG_RENDER, "-> Deattached surface (%" PRIuWLC ") from output (%" PRIuWLC ")", convert_to_wlc_resource(surface), convert_to_wlc_handle(output));
 }
 
+void
+wlc_output_buffer_destroy(struct wlc_output *output, struct wlc_buffer *buffer)
+{
+   assert(buffer);
+
+   if (!output || buffer->cache.output != convert_to_wlc_handle(output))
+      return;
+
+   wlc_render_buffer_destroy(&output->render, &output->context, buffer);
+}
+
+static bool
+move_surface(struct wlc_output *output, struct wlc_surface *surface, struct wlc_buffer *buffer)
+{
+   assert(output && surface);
+
+   // Textures live in the share group of both contexts, contents of current buffer are already there
+   struct wlc_output *old;
+   if (!(old = convert_from_wlc_handle(surface->output, WLC_TYPE_OUTPUT)) || buffer != wlc_surface_get_buffer(surface) || !wlc_context_shares(&old->context, &output->context))
+      return false;
+
+   wlc_resource r = convert_to_wlc_resource(surface);
+   if (!chck_iter_pool_push_back(&output->surfaces, &r))
+      return false;
+
+   unlink_surface(old, surface);
+   surface->output = convert_to_wlc_handle(output);
+
+   wlc_dlog(WLC_DBG_RENDER, "-> Moved surface (%" PRIuWLC ") from output (%" PRIuWLC ") to output (%" PRIuWLC ")", r, convert_to_wlc_handle(old), convert_to_wlc_handle(output));
+   return true;
+}
+
 bool
-wlc_output_surface_attach(struct wlc_output *output, struct wlc_surface *surface, struct wlc_buffer *buffer)
+wlc_output_surface_attach(struct wlc_output *output, struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage)
 {
    assert(surface);
 
    if (!output)
       return false;
 
+   if (surface->output != convert_to_wlc_handle(output) && move_surface(output, surface, buffer)) {
+      wlc_output_schedule_repaint(output);
+      return true;
+   }
+
    bool new_surface = false;
    if (surface->output != convert_to_wlc_handle(output)) {
       wlc_surface_invalidate(surface);
@@ -393,7 +1480,8 @@ wlc_output_surface_attach(struct wlc_output *output, struct wlc_surface *surface
       new_surface = true;
    }
 
-   if (!wlc_render_surface_attach(&output->render, &output->context, surface, buffer)) {
+   // Textures of new surface have no contents yet
+   if (!wlc_render_surface_attach(&output->render, &output->context, surface, buffer, (new_surface ? NULL : damage))) {
       surface->output = 0;
       return false;
    }
@@ -416,7 +1504,7 @@ static bool
 attach_view(struct wlc_output *output, struct wlc_view *view)
 {
    struct wlc_surface *surface;
-   if (!output || !view || !(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!output || !view || !(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return false;
 
    return wlc_surface_attach_to_output(surface, output, wlc_surface_get_buffer(surface));
@@ -433,12 +1521,44 @@ wlc_output_schedule_repaint(struct wlc_output *output)
 
    output->state.activity = true;
 
-   if (output->state.scheduled)
+   // Frame in flight schedules the next one when it's presented
+   if (output->state.scheduled || output->state.pending)
       return;
 
-   output->state.scheduled = true;
-   wl_event_source_timer_update(output->timer.idle, 1);
-   wlc_dlog(WLC_DBG_RENDER_LOOP, "-> Repaint scheduled");
+   schedule_repaint_timer(output);
+}
+
+void
+wlc_output_damage(struct wlc_output *output, pixman_region32_t *damage)
+{
+   assert(damage);
+
+   if (!output)
+      return;
+
+   pixman_region32_union(&output->damage, &output->damage, damage);
+   wlc_output_schedule_repaint(output);
+}
+
+void
+wlc_output_damage_geometry(struct wlc_output *output, const struct wlc_geometry *geometry)
+{
+   assert(geometry);
+
+   if (!output)
+      return;
+
+   add_damage(output, geometry);
+   wlc_output_schedule_repaint(output);
+}
+
+void
+wlc_output_damage_all(struct wlc_output *output)
+{
+   if (!output)
+      return;
+
+   wlc_output_damage_geometry(output, &(struct wlc_geometry){ wlc_origin_zero, output->resolution });
 }
 
 bool
@@ -459,11 +1579,14 @@ wlc_output_set_backend_surface(struct wlc_output *output, struct wlc_backend_sur
       return true;
    }
 
+   fetch_pixels(output, true);
+   capture_fetch(output, true);
+
    {
       wlc_resource *r;
       chck_iter_pool_for_each(&output->surfaces, r) {
          struct wlc_surface *s;
-         if ((s = convert_from_wlc_resource(*r, "surface")))
+         if ((s = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)))
             wlc_render_surface_destroy(&output->render, &output->context, s);
       }
    }
@@ -492,18 +1615,23 @@ wlc_output_set_backend_surface(struct wlc_output *output, struct wlc_backend_sur
          wlc_resource *r;
          chck_iter_pool_for_each(&output->surfaces, r) {
             struct wlc_surface *s;
-            if (!(s = convert_from_wlc_resource(*r, "surface")))
+            if (!(s = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)))
                continue;
 
             wlc_surface_attach_to_output(s, output, wlc_surface_get_buffer(s));
          }
       }
 
+      // Contents of the new surface are undefined
+      wlc_output_damage_all(output);
       wlc_log(WLC_LOG_INFO, "Set new bsurface to output (%" PRIuWLC ")", convert_to_wlc_handle(output));
    } else {
       wlc_log(WLC_LOG_INFO, "Removed bsurface from output (%" PRIuWLC ")", convert_to_wlc_handle(output));
    }
 
+   // Views are shared only between outputs of shared contexts
+   invalidate_foreign_views(output, true);
+
    struct wlc_output_event ev = { .surface = { .output = output }, .type = WLC_OUTPUT_EVENT_SURFACE };
    wl_signal_emit(&wlc_system_signals()->output, &ev);
    return true;
@@ -525,6 +1653,11 @@ wlc_output_set_information(struct wlc_output *output, struct wlc_output_informat
       memset(info, 0, sizeof(output->information));
    }
 
+   if (output->layout.placed) {
+      output->information.x = output->layout.origin.x;
+      output->information.y = output->layout.origin.y;
+   }
+
    output->active.mode = UINT_MAX;
 
    if (!info)
@@ -584,6 +1717,7 @@ wlc_output_unlink_view(struct wlc_output *output, struct wlc_view *view)
 
    remove_from_pool(&output->views, convert_to_wlc_handle(view));
    remove_from_pool(&output->mutable, convert_to_wlc_handle(view));
+   damage_painted_view(output, view);
    wlc_output_schedule_repaint(output);
 }
 
@@ -602,6 +1736,10 @@ wlc_output_link_view(struct wlc_output *output, struct wlc_view *view, enum outp
          remove_from_pool(&old->mutable, convert_to_wlc_handle(view));
    }
 
+   // Stacking order changes, damage the old area and let next repaint damage the new one
+   damage_painted_view(old, view);
+   wlc_output_schedule_repaint(old);
+
    bool added = false;
    wlc_handle handle = convert_to_wlc_handle(view);
 
@@ -639,6 +1777,45 @@ wlc_output_link_view(struct wlc_output *output, struct wlc_view *view, enum outp
    wlc_output_schedule_repaint(output);
 }
 
+void
+wlc_output_set_position_ptr(struct wlc_output *output, const struct wlc_origin *origin)
+{
+   assert(origin);
+
+   if (!output || (output->layout.placed && output->layout.origin.x == origin->x && output->layout.origin.y == origin->y))
+      return;
+
+   if (!output->layout.placed) {
+      wlc_handle h = convert_to_wlc_handle(output);
+      if (!output->layout.outputs || !chck_iter_pool_push_back(output->layout.outputs, &h))
+         return;
+   }
+
+   const struct wlc_geometry area = { wlc_origin_zero, output->resolution };
+   forward_damage(output, &area);
+
+   output->layout.origin = *origin;
+   output->layout.placed = true;
+   output->information.x = origin->x;
+   output->information.y = origin->y;
+
+   invalidate_foreign_views(output, true);
+   forward_damage(output, &area);
+   wlc_output_damage_all(output);
+
+   wlc_resource *r;
+   wlc_slab_for_each(&output->resources.pool, r) {
+      struct wl_resource *wr;
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_OUTPUT)))
+         continue;
+
+      send_geometry(output, wr);
+
+      if (wl_resource_get_version(wr) >= WL_OUTPUT_DONE_SINCE_VERSION)
+         wl_output_send_done(wr);
+   }
+}
+
 void
 wlc_output_set_resolution_ptr(struct wlc_output *output, const struct wlc_size *resolution)
 {
@@ -655,19 +1832,19 @@ wlc_output_set_resolution_ptr(struct wlc_output *output, const struct wlc_size *
    if (wlc_size_equals(resolution, &output->resolution))
       return;
 
-   size_t gsz;
-   if (chck_mul_ofsz(resolution->w, resolution->h, &gsz)) {
-      wlc_log(WLC_LOG_WARN, "Requested resolution %ux%u overflows when multiplied, ignoring resolution", resolution->w, resolution->h);
+   // Damage and occlusion regions use signed 32bit coordinates
+   if (resolution->w > INT32_MAX || resolution->h > INT32_MAX) {
+      wlc_log(WLC_LOG_WARN, "Requested resolution %ux%u is too large, ignoring resolution", resolution->w, resolution->h);
       return;
    }
 
-   free(output->blit);
-   except(output->blit = calloc(1, gsz));
-
    struct wlc_size old = output->resolution;
+   forward_damage(output, &(struct wlc_geometry){ wlc_origin_zero, old });
    output->resolution = *resolution;
+   invalidate_foreign_views(output, true);
+   forward_damage(output, &(struct wlc_geometry){ wlc_origin_zero, output->resolution });
    WLC_INTERFACE_EMIT(output.resolution, convert_to_wlc_handle(output), &old, &output->resolution);
-   wlc_output_schedule_repaint(output);
+   wlc_output_damage_all(output);
 }
 
 void
@@ -688,7 +1865,7 @@ wlc_output_set_sleep_ptr(struct wlc_output *output, bool sleep)
       output->bsurface.api.sleep(&output->bsurface, sleep);
 
    if (!(output->state.sleeping = sleep)) {
-      wlc_output_schedule_repaint(output);
+      wlc_output_damage_all(output);
       wlc_log(WLC_LOG_INFO, "Output (%p) wake up", output);
    } else {
       if (output->bsurface.api.sleep) {
@@ -707,23 +1884,73 @@ wlc_output_set_mask_ptr(struct wlc_output *output, uint32_t mask)
       return;
 
    output->active.mask = mask;
-   wlc_output_schedule_repaint(output);
+   wlc_output_damage_all(output);
 }
 
 void
-wlc_output_get_pixels_ptr(struct wlc_output *output, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg)
+wlc_output_get_pixels_ptr(struct wlc_output *output, const struct wlc_geometry *geometry, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg)
 {
    assert(pixels);
 
    if (!output)
       return;
 
+   // Only one read back at a time, finish the one in flight
+   fetch_pixels(output, true);
+
+   struct wlc_geometry g = { { 0, 0 }, output->resolution };
+   if (geometry) {
+      const int32_t x1 = chck_max32(geometry->origin.x, 0), y1 = chck_max32(geometry->origin.y, 0);
+      const int32_t x2 = chck_min32(geometry->origin.x + (int32_t)geometry->size.w, output->resolution.w);
+      const int32_t y2 = chck_min32(geometry->origin.y + (int32_t)geometry->size.h, output->resolution.h);
+
+      if (x2 <= x1 || y2 <= y1)
+         return;
+
+      g = (struct wlc_geometry){ { x1, y1 }, { x2 - x1, y2 - y1 } };
+   }
+
    // TODO: we need real task system, not like we do right now.
    output->task.pixels.cb = pixels;
    output->task.pixels.arg = arg;
+   geometry_to_surface(output, &g, &output->task.pixels.geometry);
    wlc_output_schedule_repaint(output);
 }
 
+bool
+wlc_output_start_capture_ptr(struct wlc_output *output, void (*frame)(const struct wlc_size *size, const uint8_t *rgba, const struct wlc_geometry *damage, size_t memb, void *arg), void *arg)
+{
+   assert(frame);
+
+   if (!output)
+      return false;
+
+   capture_release(output);
+
+   if (!chck_iter_pool(&output->capture.rects, 32, 0, sizeof(struct wlc_geometry)))
+      return false;
+
+   for (uint32_t i = 0; i < LENGTH(output->capture.buffers); ++i)
+      pixman_region32_init(&output->capture.buffers[i].stale);
+
+   pixman_region32_init(&output->capture.damage);
+   output->capture.cb = frame;
+   output->capture.arg = arg;
+
+   // First frame is read fully
+   wlc_output_damage_all(output);
+   return true;
+}
+
+void
+wlc_output_stop_capture_ptr(struct wlc_output *output)
+{
+   if (!output)
+      return;
+
+   capture_release(output);
+}
+
 bool
 wlc_output_set_views_ptr(struct wlc_output *output, const wlc_handle *views, size_t memb)
 {
@@ -732,9 +1959,12 @@ wlc_output_set_views_ptr(struct wlc_output *output, const wlc_handle *views, siz
 
    wlc_handle *h;
    chck_iter_pool_for_each(&output->views, h)
-      attach_view(output, convert_from_wlc_handle(*h, "view"));
+      attach_view(output, convert_from_wlc_handle(*h, WLC_TYPE_VIEW));
 
-   wlc_output_schedule_repaint(output);
+   // Stacking order shows on overlapping outputs too
+   invalidate_foreign_views(output, false);
+   forward_damage(output, &(struct wlc_geometry){ wlc_origin_zero, output->resolution });
+   wlc_output_damage_all(output);
    return true;
 }
 
@@ -772,89 +2002,123 @@ get(struct wlc_output *output, size_t offset)
 WLC_API const struct wlc_size*
 wlc_output_get_resolution(wlc_handle output)
 {
-   return get(convert_from_wlc_handle(output, "output"), offsetof(struct wlc_output, resolution));
+   return get(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), offsetof(struct wlc_output, resolution));
 }
 
 WLC_API void
 wlc_output_set_resolution(wlc_handle output, const struct wlc_size *resolution)
 {
-   wlc_output_set_resolution_ptr(convert_from_wlc_handle(output, "output"), resolution);
+   wlc_output_set_resolution_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), resolution);
 }
 
 WLC_API bool
 wlc_output_get_sleep(wlc_handle output)
 {
-   void *ptr = get(convert_from_wlc_handle(output, "output"), offsetof(struct wlc_output, state.sleeping));
+   void *ptr = get(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), offsetof(struct wlc_output, state.sleeping));
    return (ptr ? *(bool*)ptr : false);
 }
 
 WLC_API void
 wlc_output_set_sleep(wlc_handle output, bool sleep)
 {
-   wlc_output_set_sleep_ptr(convert_from_wlc_handle(output, "output"), sleep);
+   wlc_output_set_sleep_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), sleep);
 }
 
 WLC_API uint32_t
 wlc_output_get_mask(wlc_handle output)
 {
-   void *ptr = get(convert_from_wlc_handle(output, "output"), offsetof(struct wlc_output, active.mask));
+   void *ptr = get(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), offsetof(struct wlc_output, active.mask));
    return (ptr ? *(uint32_t*)ptr : 0);
 }
 
 WLC_API void
 wlc_output_set_mask(wlc_handle output, uint32_t mask)
 {
-   wlc_output_set_mask_ptr(convert_from_wlc_handle(output, "output"), mask);
+   wlc_output_set_mask_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), mask);
 }
 
 WLC_API void
 wlc_output_get_pixels(wlc_handle output, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg)
 {
-   wlc_output_get_pixels_ptr(convert_from_wlc_handle(output, "output"), pixels, arg);
+   wlc_output_get_pixels_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), NULL, pixels, arg);
+}
+
+WLC_API bool
+wlc_output_start_capture(wlc_handle output, void (*frame)(const struct wlc_size *size, const uint8_t *rgba, const struct wlc_geometry *damage, size_t memb, void *arg), void *arg)
+{
+   return wlc_output_start_capture_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), frame, arg);
+}
+
+WLC_API void
+wlc_output_stop_capture(wlc_handle output)
+{
+   wlc_output_stop_capture_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT));
+}
+
+WLC_API void
+wlc_output_set_position(wlc_handle output, const struct wlc_origin *origin)
+{
+   wlc_output_set_position_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), origin);
+}
+
+WLC_API const struct wlc_origin*
+wlc_output_get_position(wlc_handle output)
+{
+   struct wlc_output *o;
+   if (!(o = convert_from_wlc_handle(output, WLC_TYPE_OUTPUT)) || !o->layout.placed)
+      return NULL;
+
+   return &o->layout.origin;
+}
+
+WLC_API void
+wlc_output_get_pixels_region(wlc_handle output, const struct wlc_geometry *geometry, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg)
+{
+   wlc_output_get_pixels_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), geometry, pixels, arg);
 }
 
 WLC_API const wlc_handle*
 wlc_output_get_views(wlc_handle output, size_t *out_memb)
 {
-   return wlc_output_get_views_ptr(convert_from_wlc_handle(output, "output"), out_memb);
+   return wlc_output_get_views_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), out_memb);
 }
 
 WLC_API wlc_handle*
 wlc_output_get_mutable_views(wlc_handle output, size_t *out_memb)
 {
-   return wlc_output_get_mutable_views_ptr(convert_from_wlc_handle(output, "output"), out_memb);
+   return wlc_output_get_mutable_views_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), out_memb);
 }
 
 WLC_API bool
 wlc_output_set_views(wlc_handle output, const wlc_handle *views, size_t memb)
 {
-   return wlc_output_set_views_ptr(convert_from_wlc_handle(output, "output"), views, memb);
+   return wlc_output_set_views_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT), views, memb);
 }
 
 WLC_API void
 wlc_output_focus(wlc_handle output)
 {
-   wlc_output_focus_ptr(convert_from_wlc_handle(output, "output"));
+   wlc_output_focus_ptr(convert_from_wlc_handle(output, WLC_TYPE_OUTPUT));
 }
 
 WLC_API const char*
 wlc_output_get_name(wlc_handle output)
 {
-   struct wlc_output *o = convert_from_wlc_handle(output, "output");
+   struct wlc_output *o = convert_from_wlc_handle(output, WLC_TYPE_OUTPUT);
    return (o ? o->information.name.data : NULL);
 }
 
 WLC_API enum wlc_connector_type
 wlc_output_get_connector_type(wlc_handle output)
 {
-   struct wlc_output *o = convert_from_wlc_handle(output, "output");
+   struct wlc_output *o = convert_from_wlc_handle(output, WLC_TYPE_OUTPUT);
    return (o ? o->information.connector : WLC_CONNECTOR_UNKNOWN);
 }
 
 WLC_API uint32_t
 wlc_output_get_connector_id(wlc_handle output)
 {
-   struct wlc_output *o = convert_from_wlc_handle(output, "output");
+   struct wlc_output *o = convert_from_wlc_handle(output, WLC_TYPE_OUTPUT);
    return (o ? o->information.connector_id : 0);
 }
 
@@ -884,16 +2148,38 @@ wlc_output_release(struct wlc_output *output)
    if (output->timer.idle)
       wl_event_source_remove(output->timer.idle);
 
+   if (output->timer.readback)
+      wl_event_source_remove(output->timer.readback);
+
    wlc_output_set_information(output, NULL);
    wlc_output_set_backend_surface(output, NULL);
+   free(output->pixels.rgba);
+   capture_release(output);
+
+   if (output->layout.placed) {
+      // Overlapping outputs no longer show our views
+      forward_damage(output, &(struct wlc_geometry){ wlc_origin_zero, output->resolution });
+      invalidate_foreign_views(output, false);
+      remove_from_pool(output->layout.outputs, convert_to_wlc_handle(output));
+   }
+
+   release_foreign_views(output);
+   chck_iter_pool_release(&output->foreign);
    chck_iter_pool_release(&output->surfaces);
    chck_iter_pool_release(&output->views);
    chck_iter_pool_release(&output->mutable);
    chck_iter_pool_release(&output->visible);
    chck_iter_pool_release(&output->callbacks);
 
-   free(output->blit);
-   output->blit = NULL;
+   struct feedback *f;
+   chck_iter_pool_for_each(&output->feedbacks, f)
+      wlc_presentation_feedback_discarded(f->resource);
+   chck_iter_pool_release(&output->feedbacks);
+
+   pixman_region32_fini(&output->damage);
+
+   for (uint32_t i = 0; i < LENGTH(output->previous_damage); ++i)
+      pixman_region32_fini(&output->previous_damage[i]);
 
    if (output->wl.output)
       wl_global_destroy(output->wl.output);
@@ -905,28 +2191,40 @@ bool
 wlc_output(struct wlc_output *output)
 {
    assert(output);
+   pixman_region32_init(&output->damage);
 
-   if (!(output->timer.idle = wl_event_loop_add_timer(wlc_event_loop(), cb_idle_timer, (void*)convert_to_wlc_handle(output))))
+   for (uint32_t i = 0; i < LENGTH(output->previous_damage); ++i)
+      pixman_region32_init(&output->previous_damage[i]);
+
+   if (!(output->timer.idle = wl_event_loop_add_timer(wlc_event_loop(), cb_idle_timer, (void*)convert_to_wlc_handle(output))) ||
+       !(output->timer.readback = wl_event_loop_add_timer(wlc_event_loop(), cb_readback_timer, (void*)convert_to_wlc_handle(output))))
       goto fail;
 
    if (!(output->wl.output = wl_global_create(wlc_display(), &wl_output_interface, 2, output, wl_output_bind)))
       goto fail;
 
-   if (!wlc_source(&output->resources, "output", NULL, NULL, 32, sizeof(struct wlc_resource)))
+   if (!wlc_source(&output->resources, WLC_TYPE_OUTPUT, NULL, NULL, 32, sizeof(struct wlc_resource)))
       goto fail;
 
    if (!chck_iter_pool(&output->surfaces, 32, 0, sizeof(wlc_resource)) ||
        !chck_iter_pool(&output->views, 4, 0, sizeof(wlc_handle)) ||
        !chck_iter_pool(&output->mutable, 4, 0, sizeof(wlc_handle)) ||
        !chck_iter_pool(&output->callbacks, 32, 0, sizeof(wlc_resource)) ||
-       !chck_iter_pool(&output->visible, 32, 0, sizeof(struct wlc_view*)))
+       !chck_iter_pool(&output->feedbacks, 32, 0, sizeof(struct feedback)) ||
+       !chck_iter_pool(&output->visible, 32, 0, sizeof(struct wlc_view*)) ||
+       !chck_iter_pool(&output->foreign, 4, 0, sizeof(struct foreign_view)))
       goto fail;
 
    output->active.mode = UINT_MAX;
-   output->state.ims = 41;
    const char *bg = getenv("WLC_BG");
    output->options.enable_bg = (chck_cstreq(bg, "0") ? false : true);
 
+   uint32_t margin = 7; // ms
+   const char *env;
+   if ((env = getenv("WLC_REPAINT_MARGIN")))
+      chck_cstr_to_u32(env, &margin);
+   output->options.repaint_margin = (int64_t)margin * 1000000;
+
    wlc_output_set_sleep_ptr(output, false);
    wlc_output_set_mask_ptr(output, (1<<0));
    return true;
@@ -2,6 +2,7 @@
 #define _WLC_OUTPUT_H_
 
 #include <stdint.h>
+#include <pixman.h>
 #include <wayland-util.h>
 #include <chck/string/string.h>
 #include <chck/pool/pool.h>
@@ -20,6 +21,14 @@ enum output_link {
    LINK_ABOVE,
 };
 
+// How the frame reached the screen, same bits as wp_presentation_feedback.kind
+enum wlc_frame_flags {
+   WLC_FRAME_VSYNC = 1<<0, // presented on vertical retrace without tearing
+   WLC_FRAME_HW_CLOCK = 1<<1, // timestamp comes from the hardware
+   WLC_FRAME_HW_COMPLETION = 1<<2, // hardware signalled the presentation
+   WLC_FRAME_ZERO_COPY = 1<<3, // client buffer was shown without compositing
+};
+
 struct wlc_output_mode {
    int32_t refresh;
    int32_t width, height;
@@ -50,12 +59,59 @@ struct wlc_output {
    struct chck_iter_pool surfaces, views, mutable;
    struct chck_iter_pool callbacks, visible;
 
-   // Pixel blit buffer size of current resolution
-   // Used to do visibility checks
-   bool *blit;
+   // Views of overlapping outputs in the layout, painted below our own views
+   // Collected again only when the layout or the views of those outputs change
+   struct chck_iter_pool foreign;
+
+   // Position in the global layout, outputs that are not placed only paint their own views
+   struct {
+      struct chck_iter_pool *outputs; // placed outputs, owned by compositor
+      struct wlc_origin origin;
+      bool placed;
+   } layout;
+
+   // Presentation feedback of the frame in flight
+   struct chck_iter_pool feedbacks;
+
+   // Damage in output coordinates accumulated since last repaint
+   pixman_region32_t damage;
+
+   // Damage of previously painted frames, newest first
+   // Used to bring older back buffers up to date (buffer age)
+   pixman_region32_t previous_damage[3];
+
+   // Buffer handed to pixels callbacks, reused until a callback keeps it
+   struct {
+      uint8_t *rgba;
+      size_t size;
+   } pixels;
+
+   // Continuous capture, frames are read into a ring of buffers
+   struct {
+      void *arg;
+      void (*cb)(const struct wlc_size *size, const uint8_t *rgba, const struct wlc_geometry *damage, size_t memb, void *userdata);
+
+      struct {
+         uint8_t *rgba;
+         pixman_region32_t stale; // damage not read into rgba yet
+      } buffers[3];
+
+      struct {
+         uint8_t *rgba;
+         size_t size;
+      } scratch; // area of the read back before it is copied to a buffer
+
+      struct chck_iter_pool rects; // damage handed to callback
+      pixman_region32_t damage; // since the last delivered frame
+      struct wlc_geometry queued; // area of the read back in flight
+      struct wlc_size size;
+      uint32_t next; // buffer the next frame goes to
+      bool pending;
+   } capture;
 
    struct {
       struct wl_event_source *idle;
+      struct wl_event_source *readback; // polls read backs the gpu has not finished yet
    } timer;
 
    struct {
@@ -67,17 +123,29 @@ struct wlc_output {
       struct {
          void *arg;
          bool (*cb)(const struct wlc_size *size, uint8_t *rgba, void *userdata);
+         struct wlc_geometry geometry;
+         bool queued; // read back in flight, delivered when the gpu is done
       } pixels;
       struct wlc_backend_surface bsurface;
       bool terminate;
       bool sleep;
    } task;
 
+   // Repaints start a margin before the predicted vblank, in nanoseconds of CLOCK_MONOTONIC
+   struct {
+      int64_t vblank; // presentation time of the last frame
+      int64_t target; // vblank the frame in flight aims for
+      uint32_t missed; // frames presented later than targeted
+   } schedule;
+
    struct {
-      float ims;
-      uint32_t frame_time;
+      uint32_t frame_time; // ms, as wl_callback.done wants it
       bool pending, scheduled, activity, sleeping;
       bool background_visible;
+      bool overlay; // something is painted over views this frame, set by render event listeners
+      struct wlc_geometry cursor; // software cursor painted this frame, set by render event listeners
+      bool scanout; // last frame was a client buffer flipped directly to screen
+      bool foreign_changed; // foreign views must be collected again
    } state;
 
    struct {
@@ -86,6 +154,7 @@ struct wlc_output {
    } active;
 
    struct {
+      int64_t repaint_margin; // ns
       bool enable_bg;
    } options;
 };
@@ -94,10 +163,14 @@ WLC_NONULL bool wlc_output_information(struct wlc_output_information *info);
 void wlc_output_information_release(struct wlc_output_information *info);
 WLC_NONULL bool wlc_output_information_add_mode(struct wlc_output_information *info, struct wlc_output_mode *mode);
 
-WLC_NONULLV(2) void wlc_output_finish_frame(struct wlc_output *output, const struct timespec *ts);
+WLC_NONULLV(2) void wlc_output_finish_frame(struct wlc_output *output, const struct timespec *ts, uint64_t seq, uint32_t flags);
 void wlc_output_schedule_repaint(struct wlc_output *output);
-WLC_NONULLV(2) bool wlc_output_surface_attach(struct wlc_output *output, struct wlc_surface *surface, struct wlc_buffer *buffer);
+WLC_NONULLV(2) void wlc_output_damage(struct wlc_output *output, pixman_region32_t *damage);
+WLC_NONULLV(2) void wlc_output_damage_geometry(struct wlc_output *output, const struct wlc_geometry *geometry);
+void wlc_output_damage_all(struct wlc_output *output);
+WLC_NONULLV(2) bool wlc_output_surface_attach(struct wlc_output *output, struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage);
 WLC_NONULLV(2) void wlc_output_surface_destroy(struct wlc_output *output, struct wlc_surface *surface);
+WLC_NONULLV(2) void wlc_output_buffer_destroy(struct wlc_output *output, struct wlc_buffer *buffer);
 bool wlc_output_set_backend_surface(struct wlc_output *output, struct wlc_backend_surface *surface);
 void wlc_output_set_information(struct wlc_output *output, struct wlc_output_information *info);
 WLC_NONULLV(2) void wlc_output_unlink_view(struct wlc_output *output, struct wlc_view *view);
@@ -108,9 +181,12 @@ WLC_NONULL bool wlc_output(struct wlc_output *output);
 
 void wlc_output_focus_ptr(struct wlc_output *output);
 void wlc_output_set_sleep_ptr(struct wlc_output *output, bool sleep);
+WLC_NONULLV(2) void wlc_output_set_position_ptr(struct wlc_output *output, const struct wlc_origin *origin);
 WLC_NONULLV(2) void wlc_output_set_resolution_ptr(struct wlc_output *output, const struct wlc_size *resolution);
 void wlc_output_set_mask_ptr(struct wlc_output *output, uint32_t mask);
-WLC_NONULLV(2) void wlc_output_get_pixels_ptr(struct wlc_output *output, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg);
+WLC_NONULLV(2) bool wlc_output_start_capture_ptr(struct wlc_output *output, void (*frame)(const struct wlc_size *size, const uint8_t *rgba, const struct wlc_geometry *damage, size_t memb, void *arg), void *arg);
+void wlc_output_stop_capture_ptr(struct wlc_output *output);
+WLC_NONULLV(3) void wlc_output_get_pixels_ptr(struct wlc_output *output, const struct wlc_geometry *geometry, bool (*pixels)(const struct wlc_size *size, uint8_t *rgba, void *arg), void *arg);
 bool wlc_output_set_views_ptr(struct wlc_output *output, const wlc_handle *views, size_t memb);
 const wlc_handle* wlc_output_get_views_ptr(struct wlc_output *output, size_t *out_memb);
 wlc_handle* wlc_output_get_mutable_views_ptr(struct wlc_output *output, size_t *out_memb);
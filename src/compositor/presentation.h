@@ -0,0 +1,34 @@
+#ifndef _WLC_PRESENTATION_H_
+#define _WLC_PRESENTATION_H_
+
+#include <stdint.h>
+#include "resources/resources.h"
+
+struct wlc_output;
+struct timespec;
+
+struct wlc_presentation {
+   struct wlc_source feedbacks;
+
+   struct {
+      struct wl_global *presentation;
+   } wl;
+};
+
+/** Send presented event for the feedback and release it. flags are the WLC_FRAME_* bits of the frame. */
+WLC_NONULLV(2,3) void wlc_presentation_feedback_presented(wlc_resource feedback, struct wlc_output *output, const struct timespec *ts, uint32_t refresh, uint64_t seq, uint32_t flags);
+
+/** Send discarded event for the feedback and release it. */
+void wlc_presentation_feedback_discarded(wlc_resource feedback);
+
+/** Useful for chck_<foo>_for_each_call. */
+static inline void
+wlc_presentation_feedback_discarded_ptr(wlc_resource *feedback)
+{
+   wlc_presentation_feedback_discarded(*feedback);
+}
+
+void wlc_presentation_release(struct wlc_presentation *presentation);
+WLC_NONULL bool wlc_presentation(struct wlc_presentation *presentation);
+
+#endif /* _WLC_PRESENTATION_H_ */
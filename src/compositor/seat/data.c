@@ -19,7 +19,7 @@ wl_cb_data_offer_accept(struct wl_client *client, struct wl_resource *resource,
    if (!(source = (wlc_resource)wl_resource_get_user_data(resource)))
       return;
 
-   wl_data_source_send_target(wl_resource_from_wlc_resource(source, "data-source"), type);
+   wl_data_source_send_target(wl_resource_from_wlc_resource(source, WLC_TYPE_DATA_SOURCE), type);
 }
 
 static void
@@ -31,7 +31,7 @@ wl_cb_data_offer_receive(struct wl_client *client, struct wl_resource *resource,
    if (!(source = (wlc_resource)wl_resource_get_user_data(resource)))
       return;
 
-   wl_data_source_send_send(wl_resource_from_wlc_resource(source, "data-source"), type, fd);
+   wl_data_source_send_send(wl_resource_from_wlc_resource(source, WLC_TYPE_DATA_SOURCE), type, fd);
    close(fd);
 }
 
@@ -47,7 +47,7 @@ wl_cb_data_source_offer(struct wl_client *client, struct wl_resource *resource,
    (void)client, (void)resource, (void)type;
 
    struct wlc_data_source *source;
-   if (!(source = convert_from_wl_resource(resource, "data-source")))
+   if (!(source = convert_from_wl_resource(resource, WLC_TYPE_DATA_SOURCE)))
       return;
 
    struct chck_string *destination;
@@ -92,7 +92,7 @@ wl_cb_data_device_set_selection(struct wl_client *client, struct wl_resource *re
    if (!(manager = wl_resource_get_user_data(resource)))
       return;
 
-   struct wl_resource *current = wl_resource_from_wlc_resource(manager->source, "data-source");
+   struct wl_resource *current = wl_resource_from_wlc_resource(manager->source, WLC_TYPE_DATA_SOURCE);
    if (source_resource == current)
       return;
 
@@ -147,7 +147,7 @@ wlc_data_device_manager_offer(struct wlc_data_device_manager *manager, struct wl
    if (!client || !(resource = wl_resource_for_client(&manager->devices, client)))
       return;
 
-   struct wlc_data_source *source = convert_from_wlc_resource(manager->source, "data-source");
+   struct wlc_data_source *source = convert_from_wlc_resource(manager->source, WLC_TYPE_DATA_SOURCE);
 
    wlc_resource offer = 0;
    if (source && !(offer = wlc_resource_create(&manager->offers, client, &wl_data_offer_interface, wl_resource_get_version(resource), 2, 0)))
@@ -155,16 +155,16 @@ wlc_data_device_manager_offer(struct wlc_data_device_manager *manager, struct wl
 
    if (offer) {
       wlc_resource_implement(offer, &wl_data_offer_implementation, (void*)manager->source);
-      wl_data_device_send_data_offer(resource, wl_resource_from_wlc_resource(offer, "data-offer"));
+      wl_data_device_send_data_offer(resource, wl_resource_from_wlc_resource(offer, WLC_TYPE_DATA_OFFER));
 
       if (offer && source) {
          struct chck_string *type;
          chck_iter_pool_for_each(&source->types, type)
-            wl_data_offer_send_offer(wl_resource_from_wlc_resource(offer, "data-offer"), type->data);
+            wl_data_offer_send_offer(wl_resource_from_wlc_resource(offer, WLC_TYPE_DATA_OFFER), type->data);
       }
    }
 
-   wl_data_device_send_selection(resource, wl_resource_from_wlc_resource(offer, "data-offer"));
+   wl_data_device_send_selection(resource, wl_resource_from_wlc_resource(offer, WLC_TYPE_DATA_OFFER));
 }
 
 void
@@ -192,9 +192,9 @@ wlc_data_device_manager(struct wlc_data_device_manager *manager)
    if (!(manager->wl.manager = wl_global_create(wlc_display(), &wl_data_device_manager_interface, 2, manager, wl_data_device_manager_bind)))
       goto manager_interface_fail;
 
-   if (!wlc_source(&manager->sources, "data-source", wlc_data_source, wlc_data_source_release, 32, sizeof(struct wlc_data_source)) ||
-       !wlc_source(&manager->devices, "data-device", NULL, NULL, 32, sizeof(struct wlc_resource)) ||
-       !wlc_source(&manager->offers, "data-offer", NULL, NULL, 32, sizeof(struct wlc_resource)))
+   if (!wlc_source(&manager->sources, WLC_TYPE_DATA_SOURCE, wlc_data_source, wlc_data_source_release, 32, sizeof(struct wlc_data_source)) ||
+       !wlc_source(&manager->devices, WLC_TYPE_DATA_DEVICE, NULL, NULL, 32, sizeof(struct wlc_resource)) ||
+       !wlc_source(&manager->offers, WLC_TYPE_DATA_OFFER, NULL, NULL, 32, sizeof(struct wlc_resource)))
       goto fail;
 
    return true;
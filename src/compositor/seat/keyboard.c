@@ -47,7 +47,7 @@ send_release_for_keys(struct chck_iter_pool *resources, struct chck_iter_pool *k
       wlc_resource *r;
       chck_iter_pool_for_each(resources, r) {
          struct wl_resource *wr;
-         if (!(wr = wl_resource_from_wlc_resource(*r, "keyboard")))
+         if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_KEYBOARD)))
             continue;
 
          uint32_t serial = wl_display_next_serial(wlc_display());
@@ -129,7 +129,7 @@ defocus(struct wlc_keyboard *keyboard, struct wlc_view *new_focus)
    assert(keyboard);
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle(keyboard->focused.view, "view")))
+   if (!(view = convert_from_wlc_handle(keyboard->focused.view, WLC_TYPE_VIEW)))
       goto out;
 
    // Xwayland does own key repeating.
@@ -138,7 +138,7 @@ defocus(struct wlc_keyboard *keyboard, struct wlc_view *new_focus)
    send_release_for_keys(&keyboard->focused.resources, &keyboard->keys);
 
    struct wl_resource *surface;
-   if (!(surface = wl_resource_from_wlc_resource(view->surface, "surface")))
+   if (!(surface = wl_resource_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       goto out;
 
    if (view->x11.id)
@@ -147,7 +147,7 @@ defocus(struct wlc_keyboard *keyboard, struct wlc_view *new_focus)
    wlc_resource *r;
    chck_iter_pool_for_each(&keyboard->focused.resources, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "keyboard")))
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_KEYBOARD)))
          continue;
 
       uint32_t serial = wl_display_next_serial(wlc_display());
@@ -162,7 +162,7 @@ defocus(struct wlc_keyboard *keyboard, struct wlc_view *new_focus)
 
       {
          struct wl_resource *surface;
-         if (new_focus && (surface = wl_resource_from_wlc_resource(new_focus->surface, "surface")))
+         if (new_focus && (surface = wl_resource_from_wlc_resource(new_focus->surface, WLC_TYPE_SURFACE)))
             new_client = wl_resource_get_client(surface);
       }
 
@@ -181,14 +181,14 @@ focus_view(struct wlc_keyboard *keyboard, struct wlc_view *view)
    assert(keyboard);
 
    struct wl_resource *surface;
-   if (!view || !(surface = wl_resource_from_wlc_resource(view->surface, "surface")))
+   if (!view || !(surface = wl_resource_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return;
 
    wlc_resource *r;
    struct wl_client *client = wl_resource_get_client(surface);
-   chck_pool_for_each(&keyboard->resources.pool, r) {
+   wlc_slab_for_each(&keyboard->resources.pool, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "keyboard")) || wl_resource_get_client(wr) != client)
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_KEYBOARD)) || wl_resource_get_client(wr) != client)
          continue;
 
       if (!chck_iter_pool_push_back(&keyboard->focused.resources, r))
@@ -311,7 +311,7 @@ wlc_keyboard_update_modifiers(struct wlc_keyboard *keyboard)
    struct wlc_resource *r;
    chck_iter_pool_for_each(&keyboard->focused.resources, r) {
       struct wl_resource *resource;
-      if (!(resource = convert_to_wl_resource(r, "keyboard")))
+      if (!(resource = convert_to_wl_resource(r, WLC_TYPE_KEYBOARD)))
          continue;
 
       uint32_t serial = wl_display_next_serial(wlc_display());
@@ -362,7 +362,7 @@ wlc_keyboard_key(struct wlc_keyboard *keyboard, uint32_t time, uint32_t key, enu
    wlc_resource *r;
    chck_iter_pool_for_each(&keyboard->focused.resources, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "keyboard")))
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_KEYBOARD)))
          continue;
 
       uint32_t serial = wl_display_next_serial(wlc_display());
@@ -446,7 +446,7 @@ wlc_keyboard(struct wlc_keyboard *keyboard, struct wlc_keymap *keymap)
        !chck_iter_pool(&keyboard->focused.resources, 4, 0, sizeof(wlc_resource)))
       goto fail;
 
-   if (!wlc_source(&keyboard->resources, "keyboard", NULL, NULL, 32, sizeof(struct wlc_resource)))
+   if (!wlc_source(&keyboard->resources, WLC_TYPE_KEYBOARD, NULL, NULL, 32, sizeof(struct wlc_resource)))
       goto fail;
 
    if (!(keyboard->timer.repeat = wl_event_loop_add_timer(wlc_event_loop(), cb_repeat, keyboard)))
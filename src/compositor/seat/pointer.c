@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <wayland-server.h>
 #include <chck/math/math.h>
+#include <chck/overflow/overflow.h>
 #include "internal.h"
 #include "pointer.h"
 #include "macros.h"
@@ -12,6 +13,25 @@
 #include "compositor/view.h"
 #include "compositor/output.h"
 #include "resources/types/surface.h"
+#include "resources/types/buffer.h"
+
+// 0 == black, 1 == white, 2 == transparent
+const uint8_t wlc_pointer_cursor_palette[WLC_POINTER_PALETTE_SIZE * WLC_POINTER_PALETTE_SIZE] = {
+   0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02,
+   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+   0x01, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02,
+   0x01, 0x00, 0x01, 0x02, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02,
+   0x01, 0x01, 0x02, 0x02, 0x02, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02,
+   0x01, 0x01, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, 0x00, 0x01, 0x02, 0x02, 0x02, 0x02,
+   0x01, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, 0x02, 0x02, 0x02, 0x02, 0x02
+};
 
 static struct wl_client*
 focused_client(struct wlc_pointer *pointer)
@@ -21,7 +41,7 @@ focused_client(struct wlc_pointer *pointer)
    wlc_resource *r;
    struct wl_resource *wr = NULL;
    chck_iter_pool_for_each(&pointer->focused.resources, r) {
-      if ((wr = wl_resource_from_wlc_resource(*r, "pointer")))
+      if ((wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_POINTER)))
          break;
    }
 
@@ -41,7 +61,7 @@ wl_cb_pointer_set_cursor(struct wl_client *client, struct wl_resource *resource,
    if (focused_client(pointer) != client)
       return;
 
-   struct wlc_surface *surface = convert_from_wl_resource(surface_resource, "surface");
+   struct wlc_surface *surface = convert_from_wl_resource(surface_resource, WLC_TYPE_SURFACE);
    wlc_pointer_set_surface(pointer, surface, &(struct wlc_origin){ hotspot_x, hotspot_y });
 }
 
@@ -51,7 +71,7 @@ active_output(struct wlc_pointer *pointer)
    struct wlc_seat *seat;
    struct wlc_compositor *compositor;
    except((seat = wl_container_of(pointer, seat, pointer)) && (compositor = wl_container_of(seat, compositor, seat)));
-   return convert_from_wlc_handle(compositor->active.output, "output");
+   return convert_from_wlc_handle(compositor->active.output, WLC_TYPE_OUTPUT);
 }
 
 static bool
@@ -74,7 +94,7 @@ view_under_pointer(struct wlc_pointer *pointer, struct wlc_output *output)
    wlc_handle *h;
    chck_iter_pool_for_each_reverse(&output->views, h) {
       struct wlc_view *view;
-      if (!(view = convert_from_wlc_handle(*h, "view")) || !view_visible(view, output->active.mask))
+      if (!(view = convert_from_wlc_handle(*h, WLC_TYPE_VIEW)) || !view_visible(view, output->active.mask))
          continue;
 
       struct wlc_geometry b;
@@ -89,7 +109,176 @@ view_under_pointer(struct wlc_pointer *pointer, struct wlc_output *output)
 }
 
 static void
-pointer_paint(struct wlc_pointer *pointer, struct wlc_output *output)
+cursor_geometry(struct wlc_pointer *pointer, struct wlc_geometry *out_geometry)
+{
+   assert(pointer && out_geometry);
+
+   struct wlc_surface *surface;
+   if ((surface = convert_from_wlc_resource(pointer->surface, WLC_TYPE_SURFACE))) {
+      *out_geometry = (struct wlc_geometry){ { pointer->pos.x - pointer->tip.x, pointer->pos.y - pointer->tip.y }, surface->size };
+   } else {
+      // Size of the fallback cursor drawn by renderer
+      *out_geometry = (struct wlc_geometry){ { pointer->pos.x, pointer->pos.y }, { WLC_POINTER_PALETTE_SIZE, WLC_POINTER_PALETTE_SIZE } };
+   }
+}
+
+static bool
+set_hw_cursor_image(struct wlc_pointer *pointer, struct wlc_output *output, bool fallback)
+{
+   assert(pointer && output);
+
+   if (fallback) {
+      static const uint32_t colors[] = { 0xff000000, 0xffffffff, 0x00000000 };
+      uint32_t argb[WLC_POINTER_PALETTE_SIZE * WLC_POINTER_PALETTE_SIZE];
+      for (uint32_t i = 0; i < LENGTH(argb); ++i)
+         argb[i] = colors[wlc_pointer_cursor_palette[i]];
+
+      return wlc_backend_surface_set_cursor(&output->bsurface, argb, &(struct wlc_size){ WLC_POINTER_PALETTE_SIZE, WLC_POINTER_PALETTE_SIZE }, &wlc_origin_zero);
+   }
+
+   struct wlc_surface *surface;
+   if (!(surface = convert_from_wlc_resource(pointer->surface, WLC_TYPE_SURFACE)))
+      return wlc_backend_surface_set_cursor(&output->bsurface, NULL, NULL, NULL);
+
+   // Only plain SHM cursors can be put on the plane, rest are painted by renderer
+   struct wlc_buffer *buffer;
+   struct wl_shm_buffer *shm;
+   if (surface->commit.scale != 1 || surface->commit.transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+       !(buffer = wlc_surface_get_buffer(surface)) || !(shm = wl_shm_buffer_get(convert_to_wl_resource(buffer, WLC_TYPE_BUFFER))))
+      return false;
+
+   const uint32_t format = wl_shm_buffer_get_format(shm);
+   if (format != WL_SHM_FORMAT_ARGB8888 && format != WL_SHM_FORMAT_XRGB8888)
+      return false;
+
+   const struct wlc_size size = { wl_shm_buffer_get_width(shm), wl_shm_buffer_get_height(shm) };
+   const int32_t stride = wl_shm_buffer_get_stride(shm);
+
+   uint32_t *argb;
+   if (!size.w || !size.h || !(argb = chck_malloc_mul_of(size.w * size.h, sizeof(uint32_t))))
+      return false;
+
+   wl_shm_buffer_begin_access(shm);
+   const uint8_t *data = wl_shm_buffer_get_data(shm);
+   for (uint32_t y = 0; y < size.h; ++y) {
+      uint32_t *row = argb + y * size.w;
+      memcpy(row, data + y * stride, size.w * sizeof(uint32_t));
+
+      if (format == WL_SHM_FORMAT_XRGB8888) {
+         for (uint32_t x = 0; x < size.w; ++x)
+            row[x] |= 0xff000000;
+      }
+   }
+   wl_shm_buffer_end_access(shm);
+
+   const bool ret = wlc_backend_surface_set_cursor(&output->bsurface, argb, &size, &pointer->tip);
+   free(argb);
+   return ret;
+}
+
+static void
+hide_hw_cursor(struct wlc_pointer *pointer)
+{
+   assert(pointer);
+
+   struct wlc_output *output;
+   if ((output = convert_from_wlc_handle(pointer->hw.output, WLC_TYPE_OUTPUT)))
+      wlc_backend_surface_set_cursor(&output->bsurface, NULL, NULL, NULL);
+
+   memset(&pointer->hw, 0, sizeof(pointer->hw));
+}
+
+static bool
+update_hw_cursor(struct wlc_pointer *pointer, struct wlc_output *output)
+{
+   assert(pointer && output);
+
+   // Cursor plane is not scaled, output must be rendered at its native resolution
+   if (!wlc_size_equals(&output->mode, &output->resolution))
+      return false;
+
+   struct wlc_surface *surface = convert_from_wlc_resource(pointer->surface, WLC_TYPE_SURFACE);
+   struct wlc_view *focused = convert_from_wlc_handle(pointer->focused.view, WLC_TYPE_VIEW);
+   const bool fallback = (!surface && (!focused || focused->x11.id));
+   const bool damaged = (surface && pixman_region32_not_empty(&surface->commit.damage));
+   const wlc_handle handle = convert_to_wlc_handle(output);
+
+   if (pointer->hw.output != handle || pointer->hw.surface != pointer->surface || pointer->hw.fallback != fallback || damaged) {
+      if (!set_hw_cursor_image(pointer, output, fallback))
+         return false;
+
+      // Commits of the cursor surface must still reach this output
+      if (surface && surface->output != handle)
+         wlc_surface_attach_to_output(surface, output, wlc_surface_get_buffer(surface));
+
+      if (surface)
+         pixman_region32_clear(&surface->commit.damage);
+
+      pointer->hw.output = handle;
+      pointer->hw.surface = pointer->surface;
+      pointer->hw.fallback = fallback;
+   }
+
+   const struct wlc_origin tip = (fallback ? wlc_origin_zero : pointer->tip);
+   return wlc_backend_surface_move_cursor(&output->bsurface, &(struct wlc_origin){ pointer->pos.x - tip.x, pointer->pos.y - tip.y });
+}
+
+static void
+pointer_damage(struct wlc_pointer *pointer, struct wlc_output *output)
+{
+   assert(output);
+
+   if (!pointer)
+      return;
+
+   if (output == active_output(pointer) && update_hw_cursor(pointer, output)) {
+      // Cursor is on the plane, remove the one painted by renderer
+      if (pointer->painted.output == convert_to_wlc_handle(output)) {
+         const struct wlc_geometry *g = &pointer->painted.geometry;
+         pixman_region32_union_rect(&output->damage, &output->damage, g->origin.x, g->origin.y, g->size.w, g->size.h);
+         memset(&pointer->painted, 0, sizeof(pointer->painted));
+      }
+      return;
+   }
+
+   if (pointer->hw.output == convert_to_wlc_handle(output))
+      hide_hw_cursor(pointer);
+
+   struct wlc_geometry g = wlc_geometry_zero;
+   if (output == active_output(pointer))
+      cursor_geometry(pointer, &g);
+
+   // Software cursor is painted over views, output can't scan out a client buffer
+   if (g.size.w > 0) {
+      output->state.overlay = true;
+      output->state.cursor = g;
+   }
+
+   struct wlc_surface *surface = convert_from_wlc_resource(pointer->surface, WLC_TYPE_SURFACE);
+   const bool on_output = (pointer->painted.output == convert_to_wlc_handle(output));
+   const bool damaged = (surface && pixman_region32_not_empty(&surface->commit.damage));
+
+   if (!on_output && g.size.w == 0)
+      return;
+
+   if (on_output && !damaged && pointer->painted.surface == pointer->surface && wlc_geometry_equals(&g, &pointer->painted.geometry))
+      return;
+
+   if (on_output)
+      pixman_region32_union_rect(&output->damage, &output->damage, pointer->painted.geometry.origin.x, pointer->painted.geometry.origin.y, pointer->painted.geometry.size.w, pointer->painted.geometry.size.h);
+
+   pixman_region32_union_rect(&output->damage, &output->damage, g.origin.x, g.origin.y, g.size.w, g.size.h);
+
+   if (surface)
+      pixman_region32_clear(&surface->commit.damage);
+
+   pointer->painted.geometry = g;
+   pointer->painted.surface = pointer->surface;
+   pointer->painted.output = (g.size.w > 0 ? convert_to_wlc_handle(output) : 0);
+}
+
+static void
+pointer_update_focus(struct wlc_pointer *pointer, struct wlc_output *output)
 {
    assert(output);
 
@@ -99,13 +288,32 @@ pointer_paint(struct wlc_pointer *pointer, struct wlc_output *output)
    // XXX: Do this check for now every render loop.
    // Maybe later we may do something nicer, like if any view moved or
    // geometry changed then update pointer.
-   struct wlc_view *focus = convert_from_wlc_handle(pointer->focused.view, "view");
+   struct wlc_view *focus = convert_from_wlc_handle(pointer->focused.view, WLC_TYPE_VIEW);
    struct wlc_view *focused = view_under_pointer(pointer, output);
-   if (focus != focused)
+   if (focus != focused) {
       wlc_pointer_focus(pointer, focused, NULL);
+      // Cursor depends on focus, repaint it in this frame
+      const struct wlc_geometry *g = &pointer->painted.geometry;
+      pixman_region32_union_rect(&output->damage, &output->damage, g->origin.x, g->origin.y, g->size.w, g->size.h);
+   }
+}
+
+static void
+pointer_paint(struct wlc_pointer *pointer, struct wlc_output *output)
+{
+   assert(output);
+
+   if (!pointer || output != active_output(pointer))
+      return;
+
+   struct wlc_view *focused = convert_from_wlc_handle(pointer->focused.view, WLC_TYPE_VIEW);
+
+   // Painted by hardware
+   if (pointer->hw.output == convert_to_wlc_handle(output))
+      return;
 
    struct wlc_surface *surface;
-   if ((surface = convert_from_wlc_resource(pointer->surface, "surface"))) {
+   if ((surface = convert_from_wlc_resource(pointer->surface, WLC_TYPE_SURFACE))) {
       if (surface->output != convert_to_wlc_handle(output) && !wlc_surface_attach_to_output(surface, output, wlc_surface_get_buffer(surface))) {
          // Fallback
          wlc_render_pointer_paint(&output->render, &output->context, &(struct wlc_origin){ pointer->pos.x, pointer->pos.y });
@@ -126,6 +334,11 @@ render_event(struct wl_listener *listener, void *data)
 
    struct wlc_render_event *ev = data;
    switch (ev->type) {
+      case WLC_RENDER_EVENT_DAMAGE:
+         pointer_update_focus(pointer, ev->output);
+         pointer_damage(pointer, ev->output);
+         break;
+
       case WLC_RENDER_EVENT_POINTER:
          pointer_paint(pointer, ev->output);
          break;
@@ -140,17 +353,17 @@ defocus(struct wlc_pointer *pointer)
    assert(pointer);
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle(pointer->focused.view, "view")))
+   if (!(view = convert_from_wlc_handle(pointer->focused.view, WLC_TYPE_VIEW)))
       goto out;
 
    struct wl_resource *surface;
-   if (!(surface = wl_resource_from_wlc_resource(view->surface, "surface")))
+   if (!(surface = wl_resource_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       goto out;
 
    wlc_resource *r;
    chck_iter_pool_for_each(&pointer->focused.resources, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "pointer")))
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_POINTER)))
          continue;
 
       uint32_t serial = wl_display_next_serial(wlc_display());
@@ -169,14 +382,14 @@ focus_view(struct wlc_pointer *pointer, struct wlc_view *view, const struct wlc_
    assert(pointer);
 
    struct wl_resource *surface;
-   if (!view || !(surface = wl_resource_from_wlc_resource(view->surface, "surface")))
+   if (!view || !(surface = wl_resource_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return;
 
    struct wl_client *client = wl_resource_get_client(surface);
    wlc_resource *r;
-   chck_pool_for_each(&pointer->resources.pool, r) {
+   wlc_slab_for_each(&pointer->resources.pool, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "pointer")) || wl_resource_get_client(wr) != client)
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_POINTER)) || wl_resource_get_client(wr) != client)
          continue;
 
       if (!chck_iter_pool_push_back(&pointer->focused.resources, r))
@@ -204,7 +417,7 @@ wlc_pointer_focus(struct wlc_pointer *pointer, struct wlc_view *view, struct wlc
       wlc_view_get_bounds(view, &b, &v);
 
       struct wlc_surface *s;
-      if (!(s = convert_from_wlc_resource(view->surface, "surface")))
+      if (!(s = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
          return;
 
       d.x = (pointer->pos.x - v.origin.x) * (float)s->size.w / v.size.w;
@@ -237,11 +450,11 @@ wlc_pointer_button(struct wlc_pointer *pointer, uint32_t time, uint32_t button,
    // Special handling for popups
    if (seat->keyboard.focused.view != pointer->focused.view) {
       struct wlc_view *v;
-      if ((v = convert_from_wlc_handle(seat->keyboard.focused.view, "view")) && !v->x11.id && (v->type & WLC_BIT_POPUP)) {
+      if ((v = convert_from_wlc_handle(seat->keyboard.focused.view, WLC_TYPE_VIEW)) && !v->x11.id && (v->type & WLC_BIT_POPUP)) {
          struct wl_client *client = NULL;
 
          struct wl_resource *surface;
-         if ((surface = wl_resource_from_wlc_resource(v->surface, "surface")))
+         if ((surface = wl_resource_from_wlc_resource(v->surface, WLC_TYPE_SURFACE)))
             client = wl_resource_get_client(surface);
 
          if (focused_client(pointer) != client) {
@@ -254,7 +467,7 @@ wlc_pointer_button(struct wlc_pointer *pointer, uint32_t time, uint32_t button,
    wlc_resource *r;
    chck_iter_pool_for_each(&pointer->focused.resources, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "pointer")))
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_POINTER)))
          continue;
 
       uint32_t serial = wl_display_next_serial(wlc_display());
@@ -270,7 +483,7 @@ wlc_pointer_scroll(struct wlc_pointer *pointer, uint32_t time, uint8_t axis_bits
    wlc_resource *r;
    chck_iter_pool_for_each(&pointer->focused.resources, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "pointer")))
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_POINTER)))
          continue;
 
       if (axis_bits & WLC_SCROLL_AXIS_VERTICAL)
@@ -294,7 +507,16 @@ wlc_pointer_motion(struct wlc_pointer *pointer, uint32_t time, const struct wlc_
    if (pass)
       wlc_pointer_focus(pointer, focused, &d);
 
-   wlc_output_schedule_repaint(output);
+   // Cursor moved to another output, clear it from the old one
+   if (pointer->painted.output && pointer->painted.output != convert_to_wlc_handle(output))
+      wlc_output_damage_geometry(convert_from_wlc_handle(pointer->painted.output, WLC_TYPE_OUTPUT), &pointer->painted.geometry);
+
+   if (pointer->hw.output && pointer->hw.output != convert_to_wlc_handle(output))
+      hide_hw_cursor(pointer);
+
+   // Moving the cursor plane needs no repaint
+   if (!output || pointer->hw.output != convert_to_wlc_handle(output) || !update_hw_cursor(pointer, output))
+      wlc_output_schedule_repaint(output);
 
    if (!focused || !pass)
       return;
@@ -302,7 +524,7 @@ wlc_pointer_motion(struct wlc_pointer *pointer, uint32_t time, const struct wlc_
    wlc_resource *r;
    chck_iter_pool_for_each(&pointer->focused.resources, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "pointer")))
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_POINTER)))
          continue;
 
       wl_pointer_send_motion(wr, time, wl_fixed_from_double(d.x), wl_fixed_from_double(d.y));
@@ -314,8 +536,10 @@ wlc_pointer_set_surface(struct wlc_pointer *pointer, struct wlc_surface *surface
 {
    assert(pointer);
    memcpy(&pointer->tip, tip, sizeof(pointer->tip));
-   wlc_surface_invalidate(convert_from_wlc_resource(pointer->surface, "surface"));
+   wlc_surface_invalidate(convert_from_wlc_resource(pointer->surface, WLC_TYPE_SURFACE));
    pointer->surface = convert_to_wlc_resource(surface);
+   wlc_output_damage_geometry(convert_from_wlc_handle(pointer->painted.output, WLC_TYPE_OUTPUT), &pointer->painted.geometry);
+   wlc_output_schedule_repaint(convert_from_wlc_handle(pointer->hw.output, WLC_TYPE_OUTPUT));
 }
 
 void
@@ -327,6 +551,8 @@ wlc_pointer_release(struct wlc_pointer *pointer)
    if (pointer->listener.render.notify)
       wl_list_remove(&pointer->listener.render.link);
 
+   hide_hw_cursor(pointer);
+
    chck_iter_pool_release(&pointer->focused.resources);
    wlc_source_release(&pointer->resources);
    memset(pointer, 0, sizeof(struct wlc_pointer));
@@ -343,7 +569,7 @@ wlc_pointer(struct wlc_pointer *pointer)
    if (!chck_iter_pool(&pointer->focused.resources, 4, 0, sizeof(wlc_resource)))
       goto fail;
 
-   if (!wlc_source(&pointer->resources, "pointer", NULL, NULL, 32, sizeof(struct wlc_resource)))
+   if (!wlc_source(&pointer->resources, WLC_TYPE_POINTER, NULL, NULL, 32, sizeof(struct wlc_resource)))
       goto fail;
 
    return true;
@@ -28,6 +28,11 @@ struct wlc_pointer_origin {
    double x, y;
 };
 
+// Built-in cursor shown when there is no cursor surface
+// 0 == black, 1 == white, 2 == transparent
+#define WLC_POINTER_PALETTE_SIZE 14
+extern const uint8_t wlc_pointer_cursor_palette[WLC_POINTER_PALETTE_SIZE * WLC_POINTER_PALETTE_SIZE];
+
 struct wlc_pointer {
    struct wlc_source resources;
    struct wlc_pointer_origin pos;
@@ -40,6 +45,20 @@ struct wlc_pointer {
       wlc_handle view;
    } focused;
 
+   // Cursor area on last repaint, used for damage tracking
+   struct {
+      struct wlc_geometry geometry;
+      wlc_resource surface;
+      wlc_handle output;
+   } painted;
+
+   // Cursor shown on the cursor plane of output, painted by hardware
+   struct {
+      wlc_handle output;
+      wlc_resource surface;
+      bool fallback;
+   } hw;
+
    struct {
       struct wl_listener render;
    } listener;
@@ -49,13 +49,13 @@ wl_cb_seat_get_keyboard(struct wl_client *client, struct wl_resource *resource,
 
    wlc_resource_implement(r, &wl_keyboard_implementation, &seat->keyboard);
 
-   struct wl_resource *wr = wl_resource_from_wlc_resource(r, "keyboard");
+   struct wl_resource *wr = wl_resource_from_wlc_resource(r, WLC_TYPE_KEYBOARD);
    if (wl_resource_get_version(wr) >= WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION)
       wl_keyboard_send_repeat_info(wr, seat->keyboard.repeat.rate, seat->keyboard.repeat.delay);
 
    wl_keyboard_send_keymap(wr, seat->keymap.format, seat->keymap.fd, seat->keymap.size);
 
-   struct wlc_view *focused = convert_from_wlc_handle(seat->keyboard.focused.view, "view");
+   struct wlc_view *focused = convert_from_wlc_handle(seat->keyboard.focused.view, WLC_TYPE_VIEW);
    if (focused && wlc_view_get_client(focused) == client) {
       // We refocus the client here so it gets input correctly.
       // This way we avoid the ugly keyboard.init public interface hack.
@@ -138,7 +138,7 @@ input_event(struct wl_listener *listener, void *data)
    except((seat = wl_container_of(listener, seat, listener.input)) && (compositor = wl_container_of(seat, compositor, seat)));
 
    struct wlc_input_event *ev = data;
-   struct wlc_output *output = convert_from_wlc_handle(compositor->active.output, "output");
+   struct wlc_output *output = convert_from_wlc_handle(compositor->active.output, WLC_TYPE_OUTPUT);
    switch (ev->type) {
       case WLC_INPUT_EVENT_MOTION:
       {
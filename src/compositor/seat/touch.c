@@ -14,7 +14,7 @@ active_output(struct wlc_touch *touch)
    struct wlc_seat *seat;
    struct wlc_compositor *compositor;
    except((seat = wl_container_of(touch, seat, touch)) && (compositor = wl_container_of(seat, compositor, seat)));
-   return convert_from_wlc_handle(compositor->active.output, "output");
+   return convert_from_wlc_handle(compositor->active.output, WLC_TYPE_OUTPUT);
 }
 
 static bool
@@ -37,7 +37,7 @@ view_under_touch(const struct wlc_origin *pos, struct wlc_output *output)
    wlc_handle *h;
    chck_iter_pool_for_each_reverse(&output->views, h) {
       struct wlc_view *view;
-      if (!(view = convert_from_wlc_handle(*h, "view")) || !view_visible(view, output->active.mask))
+      if (!(view = convert_from_wlc_handle(*h, WLC_TYPE_VIEW)) || !view_visible(view, output->active.mask))
          continue;
 
       struct wlc_geometry b;
@@ -62,13 +62,13 @@ wlc_touch_touch(struct wlc_touch *touch, uint32_t time, enum wlc_touch_type type
 
    struct wl_client *client;
    struct wl_resource *surface;
-   if (!(surface = wl_resource_from_wlc_resource(focused->surface, "surface")) || !(client = wl_resource_get_client(surface)))
+   if (!(surface = wl_resource_from_wlc_resource(focused->surface, WLC_TYPE_SURFACE)) || !(client = wl_resource_get_client(surface)))
       return;
 
    wlc_resource *r;
-   chck_pool_for_each(&touch->resources.pool, r) {
+   wlc_slab_for_each(&touch->resources.pool, r) {
       struct wl_resource *wr;
-      if (!(wr = wl_resource_from_wlc_resource(*r, "touch")) || wl_resource_get_client(wr) != client)
+      if (!(wr = wl_resource_from_wlc_resource(*r, WLC_TYPE_TOUCH)) || wl_resource_get_client(wr) != client)
          continue;
 
       switch (type) {
@@ -116,5 +116,5 @@ wlc_touch(struct wlc_touch *touch)
 {
    assert(touch);
    memset(touch, 0, sizeof(struct wlc_touch));
-   return wlc_source(&touch->resources, "touch", NULL, NULL, 32, sizeof(struct wlc_resource));
+   return wlc_source(&touch->resources, WLC_TYPE_TOUCH, NULL, NULL, 32, sizeof(struct wlc_resource));
 }
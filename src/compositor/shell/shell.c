@@ -13,7 +13,7 @@ wl_cb_shell_get_shell_surface(struct wl_client *client, struct wl_resource *reso
 {
    struct wlc_shell *shell;
    struct wlc_surface *surface;
-   if (!(shell = wl_resource_get_user_data(resource)) || !(surface = convert_from_wl_resource(surface_resource, "surface")))
+   if (!(shell = wl_resource_get_user_data(resource)) || !(surface = convert_from_wl_resource(surface_resource, WLC_TYPE_SURFACE)))
       return;
 
    wlc_resource r;
@@ -62,7 +62,7 @@ wlc_shell(struct wlc_shell *shell)
    if (!(shell->wl.shell = wl_global_create(wlc_display(), &wl_shell_interface, 1, shell, wl_shell_bind)))
       goto shell_interface_fail;
 
-   if (!wlc_source(&shell->surfaces, "shell-surface", NULL, NULL, 32, sizeof(struct wlc_resource)))
+   if (!wlc_source(&shell->surfaces, WLC_TYPE_SHELL_SURFACE, NULL, NULL, 32, sizeof(struct wlc_resource)))
       goto fail;
 
    return true;
@@ -27,7 +27,7 @@ xdg_cb_shell_get_surface(struct wl_client *client, struct wl_resource *resource,
 {
    struct wlc_surface *surface;
    struct wlc_xdg_shell *xdg_shell;
-   if (!(xdg_shell = wl_resource_get_user_data(resource)) || !(surface = convert_from_wl_resource(surface_resource, "surface")))
+   if (!(xdg_shell = wl_resource_get_user_data(resource)) || !(surface = convert_from_wl_resource(surface_resource, WLC_TYPE_SURFACE)))
       return;
 
    wlc_resource r;
@@ -51,7 +51,7 @@ xdg_cb_shell_get_popup(struct wl_client *client, struct wl_resource *resource, u
 
    struct wlc_surface *surface, *psurface;
    struct wlc_xdg_shell *xdg_shell;
-   if (!(xdg_shell = wl_resource_get_user_data(resource)) || !(surface = convert_from_wl_resource(surface_resource, "surface")) || !(psurface = convert_from_wl_resource(parent_resource, "surface")))
+   if (!(xdg_shell = wl_resource_get_user_data(resource)) || !(surface = convert_from_wl_resource(surface_resource, WLC_TYPE_SURFACE)) || !(psurface = convert_from_wl_resource(parent_resource, WLC_TYPE_SURFACE)))
       return;
 
    wlc_resource r;
@@ -118,8 +118,8 @@ wlc_xdg_shell(struct wlc_xdg_shell *xdg_shell)
    if (!(xdg_shell->wl.xdg_shell = wl_global_create(wlc_display(), &xdg_shell_interface, 1, xdg_shell, xdg_shell_bind)))
       goto xdg_shell_interface_fail;
 
-   if (!wlc_source(&xdg_shell->surfaces, "xdg-surface", NULL, NULL, 32, sizeof(struct wlc_resource)) ||
-       !wlc_source(&xdg_shell->popups, "xdg-popup", NULL, NULL, 4, sizeof(struct wlc_resource)))
+   if (!wlc_source(&xdg_shell->surfaces, WLC_TYPE_XDG_SURFACE, NULL, NULL, 32, sizeof(struct wlc_resource)) ||
+       !wlc_source(&xdg_shell->popups, WLC_TYPE_XDG_POPUP, NULL, NULL, 4, sizeof(struct wlc_resource)))
       goto fail;
 
    return xdg_shell;
@@ -20,11 +20,11 @@ configure_view(struct wlc_view *view, uint32_t edges, const struct wlc_geometry
    assert(view && g);
 
    struct wl_resource *r;
-   if (view->xdg_surface && (r = wl_resource_from_wlc_resource(view->xdg_surface, "xdg-surface"))) {
+   if (view->xdg_surface && (r = wl_resource_from_wlc_resource(view->xdg_surface, WLC_TYPE_XDG_SURFACE))) {
       const uint32_t serial = wl_display_next_serial(wlc_display());
       struct wl_array states = { .size = view->wl_state.items.used, .alloc = view->wl_state.items.allocated, .data = view->wl_state.items.buffer };
       xdg_surface_send_configure(r, g->size.w, g->size.h, &states, serial);
-   } else if (view->shell_surface && (r = wl_resource_from_wlc_resource(view->shell_surface, "shell-surface"))) {
+   } else if (view->shell_surface && (r = wl_resource_from_wlc_resource(view->shell_surface, WLC_TYPE_SHELL_SURFACE))) {
       wl_shell_surface_send_configure(r, edges, g->size.w, g->size.h);
    } else if (view->x11.id) {
       wlc_x11_window_configure(&view->x11, g);
@@ -74,13 +74,13 @@ wlc_view_commit_state(struct wlc_view *view, struct wlc_view_state *pending, str
    assert(view && pending && out);
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return;
 
    // FIXME: handle ping
 #if 0
       struct wl_resource *r;
-      if (view->shell_surface && (r = wl_resource_from_wlc_resource(view->shell_surface, "shell-surface")))
+      if (view->shell_surface && (r = wl_resource_from_wlc_resource(view->shell_surface, WLC_TYPE_SHELL_SURFACE)))
          wl_shell_surface_send_ping(r, wl_display_next_serial(wlc_display()));
 
       wlc_dlog(WLC_DBG_COMMIT, "=> ping view %" PRIuWLC, convert_to_wlc_handle(view));
@@ -163,11 +163,11 @@ wlc_view_get_bounds(struct wlc_view *view, struct wlc_geometry *out_bounds, stru
    memcpy(out_bounds, &view->commit.geometry, sizeof(struct wlc_geometry));
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return;
 
    if (should_be_transformed_by_parent(view)) {
-      for (struct wlc_view *parent = convert_from_wlc_handle(view->parent, "view"); parent; parent = convert_from_wlc_handle(parent->parent, "view")) {
+      for (struct wlc_view *parent = convert_from_wlc_handle(view->parent, WLC_TYPE_VIEW); parent; parent = convert_from_wlc_handle(parent->parent, WLC_TYPE_VIEW)) {
          out_bounds->origin.x += parent->commit.geometry.origin.x;
          out_bounds->origin.y += parent->commit.geometry.origin.y;
       }
@@ -225,7 +225,7 @@ wlc_view_get_opaque(struct wlc_view *view, struct wlc_geometry *out_opaque)
    memcpy(out_opaque, &wlc_geometry_zero, sizeof(struct wlc_geometry));
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return true;
 
    struct wlc_geometry b, v;
@@ -300,7 +300,7 @@ wlc_view_set_surface(struct wlc_view *view, struct wlc_surface *surface)
 
    wlc_handle old = view->surface;
    view->surface = convert_to_wlc_resource(surface);
-   wlc_surface_attach_to_view(convert_from_wlc_resource(old, "surface"), NULL);
+   wlc_surface_attach_to_view(convert_from_wlc_resource(old, WLC_TYPE_SURFACE), NULL);
    wlc_surface_attach_to_view(surface, view);
 
    if (surface && surface->commit.attached) {
@@ -315,7 +315,7 @@ wlc_view_set_surface(struct wlc_view *view, struct wlc_surface *surface)
 struct wl_client*
 wlc_view_get_client(struct wlc_view *view)
 {
-   struct wl_resource *r = (view ? wl_resource_from_wlc_resource(view->surface, "surface") : NULL);
+   struct wl_resource *r = (view ? wl_resource_from_wlc_resource(view->surface, WLC_TYPE_SURFACE) : NULL);
    return (r ? wl_resource_get_client(r) : NULL);
 }
 
@@ -323,10 +323,10 @@ struct wlc_output*
 wlc_view_get_output_ptr(struct wlc_view *view)
 {
    struct wlc_surface *surface;
-   if (!view || !(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!view || !(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return NULL;
 
-   return convert_from_wlc_handle(surface->output, "output");
+   return convert_from_wlc_handle(surface->output, WLC_TYPE_OUTPUT);
 }
 
 void
@@ -431,13 +431,13 @@ wlc_view_close_ptr(struct wlc_view *view)
       return;
 
    struct wl_resource *r;
-   if (view->xdg_surface && (r = wl_resource_from_wlc_resource(view->xdg_surface, "xdg-surface"))) {
+   if (view->xdg_surface && (r = wl_resource_from_wlc_resource(view->xdg_surface, WLC_TYPE_XDG_SURFACE))) {
       xdg_surface_send_close(r);
    } else if (view->x11.id) {
       wlc_x11_window_close(&view->x11);
-   } else if (view->xdg_popup && (r = wl_resource_from_wlc_resource(view->xdg_popup, "xdg-popup"))) {
+   } else if (view->xdg_popup && (r = wl_resource_from_wlc_resource(view->xdg_popup, WLC_TYPE_XDG_POPUP))) {
       xdg_popup_send_popup_done(r);
-   } else if (view->shell_surface && (r = wl_resource_from_wlc_resource(view->shell_surface, "shell-surface"))) {
+   } else if (view->shell_surface && (r = wl_resource_from_wlc_resource(view->shell_surface, WLC_TYPE_SHELL_SURFACE))) {
       if (view->type & WLC_BIT_POPUP) {
          wl_shell_surface_send_popup_done(r);
       } else {
@@ -496,131 +496,131 @@ get_cstr(struct wlc_view *view, size_t offset)
 WLC_API void
 wlc_view_focus(wlc_handle view)
 {
-   wlc_view_focus_ptr(convert_from_wlc_handle(view, "view"));
+   wlc_view_focus_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW));
 }
 
 WLC_API void
 wlc_view_close(wlc_handle view)
 {
-   wlc_view_close_ptr(convert_from_wlc_handle(view, "view"));
+   wlc_view_close_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW));
 }
 
 WLC_API wlc_handle
 wlc_view_get_output(wlc_handle view)
 {
-   return convert_to_wlc_handle(wlc_view_get_output_ptr(convert_from_wlc_handle(view, "view")));
+   return convert_to_wlc_handle(wlc_view_get_output_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW)));
 }
 
 WLC_API void
 wlc_view_set_output(wlc_handle view, wlc_handle output)
 {
-   wlc_view_set_output_ptr(convert_from_wlc_handle(view, "view"), convert_from_wlc_handle(output, "output"));
+   wlc_view_set_output_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), convert_from_wlc_handle(output, WLC_TYPE_OUTPUT));
 }
 
 WLC_API void
 wlc_view_send_to_back(wlc_handle view)
 {
-   wlc_view_send_to(convert_from_wlc_handle(view, "view"), LINK_BELOW);
+   wlc_view_send_to(convert_from_wlc_handle(view, WLC_TYPE_VIEW), LINK_BELOW);
 }
 
 WLC_API void
 wlc_view_send_below(wlc_handle view, wlc_handle other)
 {
-   wlc_view_send_to_other(convert_from_wlc_handle(view, "view"), LINK_BELOW, convert_from_wlc_handle(other, "view"));
+   wlc_view_send_to_other(convert_from_wlc_handle(view, WLC_TYPE_VIEW), LINK_BELOW, convert_from_wlc_handle(other, WLC_TYPE_VIEW));
 }
 
 WLC_API void
 wlc_view_bring_above(wlc_handle view, wlc_handle other)
 {
-   wlc_view_send_to_other(convert_from_wlc_handle(view, "view"), LINK_ABOVE, convert_from_wlc_handle(other, "view"));
+   wlc_view_send_to_other(convert_from_wlc_handle(view, WLC_TYPE_VIEW), LINK_ABOVE, convert_from_wlc_handle(other, WLC_TYPE_VIEW));
 }
 
 WLC_API void
 wlc_view_bring_to_front(wlc_handle view)
 {
-   wlc_view_send_to(convert_from_wlc_handle(view, "view"), LINK_ABOVE);
+   wlc_view_send_to(convert_from_wlc_handle(view, WLC_TYPE_VIEW), LINK_ABOVE);
 }
 
 WLC_API uint32_t
 wlc_view_get_mask(wlc_handle view)
 {
-   void *ptr = get(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, mask));
+   void *ptr = get(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, mask));
    return (ptr ? *(uint32_t*)ptr : 0);
 }
 
 WLC_API void
 wlc_view_set_mask(wlc_handle view, uint32_t mask)
 {
-   wlc_view_set_mask_ptr(convert_from_wlc_handle(view, "view"), mask);
+   wlc_view_set_mask_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), mask);
 }
 
 WLC_API const struct wlc_geometry*
 wlc_view_get_geometry(wlc_handle view)
 {
-   return get(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, pending.geometry));
+   return get(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, pending.geometry));
 }
 
 WLC_API void
 wlc_view_set_geometry(wlc_handle view, uint32_t edges, const struct wlc_geometry *geometry)
 {
-   wlc_view_set_geometry_ptr(convert_from_wlc_handle(view, "view"), edges, geometry);
+   wlc_view_set_geometry_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), edges, geometry);
 }
 
 WLC_API uint32_t
 wlc_view_get_type(wlc_handle view)
 {
-   void *ptr = get(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, type));
+   void *ptr = get(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, type));
    return (ptr ? *(uint32_t*)ptr : 0);
 }
 
 WLC_API void
 wlc_view_set_type(wlc_handle view, enum wlc_view_type_bit type, bool toggle)
 {
-   wlc_view_set_type_ptr(convert_from_wlc_handle(view, "view"), type, toggle);
+   wlc_view_set_type_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), type, toggle);
 }
 
 WLC_API uint32_t
 wlc_view_get_state(wlc_handle view)
 {
-   void *ptr = get(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, pending.state));
+   void *ptr = get(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, pending.state));
    return (ptr ? *(uint32_t*)ptr : 0);
 }
 
 WLC_API void
 wlc_view_set_state(wlc_handle view, enum wlc_view_state_bit state, bool toggle)
 {
-   wlc_view_set_state_ptr(convert_from_wlc_handle(view, "view"), state, toggle);
+   wlc_view_set_state_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), state, toggle);
 }
 
 WLC_API wlc_handle
 wlc_view_get_parent(wlc_handle view)
 {
-   void *ptr = get(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, parent));
+   void *ptr = get(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, parent));
    return (ptr ? *(wlc_handle*)ptr : 0);
 }
 
 WLC_API void
 wlc_view_set_parent(wlc_handle view, wlc_handle parent)
 {
-   wlc_view_set_parent_ptr(convert_from_wlc_handle(view, "view"), convert_from_wlc_handle(parent, "parent"));
+   wlc_view_set_parent_ptr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), convert_from_wlc_handle(parent, WLC_TYPE_VIEW));
 }
 
 WLC_API const char*
 wlc_view_get_title(wlc_handle view)
 {
-   return get_cstr(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, data.title));
+   return get_cstr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, data.title));
 }
 
 WLC_API const char*
 wlc_view_get_class(wlc_handle view)
 {
-   return get_cstr(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, data._class));
+   return get_cstr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, data._class));
 }
 
 WLC_API const char*
 wlc_view_get_app_id(wlc_handle view)
 {
-   return get_cstr(convert_from_wlc_handle(view, "view"), offsetof(struct wlc_view, data.app_id));
+   return get_cstr(convert_from_wlc_handle(view, WLC_TYPE_VIEW), offsetof(struct wlc_view, data.app_id));
 }
 
 void
@@ -640,8 +640,9 @@ wlc_view_release(struct wlc_view *view)
    chck_string_release(&view->data._class);
    chck_string_release(&view->data.app_id);
 
-   wlc_surface_attach_to_view(convert_from_wlc_resource(view->surface, "surface"), NULL);
+   wlc_surface_attach_to_view(convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE), NULL);
    chck_iter_pool_release(&view->wl_state);
+   pixman_region32_fini(&view->clip);
 }
 
 bool
@@ -649,5 +650,10 @@ wlc_view(struct wlc_view *view)
 {
    assert(view);
    assert(!view->state.created);
-   return chck_iter_pool(&view->wl_state, 8, 0, sizeof(uint32_t));
+
+   if (!chck_iter_pool(&view->wl_state, 8, 0, sizeof(uint32_t)))
+      return false;
+
+   pixman_region32_init(&view->clip);
+   return true;
 }
@@ -2,6 +2,7 @@
 #define _WLC_VIEW_H_
 
 #include <stdbool.h>
+#include <pixman.h>
 #include <wlc/geometry.h>
 #include <wayland-util.h>
 #include <chck/pool/pool.h>
@@ -56,6 +57,16 @@ struct wlc_view {
    struct {
       bool created;
    } state;
+
+   // Where the view was on its output during last repaint, used for damage tracking
+   struct {
+      struct wlc_geometry bounds;
+      bool visible;
+      bool plane; // shown on overlay plane instead of composited
+   } painted;
+
+   // Part of the view not occluded by opaque views above it, in output coordinates
+   pixman_region32_t clip;
 };
 
 WLC_NONULL void wlc_view_update(struct wlc_view *view);
@@ -163,6 +163,7 @@ struct wlc_output_event {
 };
 
 enum wlc_render_event_type {
+   WLC_RENDER_EVENT_DAMAGE, // emitted before output calculates damage for the frame
    WLC_RENDER_EVENT_POINTER,
 };
 
@@ -196,6 +197,7 @@ enum wlc_debug {
    WLC_DBG_KEYBOARD,
    WLC_DBG_COMMIT,
    WLC_DBG_REQUEST,
+   WLC_DBG_GL,
    WLC_DBG_LAST,
 };
 
@@ -208,6 +210,9 @@ WLC_NONULL void wlc_vlog(enum wlc_log_type type, const char *fmt, va_list ap);
 /** Debug log, the output is controlled by WLC_DEBUG env variable. */
 WLC_NONULLV(2) WLC_LOG_ATTR(2, 3) void wlc_dlog(enum wlc_debug dbg, const char *fmt, ...);
 
+/** Is the debug channel enabled by WLC_DEBUG env variable. */
+bool wlc_dlog_enabled(enum wlc_debug dbg);
+
 /** Use only on fatals, currently only wlc.c */
 WLC_NONULLV(1) WLC_LOG_ATTR(1, 2) static inline void
 die(const char *format, ...)
@@ -1,10 +1,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <chck/string/string.h>
 #include "internal.h"
+#include "macros.h"
 #include "backend.h"
 #include "x11.h"
 #include "drm.h"
+#include "headless.h"
 
 bool
 wlc_backend_surface(struct wlc_backend_surface *surface, void (*destructor)(struct wlc_backend_surface*), size_t internal_size)
@@ -35,8 +38,54 @@ wlc_backend_surface_release(struct wlc_backend_surface *surface)
    memset(surface, 0, sizeof(struct wlc_backend_surface));
 }
 
+bool
+wlc_backend_surface_scanout(struct wlc_backend_surface *surface, struct wlc_buffer *buffer)
+{
+   assert(surface && buffer);
+
+   if (!surface->api.scanout)
+      return false;
+
+   return surface->api.scanout(surface, buffer);
+}
+
+bool
+wlc_backend_surface_assign_plane(struct wlc_backend_surface *surface, struct wlc_buffer *buffer, const struct wlc_geometry *geometry)
+{
+   assert(surface);
+
+   if (!surface->api.assign_plane)
+      return false;
+
+   assert(!buffer || geometry);
+   return surface->api.assign_plane(surface, buffer, geometry);
+}
+
+bool
+wlc_backend_surface_set_cursor(struct wlc_backend_surface *surface, const uint32_t *argb, const struct wlc_size *size, const struct wlc_origin *hotspot)
+{
+   assert(surface);
+
+   if (!surface->api.set_cursor)
+      return false;
+
+   assert(!argb || (size && hotspot));
+   return surface->api.set_cursor(surface, argb, size, hotspot);
+}
+
+bool
+wlc_backend_surface_move_cursor(struct wlc_backend_surface *surface, const struct wlc_origin *pos)
+{
+   assert(surface && pos);
+
+   if (!surface->api.move_cursor)
+      return false;
+
+   return surface->api.move_cursor(surface, pos);
+}
+
 uint32_t
-wlc_backend_update_outputs(struct wlc_backend *backend, struct chck_pool *outputs)
+wlc_backend_update_outputs(struct wlc_backend *backend, struct wlc_slab *outputs)
 {
    assert(backend);
 
@@ -64,20 +113,24 @@ wlc_backend(struct wlc_backend *backend)
    assert(backend);
    memset(backend, 0, sizeof(struct wlc_backend));
 
-   bool (*init[])(struct wlc_backend*) = {
-      wlc_x11,
-      wlc_drm,
-      NULL
+   const struct {
+      const char *name;
+      bool (*init)(struct wlc_backend*);
+      enum wlc_backend_type type;
+      bool explicit; // only used when requested with WLC_BACKEND
+   } backends[] = {
+      { "x11", wlc_x11, WLC_BACKEND_X11, false },
+      { "drm", wlc_drm, WLC_BACKEND_DRM, false },
+      { "headless", wlc_headless, WLC_BACKEND_HEADLESS, true },
    };
 
-   enum wlc_backend_type types[] = {
-      WLC_BACKEND_X11,
-      WLC_BACKEND_DRM,
-   };
+   const char *env = getenv("WLC_BACKEND");
+   for (uint32_t i = 0; i < LENGTH(backends); ++i) {
+      if (env ? !chck_cstreq(env, backends[i].name) : backends[i].explicit)
+         continue;
 
-   for (uint32_t i = 0; init[i]; ++i) {
-      if (init[i](backend)) {
-         backend->type = types[i];
+      if (backends[i].init(backend)) {
+         backend->type = backends[i].type;
          return true;
       }
    }
@@ -6,7 +6,8 @@
 #include "EGL/egl.h"
 
 struct wlc_output;
-struct chck_pool;
+struct wlc_buffer;
+struct wlc_slab;
 
 struct wlc_backend_surface {
    void *internal;
@@ -14,10 +15,23 @@ struct wlc_backend_surface {
    EGLNativeDisplayType display;
    EGLNativeWindowType window;
 
+   // Surfaces without native window render offscreen to buffer of this size
+   struct wlc_size offscreen;
+
    struct {
       WLC_NONULL void (*terminate)(struct wlc_backend_surface *surface);
       WLC_NONULL void (*sleep)(struct wlc_backend_surface *surface, bool sleep);
       WLC_NONULL bool (*page_flip)(struct wlc_backend_surface *surface);
+
+      // Flips client buffer directly to screen instead of the rendered frame, false if not possible
+      WLC_NONULL bool (*scanout)(struct wlc_backend_surface *surface, struct wlc_buffer *buffer);
+
+      // Puts client buffer on overlay plane for the next frame, buffer of NULL clears the assignments
+      WLC_NONULLV(1) bool (*assign_plane)(struct wlc_backend_surface *surface, struct wlc_buffer *buffer, const struct wlc_geometry *geometry);
+
+      // Hardware cursor, argb of NULL hides the cursor
+      WLC_NONULLV(1) bool (*set_cursor)(struct wlc_backend_surface *surface, const uint32_t *argb, const struct wlc_size *size, const struct wlc_origin *hotspot);
+      WLC_NONULL bool (*move_cursor)(struct wlc_backend_surface *surface, const struct wlc_origin *pos);
    } api;
 };
 
@@ -25,15 +39,19 @@ struct wlc_backend {
    enum wlc_backend_type type;
 
    struct {
-      WLC_NONULL uint32_t (*update_outputs)(struct chck_pool *outputs);
+      WLC_NONULL uint32_t (*update_outputs)(struct wlc_slab *outputs);
       void (*terminate)(void);
    } api;
 };
 
 WLC_NONULL bool wlc_backend_surface(struct wlc_backend_surface *surface, void (*destructor)(struct wlc_backend_surface*), size_t internal_size);
 void wlc_backend_surface_release(struct wlc_backend_surface *surface);
+WLC_NONULL bool wlc_backend_surface_scanout(struct wlc_backend_surface *surface, struct wlc_buffer *buffer);
+WLC_NONULLV(1) bool wlc_backend_surface_assign_plane(struct wlc_backend_surface *surface, struct wlc_buffer *buffer, const struct wlc_geometry *geometry);
+WLC_NONULLV(1) bool wlc_backend_surface_set_cursor(struct wlc_backend_surface *surface, const uint32_t *argb, const struct wlc_size *size, const struct wlc_origin *hotspot);
+WLC_NONULL bool wlc_backend_surface_move_cursor(struct wlc_backend_surface *surface, const struct wlc_origin *pos);
 
-WLC_NONULL uint32_t wlc_backend_update_outputs(struct wlc_backend *backend, struct chck_pool *outputs);
+WLC_NONULL uint32_t wlc_backend_update_outputs(struct wlc_backend *backend, struct wlc_slab *outputs);
 void wlc_backend_release(struct wlc_backend *backend);
 WLC_NONULL bool wlc_backend(struct wlc_backend *backend);
 
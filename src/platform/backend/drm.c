@@ -11,17 +11,22 @@
 #include <dlfcn.h>
 #include <wayland-server.h>
 #include <wayland-util.h>
+#include <chck/overflow/overflow.h>
+#include <chck/string/string.h>
 #include "internal.h"
 #include "macros.h"
 #include "drm.h"
 #include "backend.h"
 #include "compositor/compositor.h"
 #include "compositor/output.h"
+#include "compositor/dmabuf.h"
+#include "resources/types/buffer.h"
 #include "session/fd.h"
 
 // FIXME: Contains global state (event_source && fd)
 
 #define NUM_FBS 2
+#define MAX_OVERLAYS 4
 
 struct drm_output_information {
    drmModeConnector *connector;
@@ -29,6 +34,19 @@ struct drm_output_information {
    drmModeCrtc *crtc;
    struct wlc_output_information info;
    uint32_t width, height;
+   uint32_t crtc_index;
+};
+
+struct drm_plane {
+   drmModePlane *plane;
+   struct drm_surface *owner;
+   uint64_t type; // DRM_PLANE_TYPE_*
+
+   struct {
+      uint32_t fb_id, crtc_id;
+      uint32_t src_x, src_y, src_w, src_h;
+      uint32_t crtc_x, crtc_y, crtc_w, crtc_h;
+   } props;
 };
 
 struct drm_surface {
@@ -40,10 +58,37 @@ struct drm_surface {
 
    struct drm_fb {
       struct gbm_bo *bo;
+      wlc_resource buffer; // client buffer scanned out directly, bo is imported from it
       uint32_t fd;
       uint32_t stride;
    } fb[NUM_FBS];
 
+   struct {
+      struct gbm_bo *bo[NUM_FBS];
+      struct wlc_size size;
+      uint32_t fb[NUM_FBS]; // framebuffers of the bos, for the atomic cursor plane
+      struct wlc_origin hotspot, pos;
+      uint8_t index;
+      bool enabled;
+   } cursor;
+
+   // Atomic modesetting state, used when the driver supports it
+   struct {
+      struct drm_plane *primary, *cursor;
+
+      struct drm_overlay {
+         struct drm_plane *plane;
+         struct drm_fb fb[NUM_FBS], pending;
+         struct wlc_geometry dst, pending_dst;
+         bool assigned;
+      } overlays[MAX_OVERLAYS];
+
+      uint32_t mode_blob;
+      uint32_t crtc_mode_id, crtc_active, connector_crtc_id;
+      uint8_t noverlays;
+      bool enabled;
+   } atomic;
+
    uint32_t stride;
    uint8_t index;
    bool flipping;
@@ -59,9 +104,14 @@ static struct {
       void (*gbm_device_destroy)(struct gbm_device*);
       struct gbm_surface* (*gbm_surface_create)(struct gbm_device*, uint32_t, uint32_t, uint32_t, uint32_t);
       void (*gbm_surface_destroy)(struct gbm_surface*);
+      struct gbm_bo* (*gbm_bo_create)(struct gbm_device*, uint32_t, uint32_t, uint32_t, uint32_t);
+      struct gbm_bo* (*gbm_bo_import)(struct gbm_device*, uint32_t, void*, uint32_t);
+      void (*gbm_bo_destroy)(struct gbm_bo*);
+      int (*gbm_bo_write)(struct gbm_bo*, const void*, size_t);
       uint32_t (*gbm_bo_get_width)(struct gbm_bo*);
       uint32_t (*gbm_bo_get_height)(struct gbm_bo*);
       uint32_t (*gbm_bo_get_stride)(struct gbm_bo*);
+      uint32_t (*gbm_bo_get_format)(struct gbm_bo*);
       union gbm_bo_handle (*gbm_bo_get_handle)(struct gbm_bo*);
       int (*gbm_surface_has_free_buffers)(struct gbm_surface*);
       struct gbm_bo* (*gbm_surface_lock_front_buffer)(struct gbm_surface*);
@@ -72,12 +122,17 @@ static struct {
 static struct {
    int fd;
    struct wl_event_source *event_source;
+   struct chck_iter_pool planes;
+   bool atomic;
+   bool monotonic; // page flip timestamps are in CLOCK_MONOTONIC
 
    struct {
       void *handle;
 
       int (*drmIoctl)(int fd, unsigned long request, void *arg);
+      int (*drmGetCap)(int, uint64_t, uint64_t*);
       int (*drmModeAddFB)(int, uint32_t, uint32_t, uint8_t, uint8_t, uint32_t, uint32_t, uint32_t*);
+      int (*drmModeAddFB2)(int, uint32_t, uint32_t, uint32_t, const uint32_t[4], const uint32_t[4], const uint32_t[4], uint32_t*, uint32_t);
       int (*drmModeRmFB)(int, uint32_t);
       int (*drmModePageFlip)(int, uint32_t, uint32_t, uint32_t, void*);
       int (*drmModeSetCrtc)(int, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t*, int, drmModeModeInfoPtr);
@@ -89,6 +144,24 @@ static struct {
       void (*drmModeFreeConnector)(drmModeConnectorPtr);
       drmModeEncoderPtr (*drmModeGetEncoder)(int, uint32_t);
       void (*drmModeFreeEncoder)(drmModeEncoderPtr);
+      int (*drmModeSetCursor)(int, uint32_t, uint32_t, uint32_t, uint32_t);
+      int (*drmModeSetCursor2)(int, uint32_t, uint32_t, uint32_t, uint32_t, int32_t, int32_t);
+      int (*drmModeMoveCursor)(int, uint32_t, int, int);
+      int (*drmSetClientCap)(int, uint64_t, uint64_t);
+      drmModePlaneResPtr (*drmModeGetPlaneResources)(int);
+      void (*drmModeFreePlaneResources)(drmModePlaneResPtr);
+      drmModePlanePtr (*drmModeGetPlane)(int, uint32_t);
+      void (*drmModeFreePlane)(drmModePlanePtr);
+      drmModeObjectPropertiesPtr (*drmModeObjectGetProperties)(int, uint32_t, uint32_t);
+      void (*drmModeFreeObjectProperties)(drmModeObjectPropertiesPtr);
+      drmModePropertyPtr (*drmModeGetProperty)(int, uint32_t);
+      void (*drmModeFreeProperty)(drmModePropertyPtr);
+      drmModeAtomicReqPtr (*drmModeAtomicAlloc)(void);
+      void (*drmModeAtomicFree)(drmModeAtomicReqPtr);
+      int (*drmModeAtomicAddProperty)(drmModeAtomicReqPtr, uint32_t, uint32_t, uint64_t);
+      int (*drmModeAtomicCommit)(int, drmModeAtomicReqPtr, uint32_t, void*);
+      int (*drmModeCreatePropertyBlob)(int, const void*, size_t, uint32_t*);
+      int (*drmModeDestroyPropertyBlob)(int, uint32_t);
    } api;
 } drm;
 
@@ -112,6 +185,14 @@ gbm_load(void)
       goto function_pointer_exception;
    if (!load(gbm_surface_destroy))
       goto function_pointer_exception;
+   if (!load(gbm_bo_create))
+      goto function_pointer_exception;
+   if (!load(gbm_bo_import))
+      goto function_pointer_exception;
+   if (!load(gbm_bo_destroy))
+      goto function_pointer_exception;
+   if (!load(gbm_bo_write))
+      goto function_pointer_exception;
    if (!load(gbm_bo_get_handle))
       goto function_pointer_exception;
    if (!load(gbm_bo_get_width))
@@ -120,6 +201,8 @@ gbm_load(void)
       goto function_pointer_exception;
    if (!load(gbm_bo_get_stride))
       goto function_pointer_exception;
+   if (!load(gbm_bo_get_format))
+      goto function_pointer_exception;
    if (!load(gbm_surface_has_free_buffers))
       goto function_pointer_exception;
    if (!load(gbm_surface_lock_front_buffer))
@@ -150,8 +233,12 @@ drm_load(void)
 
    if (!load(drmIoctl))
       goto function_pointer_exception;
+   if (!load(drmGetCap))
+      goto function_pointer_exception;
    if (!load(drmModeAddFB))
       goto function_pointer_exception;
+   if (!load(drmModeAddFB2))
+      goto function_pointer_exception;
    if (!load(drmModeRmFB))
       goto function_pointer_exception;
    if (!load(drmModePageFlip))
@@ -174,6 +261,20 @@ drm_load(void)
       goto function_pointer_exception;
    if (!load(drmModeFreeEncoder))
       goto function_pointer_exception;
+   if (!load(drmModeSetCursor))
+      goto function_pointer_exception;
+   if (!load(drmModeMoveCursor))
+      goto function_pointer_exception;
+
+   // Optional, hotspot aware variant (libdrm >= 2.4.50)
+   load(drmModeSetCursor2);
+
+   // Optional, atomic modesetting (libdrm >= 2.4.62)
+   drm.atomic = (load(drmSetClientCap) && load(drmModeGetPlaneResources) && load(drmModeFreePlaneResources) &&
+                 load(drmModeGetPlane) && load(drmModeFreePlane) && load(drmModeObjectGetProperties) &&
+                 load(drmModeFreeObjectProperties) && load(drmModeGetProperty) && load(drmModeFreeProperty) &&
+                 load(drmModeAtomicAlloc) && load(drmModeAtomicFree) && load(drmModeAtomicAddProperty) &&
+                 load(drmModeAtomicCommit) && load(drmModeCreatePropertyBlob) && load(drmModeDestroyPropertyBlob));
 
 #undef load
 
@@ -192,10 +293,17 @@ release_fb(struct gbm_surface *surface, struct drm_fb *fb)
    if (fb->fd > 0)
       drm.api.drmModeRmFB(drm.fd, fb->fd);
 
-   if (fb->bo)
+   if (fb->bo && fb->buffer) {
+      gbm.api.gbm_bo_destroy(fb->bo);
+   } else if (fb->bo) {
       gbm.api.gbm_surface_release_buffer(surface, fb->bo);
+   }
+
+   // Client may reuse the buffer once it's no longer scanned out
+   wlc_buffer_dispose(convert_from_wlc_resource(fb->buffer, WLC_TYPE_BUFFER));
 
    fb->bo = NULL;
+   fb->buffer = 0;
    fb->fd = 0;
 }
 
@@ -203,20 +311,31 @@ static void
 page_flip_handler(int fd, unsigned int frame, unsigned int sec, unsigned int usec, void *data)
 {
    assert(data);
-   (void)fd, (void)frame;
+   (void)fd;
    struct wlc_backend_surface *bsurface = data;
    struct drm_surface *dsurface = bsurface->internal;
 
    uint8_t next = (dsurface->index + 1) % NUM_FBS;
    release_fb(dsurface->surface, &dsurface->fb[next]);
+
+   for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i)
+      release_fb(dsurface->surface, &dsurface->atomic.overlays[i].fb[next]);
+
    dsurface->index = next;
 
+   // Flip completes on vblank, timestamp of it is usable only when in the same clock as ours
    struct timespec ts;
-   ts.tv_sec = sec;
-   ts.tv_nsec = usec * 1000;
+   uint32_t flags = WLC_FRAME_VSYNC | WLC_FRAME_HW_COMPLETION;
+   if (drm.monotonic) {
+      ts.tv_sec = sec;
+      ts.tv_nsec = usec * 1000;
+      flags |= WLC_FRAME_HW_CLOCK;
+   } else {
+      wlc_get_time(&ts);
+   }
 
    struct wlc_output *o;
-   wlc_output_finish_frame(wl_container_of(bsurface, o, bsurface), &ts);
+   wlc_output_finish_frame(wl_container_of(bsurface, o, bsurface), &ts, frame, flags);
    dsurface->flipping = false;
 }
 
@@ -232,6 +351,29 @@ drm_event(int fd, uint32_t mask, void *data)
    return 0;
 }
 
+// format of 0 creates legacy XRGB framebuffer
+static bool
+add_fb(struct drm_fb *fb, uint32_t format)
+{
+   assert(fb && fb->bo);
+
+   uint32_t width = gbm.api.gbm_bo_get_width(fb->bo);
+   uint32_t height = gbm.api.gbm_bo_get_height(fb->bo);
+   uint32_t handle = gbm.api.gbm_bo_get_handle(fb->bo).u32;
+   uint32_t stride = gbm.api.gbm_bo_get_stride(fb->bo);
+
+   if (format) {
+      const uint32_t handles[4] = { handle }, pitches[4] = { stride }, offsets[4] = { 0 };
+      if (drm.api.drmModeAddFB2(drm.fd, width, height, format, handles, pitches, offsets, &fb->fd, 0))
+         return false;
+   } else if (drm.api.drmModeAddFB(drm.fd, width, height, 24, 32, stride, handle, &fb->fd)) {
+      return false;
+   }
+
+   fb->stride = stride;
+   return true;
+}
+
 static bool
 create_fb(struct gbm_surface *surface, struct drm_fb *fb)
 {
@@ -243,15 +385,9 @@ create_fb(struct gbm_surface *surface, struct drm_fb *fb)
    if (!(fb->bo = gbm.api.gbm_surface_lock_front_buffer(surface)))
       goto failed_to_lock;
 
-   uint32_t width = gbm.api.gbm_bo_get_width(fb->bo);
-   uint32_t height = gbm.api.gbm_bo_get_height(fb->bo);
-   uint32_t handle = gbm.api.gbm_bo_get_handle(fb->bo).u32;
-   uint32_t stride = gbm.api.gbm_bo_get_stride(fb->bo);
-
-   if (drm.api.drmModeAddFB(drm.fd, width, height, 24, 32, stride, handle, &fb->fd))
+   if (!add_fb(fb, 0))
       goto failed_to_create_fb;
 
-   fb->stride = stride;
    return true;
 
 no_buffers:
@@ -268,28 +404,278 @@ fail:
 }
 
 static bool
-page_flip(struct wlc_backend_surface *bsurface)
+import_fb(struct drm_surface *dsurface, struct wlc_buffer *buffer, struct drm_fb *fb)
 {
-   assert(bsurface && bsurface->internal);
+   assert(dsurface && buffer && fb);
+
+   struct wl_resource *wl_buffer;
+   if (!(wl_buffer = convert_to_wl_resource(buffer, WLC_TYPE_BUFFER)))
+      return false;
+
+   const struct wlc_dmabuf_attributes *a;
+   if (!(a = wlc_dmabuf_get_attributes(wl_buffer))) {
+      fb->bo = gbm.api.gbm_bo_import(dsurface->device, GBM_BO_IMPORT_WL_BUFFER, wl_buffer, GBM_BO_USE_SCANOUT);
+   } else {
+      // add_fb passes neither offsets nor modifiers to the kernel, only plain single plane layouts scan out
+      if (a->planes != 1 || a->offset[0] != 0 || a->flags || (a->modifier[0] != WLC_DMABUF_MOD_INVALID && a->modifier[0] != WLC_DMABUF_MOD_LINEAR))
+         return false;
+
+#ifdef GBM_BO_IMPORT_FD_MODIFIER
+      struct gbm_import_fd_modifier_data modifier_data = {
+         .width = a->width,
+         .height = a->height,
+         .format = a->format,
+         .num_fds = 1,
+         .fds = { a->fd[0] },
+         .strides = { a->stride[0] },
+         .offsets = { a->offset[0] },
+         .modifier = a->modifier[0],
+      };
+
+      fb->bo = gbm.api.gbm_bo_import(dsurface->device, GBM_BO_IMPORT_FD_MODIFIER, &modifier_data, GBM_BO_USE_SCANOUT);
+#endif
+
+      // Plain fd import can only describe the implicit layout
+      if (!fb->bo && a->modifier[0] == WLC_DMABUF_MOD_INVALID) {
+         struct gbm_import_fd_data fd_data = {
+            .fd = a->fd[0],
+            .width = a->width,
+            .height = a->height,
+            .stride = a->stride[0],
+            .format = a->format,
+         };
+
+         fb->bo = gbm.api.gbm_bo_import(dsurface->device, GBM_BO_IMPORT_FD, &fd_data, GBM_BO_USE_SCANOUT);
+      }
+   }
+
+   if (!fb->bo)
+      return false;
+
+   fb->buffer = wlc_buffer_use(buffer);
+   return true;
+}
+
+static bool
+apply_cursor(struct wlc_backend_surface *bsurface)
+{
+   assert(bsurface);
    struct drm_surface *dsurface = bsurface->internal;
-   assert(!dsurface->flipping);
-   struct drm_fb *fb = &dsurface->fb[dsurface->index];
-   release_fb(dsurface->surface, fb);
 
-   struct wlc_output *o;
-   except((o = wl_container_of(bsurface, o, bsurface)));
+   // Legacy cursor calls would bypass the atomic commits, the cursor plane changes with the next frame instead
+   if (dsurface->atomic.enabled) {
+      struct wlc_output *o;
+      except((o = wl_container_of(bsurface, o, bsurface)));
+      wlc_output_schedule_repaint(o);
+      return true;
+   }
 
-   if (!create_fb(dsurface->surface, fb))
+   if (!dsurface->cursor.enabled)
+      return drm.api.drmModeSetCursor(drm.fd, dsurface->crtc->crtc_id, 0, 0, 0) == 0;
+
+   struct gbm_bo *bo = dsurface->cursor.bo[dsurface->cursor.index];
+   const uint32_t handle = gbm.api.gbm_bo_get_handle(bo).u32;
+   const struct wlc_size *size = &dsurface->cursor.size;
+
+   int ret = -1;
+   if (drm.api.drmModeSetCursor2)
+      ret = drm.api.drmModeSetCursor2(drm.fd, dsurface->crtc->crtc_id, handle, size->w, size->h, dsurface->cursor.hotspot.x, dsurface->cursor.hotspot.y);
+
+   if (ret && drm.api.drmModeSetCursor(drm.fd, dsurface->crtc->crtc_id, handle, size->w, size->h))
+      return false;
+
+   return drm.api.drmModeMoveCursor(drm.fd, dsurface->crtc->crtc_id, dsurface->cursor.pos.x, dsurface->cursor.pos.y) == 0;
+}
+
+static void
+release_cursor_bos(struct drm_surface *dsurface)
+{
+   assert(dsurface);
+
+   for (uint32_t i = 0; i < NUM_FBS; ++i) {
+      if (dsurface->cursor.fb[i])
+         drm.api.drmModeRmFB(drm.fd, dsurface->cursor.fb[i]);
+
+      if (dsurface->cursor.bo[i])
+         gbm.api.gbm_bo_destroy(dsurface->cursor.bo[i]);
+
+      dsurface->cursor.fb[i] = 0;
+      dsurface->cursor.bo[i] = NULL;
+   }
+}
+
+static bool
+create_cursor_bos(struct drm_surface *dsurface)
+{
+   assert(dsurface);
+
+   if (dsurface->cursor.bo[0])
+      return true;
+
+   uint64_t w, h;
+   if (drm.api.drmGetCap(drm.fd, DRM_CAP_CURSOR_WIDTH, &w) || !w || w > 1024)
+      w = 64;
+   if (drm.api.drmGetCap(drm.fd, DRM_CAP_CURSOR_HEIGHT, &h) || !h || h > 1024)
+      h = 64;
+
+   for (uint32_t i = 0; i < NUM_FBS; ++i) {
+      if (!(dsurface->cursor.bo[i] = gbm.api.gbm_bo_create(dsurface->device, w, h, GBM_FORMAT_ARGB8888, GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE)))
+         goto fail;
+
+      struct drm_fb fb = { .bo = dsurface->cursor.bo[i] };
+      if (dsurface->atomic.cursor && !add_fb(&fb, GBM_FORMAT_ARGB8888))
+         goto fail;
+
+      dsurface->cursor.fb[i] = fb.fd;
+   }
+
+   dsurface->cursor.size = (struct wlc_size){ w, h };
+   return true;
+
+fail:
+   wlc_log(WLC_LOG_WARN, "Failed to create %ux%u cursor buffers, falling back to software cursor", (uint32_t)w, (uint32_t)h);
+   release_cursor_bos(dsurface);
+   return false;
+}
+
+static void
+add_plane(drmModeAtomicReq *req, struct drm_plane *plane, uint32_t crtc_id, const struct drm_fb *fb, const struct wlc_geometry *dst)
+{
+   assert(req && plane);
+   const uint32_t id = plane->plane->plane_id;
+
+   if (!fb || !fb->fd) {
+      drm.api.drmModeAtomicAddProperty(req, id, plane->props.fb_id, 0);
+      drm.api.drmModeAtomicAddProperty(req, id, plane->props.crtc_id, 0);
+      return;
+   }
+
+   assert(dst);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.fb_id, fb->fd);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.crtc_id, crtc_id);
+
+   // Source is in 16.16 fixed point
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.src_x, 0);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.src_y, 0);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.src_w, (uint64_t)gbm.api.gbm_bo_get_width(fb->bo) << 16);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.src_h, (uint64_t)gbm.api.gbm_bo_get_height(fb->bo) << 16);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.crtc_x, (uint64_t)(int64_t)dst->origin.x);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.crtc_y, (uint64_t)(int64_t)dst->origin.y);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.crtc_w, dst->size.w);
+   drm.api.drmModeAtomicAddProperty(req, id, plane->props.crtc_h, dst->size.h);
+}
+
+static void
+add_cursor_plane(drmModeAtomicReq *req, struct drm_surface *dsurface)
+{
+   assert(req && dsurface);
+
+   if (!dsurface->atomic.cursor)
+      return;
+
+   if (!dsurface->cursor.enabled) {
+      add_plane(req, dsurface->atomic.cursor, 0, NULL, NULL);
+      return;
+   }
+
+   const uint8_t i = dsurface->cursor.index;
+   const struct drm_fb fb = { .bo = dsurface->cursor.bo[i], .fd = dsurface->cursor.fb[i] };
+   const struct wlc_geometry dst = { dsurface->cursor.pos, dsurface->cursor.size };
+   add_plane(req, dsurface->atomic.cursor, dsurface->crtc->crtc_id, &fb, &dst);
+}
+
+static bool
+atomic_commit(struct wlc_backend_surface *bsurface, const drmModeModeInfo *mode, const struct drm_fb *primary, bool test)
+{
+   assert(bsurface && mode && primary);
+   struct drm_surface *dsurface = bsurface->internal;
+
+   drmModeAtomicReq *req;
+   if (!(req = drm.api.drmModeAtomicAlloc()))
       return false;
 
-   if (fb->stride != dsurface->stride) {
-      if (drm.api.drmModeSetCrtc(drm.fd, dsurface->crtc->crtc_id, fb->fd, 0, 0, &dsurface->connector->connector_id, 1, &dsurface->connector->modes[o->active.mode]))
+   uint32_t flags = (test ? DRM_MODE_ATOMIC_TEST_ONLY : DRM_MODE_PAGE_FLIP_EVENT);
+
+   // Output was off or the mode changed, it needs full modeset
+   if (!test && !dsurface->stride) {
+      if (dsurface->atomic.mode_blob)
+         drm.api.drmModeDestroyPropertyBlob(drm.fd, dsurface->atomic.mode_blob);
+
+      dsurface->atomic.mode_blob = 0;
+      if (drm.api.drmModeCreatePropertyBlob(drm.fd, mode, sizeof(*mode), &dsurface->atomic.mode_blob))
+         goto fail;
+
+      drm.api.drmModeAtomicAddProperty(req, dsurface->connector->connector_id, dsurface->atomic.connector_crtc_id, dsurface->crtc->crtc_id);
+      drm.api.drmModeAtomicAddProperty(req, dsurface->crtc->crtc_id, dsurface->atomic.crtc_mode_id, dsurface->atomic.mode_blob);
+      drm.api.drmModeAtomicAddProperty(req, dsurface->crtc->crtc_id, dsurface->atomic.crtc_active, 1);
+      flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+   } else if (!test) {
+      flags |= DRM_MODE_ATOMIC_NONBLOCK;
+   }
+
+   const struct wlc_geometry full = { wlc_origin_zero, { mode->hdisplay, mode->vdisplay } };
+   add_plane(req, dsurface->atomic.primary, dsurface->crtc->crtc_id, primary, &full);
+
+   // Test checks the overlays assigned for the next frame, commit the ones moved in for this frame
+   for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i) {
+      struct drm_overlay *o = &dsurface->atomic.overlays[i];
+      if (test) {
+         add_plane(req, o->plane, dsurface->crtc->crtc_id, (o->assigned ? &o->pending : NULL), &o->pending_dst);
+      } else {
+         add_plane(req, o->plane, dsurface->crtc->crtc_id, &o->fb[dsurface->index], &o->dst);
+      }
+   }
+
+   // Cursor is a plane like the rest, so it changes in the same commit as the frame
+   add_cursor_plane(req, dsurface);
+
+   const int ret = drm.api.drmModeAtomicCommit(drm.fd, req, flags, bsurface);
+   drm.api.drmModeAtomicFree(req);
+   return (ret == 0);
+
+fail:
+   drm.api.drmModeAtomicFree(req);
+   return false;
+}
+
+static bool
+flip_fb(struct wlc_backend_surface *bsurface, const drmModeModeInfo *mode)
+{
+   assert(bsurface && mode);
+   struct drm_surface *dsurface = bsurface->internal;
+   struct drm_fb *fb = &dsurface->fb[dsurface->index];
+
+   if (dsurface->atomic.enabled) {
+      // Overlays assigned for this frame go on screen with it
+      for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i) {
+         struct drm_overlay *o = &dsurface->atomic.overlays[i];
+         release_fb(dsurface->surface, &o->fb[dsurface->index]);
+
+         if (o->assigned) {
+            o->fb[dsurface->index] = o->pending;
+            o->dst = o->pending_dst;
+         }
+
+         memset(&o->pending, 0, sizeof(o->pending));
+         o->assigned = false;
+      }
+
+      if (!atomic_commit(bsurface, mode, fb, false))
+         goto failed_to_commit;
+
+      dsurface->stride = fb->stride;
+   } else if (fb->stride != dsurface->stride) {
+      if (drm.api.drmModeSetCrtc(drm.fd, dsurface->crtc->crtc_id, fb->fd, 0, 0, &dsurface->connector->connector_id, 1, (drmModeModeInfoPtr)mode))
          goto set_crtc_fail;
 
       dsurface->stride = fb->stride;
+
+      // Mode set may have reset the cursor plane, e.g. after sleep
+      if (dsurface->cursor.enabled)
+         apply_cursor(bsurface);
    }
 
-   if (drm.api.drmModePageFlip(drm.fd, dsurface->crtc->crtc_id, fb->fd, DRM_MODE_PAGE_FLIP_EVENT, bsurface))
+   if (!dsurface->atomic.enabled && drm.api.drmModePageFlip(drm.fd, dsurface->crtc->crtc_id, fb->fd, DRM_MODE_PAGE_FLIP_EVENT, bsurface))
       goto failed_to_page_flip;
 
    dsurface->flipping = true;
@@ -298,10 +684,127 @@ page_flip(struct wlc_backend_surface *bsurface)
 set_crtc_fail:
    wlc_log(WLC_LOG_WARN, "Failed to set mode: %m");
    goto fail;
+failed_to_commit:
+   wlc_log(WLC_LOG_WARN, "Failed to commit atomic state: %m");
+   goto fail;
 failed_to_page_flip:
    wlc_log(WLC_LOG_WARN, "Failed to page flip: %m");
 fail:
    release_fb(dsurface->surface, fb);
+
+   for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i)
+      release_fb(dsurface->surface, &dsurface->atomic.overlays[i].fb[dsurface->index]);
+
+   return false;
+}
+
+static bool
+page_flip(struct wlc_backend_surface *bsurface)
+{
+   assert(bsurface && bsurface->internal);
+   struct drm_surface *dsurface = bsurface->internal;
+   assert(!dsurface->flipping);
+   struct drm_fb *fb = &dsurface->fb[dsurface->index];
+   release_fb(dsurface->surface, fb);
+
+   struct wlc_output *o;
+   except((o = wl_container_of(bsurface, o, bsurface)));
+
+   if (!create_fb(dsurface->surface, fb))
+      return false;
+
+   return flip_fb(bsurface, &dsurface->connector->modes[o->active.mode]);
+}
+
+static bool
+scanout(struct wlc_backend_surface *bsurface, struct wlc_buffer *buffer)
+{
+   assert(bsurface && bsurface->internal);
+   struct drm_surface *dsurface = bsurface->internal;
+   assert(!dsurface->flipping);
+   struct drm_fb *fb = &dsurface->fb[dsurface->index];
+   release_fb(dsurface->surface, fb);
+
+   struct wlc_output *o;
+   except((o = wl_container_of(bsurface, o, bsurface)));
+
+   const drmModeModeInfo *mode = &dsurface->connector->modes[o->active.mode];
+   if (!import_fb(dsurface, buffer, fb))
+      return false;
+
+   // Buffer is scanned out as XRGB, caller ensures it's opaque
+   const uint32_t format = gbm.api.gbm_bo_get_format(fb->bo);
+   if ((format != GBM_FORMAT_XRGB8888 && format != GBM_FORMAT_ARGB8888) ||
+       gbm.api.gbm_bo_get_width(fb->bo) != mode->hdisplay || gbm.api.gbm_bo_get_height(fb->bo) != mode->vdisplay || !add_fb(fb, 0)) {
+      release_fb(dsurface->surface, fb);
+      return false;
+   }
+
+   wlc_dlog(WLC_DBG_RENDER, "-> Scanout of buffer (%" PRIuWLC ")", convert_to_wlc_resource(buffer));
+   return flip_fb(bsurface, mode);
+}
+
+static bool
+plane_supports_format(struct drm_plane *plane, uint32_t format)
+{
+   assert(plane);
+
+   for (uint32_t i = 0; i < plane->plane->count_formats; ++i) {
+      if (plane->plane->formats[i] == format)
+         return true;
+   }
+
+   return false;
+}
+
+static bool
+assign_plane(struct wlc_backend_surface *bsurface, struct wlc_buffer *buffer, const struct wlc_geometry *geometry)
+{
+   assert(bsurface && bsurface->internal);
+   struct drm_surface *dsurface = bsurface->internal;
+
+   if (!buffer) {
+      for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i) {
+         release_fb(dsurface->surface, &dsurface->atomic.overlays[i].pending);
+         dsurface->atomic.overlays[i].assigned = false;
+      }
+      return true;
+   }
+
+   // Assignment is tested against what is on screen, which must be a valid state
+   const struct drm_fb *primary = &dsurface->fb[(dsurface->index + NUM_FBS - 1) % NUM_FBS];
+   if (!geometry || !dsurface->atomic.enabled || !dsurface->stride || !primary->fd)
+      return false;
+
+   struct drm_overlay *o = NULL;
+   for (uint8_t i = 0; i < dsurface->atomic.noverlays && !o; ++i) {
+      if (!dsurface->atomic.overlays[i].assigned)
+         o = &dsurface->atomic.overlays[i];
+   }
+
+   if (!o || !import_fb(dsurface, buffer, &o->pending))
+      return false;
+
+   const uint32_t format = gbm.api.gbm_bo_get_format(o->pending.bo);
+   if (!plane_supports_format(o->plane, format) || !add_fb(&o->pending, format))
+      goto fail;
+
+   struct wlc_output *output;
+   except((output = wl_container_of(bsurface, output, bsurface)));
+
+   o->pending_dst = *geometry;
+   o->assigned = true;
+
+   if (!atomic_commit(bsurface, &dsurface->connector->modes[output->active.mode], primary, true)) {
+      o->assigned = false;
+      goto fail;
+   }
+
+   wlc_dlog(WLC_DBG_RENDER, "-> Assigned buffer (%" PRIuWLC ") to plane %u", convert_to_wlc_resource(buffer), o->plane->plane->plane_id);
+   return true;
+
+fail:
+   release_fb(dsurface->surface, &o->pending);
    return false;
 }
 
@@ -316,6 +819,190 @@ surface_sleep(struct wlc_backend_surface *bsurface, bool sleep)
    }
 }
 
+static bool
+surface_set_cursor(struct wlc_backend_surface *bsurface, const uint32_t *argb, const struct wlc_size *size, const struct wlc_origin *hotspot)
+{
+   struct drm_surface *dsurface = bsurface->internal;
+
+   // Without a cursor plane of its own an atomic crtc can't show a hardware cursor, renderer paints it
+   if (dsurface->atomic.enabled && !dsurface->atomic.cursor)
+      return !argb;
+
+   if (!argb) {
+      const bool was_enabled = dsurface->cursor.enabled;
+      dsurface->cursor.enabled = false;
+      return (was_enabled ? apply_cursor(bsurface) : true);
+   }
+
+   if (!create_cursor_bos(dsurface) || size->w > dsurface->cursor.size.w || size->h > dsurface->cursor.size.h)
+      return false;
+
+   // Cursor buffers have fixed size, pad the image with transparent pixels
+   uint32_t *pixels;
+   if (!(pixels = chck_calloc_of(dsurface->cursor.size.w * dsurface->cursor.size.h, sizeof(uint32_t))))
+      return false;
+
+   for (uint32_t y = 0; y < size->h; ++y)
+      memcpy(pixels + y * dsurface->cursor.size.w, argb + y * size->w, size->w * sizeof(uint32_t));
+
+   // Write to the buffer not being scanned out, to avoid tearing
+   const uint8_t next = (dsurface->cursor.index + 1) % NUM_FBS;
+   const bool written = !gbm.api.gbm_bo_write(dsurface->cursor.bo[next], pixels, dsurface->cursor.size.w * dsurface->cursor.size.h * sizeof(uint32_t));
+   free(pixels);
+
+   if (!written)
+      return false;
+
+   dsurface->cursor.index = next;
+   dsurface->cursor.hotspot = *hotspot;
+   dsurface->cursor.enabled = true;
+
+   if (!apply_cursor(bsurface)) {
+      dsurface->cursor.enabled = false;
+      return false;
+   }
+
+   return true;
+}
+
+static bool
+surface_move_cursor(struct wlc_backend_surface *bsurface, const struct wlc_origin *pos)
+{
+   struct drm_surface *dsurface = bsurface->internal;
+   dsurface->cursor.pos = *pos;
+
+   if (!dsurface->cursor.enabled)
+      return false;
+
+   // Position is committed with the next frame, nothing else may be damaged so make sure one is coming
+   if (dsurface->atomic.enabled) {
+      struct wlc_output *o;
+      except((o = wl_container_of(bsurface, o, bsurface)));
+      wlc_output_schedule_repaint(o);
+      return true;
+   }
+
+   return drm.api.drmModeMoveCursor(drm.fd, dsurface->crtc->crtc_id, pos->x, pos->y) == 0;
+}
+
+static uint32_t
+get_property(uint32_t object, uint32_t type, const char *name, uint64_t *out_value)
+{
+   assert(name);
+
+   drmModeObjectProperties *props;
+   if (!(props = drm.api.drmModeObjectGetProperties(drm.fd, object, type)))
+      return 0;
+
+   uint32_t id = 0;
+   for (uint32_t i = 0; i < props->count_props && !id; ++i) {
+      drmModePropertyRes *prop;
+      if (!(prop = drm.api.drmModeGetProperty(drm.fd, props->props[i])))
+         continue;
+
+      if (chck_cstreq(prop->name, name)) {
+         id = prop->prop_id;
+
+         if (out_value)
+            *out_value = props->prop_values[i];
+      }
+
+      drm.api.drmModeFreeProperty(prop);
+   }
+
+   drm.api.drmModeFreeObjectProperties(props);
+   return id;
+}
+
+static void
+release_planes(struct drm_surface *dsurface)
+{
+   assert(dsurface);
+
+   bool planes_on = (dsurface->atomic.cursor && dsurface->cursor.enabled);
+   for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i) {
+      for (uint8_t f = 0; f < NUM_FBS; ++f)
+         planes_on = planes_on || dsurface->atomic.overlays[i].fb[f].fd;
+   }
+
+   // Overlays and cursor would stay on screen with the restored crtc
+   drmModeAtomicReq *req;
+   if (planes_on && (req = drm.api.drmModeAtomicAlloc())) {
+      for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i)
+         add_plane(req, dsurface->atomic.overlays[i].plane, 0, NULL, NULL);
+
+      if (dsurface->atomic.cursor)
+         add_plane(req, dsurface->atomic.cursor, 0, NULL, NULL);
+
+      drm.api.drmModeAtomicCommit(drm.fd, req, 0, NULL);
+      drm.api.drmModeAtomicFree(req);
+   }
+
+   for (uint8_t i = 0; i < dsurface->atomic.noverlays; ++i) {
+      struct drm_overlay *o = &dsurface->atomic.overlays[i];
+      release_fb(dsurface->surface, &o->pending);
+
+      for (uint8_t f = 0; f < NUM_FBS; ++f)
+         release_fb(dsurface->surface, &o->fb[f]);
+
+      o->plane->owner = NULL;
+   }
+
+   if (dsurface->atomic.primary)
+      dsurface->atomic.primary->owner = NULL;
+
+   if (dsurface->atomic.cursor)
+      dsurface->atomic.cursor->owner = NULL;
+
+   if (dsurface->atomic.mode_blob)
+      drm.api.drmModeDestroyPropertyBlob(drm.fd, dsurface->atomic.mode_blob);
+
+   memset(&dsurface->atomic, 0, sizeof(dsurface->atomic));
+}
+
+static bool
+claim_planes(struct drm_surface *dsurface, uint32_t crtc_index)
+{
+   assert(dsurface);
+
+   if (!drm.atomic)
+      return false;
+
+   if (!(dsurface->atomic.crtc_mode_id = get_property(dsurface->crtc->crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID", NULL)) ||
+       !(dsurface->atomic.crtc_active = get_property(dsurface->crtc->crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE", NULL)) ||
+       !(dsurface->atomic.connector_crtc_id = get_property(dsurface->connector->connector_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID", NULL)))
+      goto fail;
+
+   struct drm_plane *plane;
+   chck_iter_pool_for_each(&drm.planes, plane) {
+      if (plane->owner || !(plane->plane->possible_crtcs & (1 << crtc_index)))
+         continue;
+
+      if (plane->type == DRM_PLANE_TYPE_PRIMARY && !dsurface->atomic.primary) {
+         dsurface->atomic.primary = plane;
+         plane->owner = dsurface;
+      } else if (plane->type == DRM_PLANE_TYPE_CURSOR && !dsurface->atomic.cursor) {
+         dsurface->atomic.cursor = plane;
+         plane->owner = dsurface;
+      } else if (plane->type == DRM_PLANE_TYPE_OVERLAY && dsurface->atomic.noverlays < MAX_OVERLAYS) {
+         dsurface->atomic.overlays[dsurface->atomic.noverlays++].plane = plane;
+         plane->owner = dsurface;
+      }
+   }
+
+   if (!dsurface->atomic.primary)
+      goto fail;
+
+   dsurface->atomic.enabled = true;
+   wlc_log(WLC_LOG_INFO, "Using atomic modesetting for crtc %u with %u overlay plane(s)", dsurface->crtc->crtc_id, dsurface->atomic.noverlays);
+   return true;
+
+fail:
+   wlc_log(WLC_LOG_WARN, "Crtc %u has no usable planes, using legacy modesetting", dsurface->crtc->crtc_id);
+   release_planes(dsurface);
+   return false;
+}
+
 static void
 surface_release(struct wlc_backend_surface *bsurface)
 {
@@ -323,6 +1010,12 @@ surface_release(struct wlc_backend_surface *bsurface)
    struct drm_fb *fb = &dsurface->fb[dsurface->index];
    release_fb(dsurface->surface, fb);
 
+   if (dsurface->cursor.enabled && !dsurface->atomic.enabled)
+      drm.api.drmModeSetCursor(drm.fd, dsurface->crtc->crtc_id, 0, 0, 0);
+
+   release_planes(dsurface);
+   release_cursor_bos(dsurface);
+
    drm.api.drmModeSetCrtc(drm.fd, dsurface->crtc->crtc_id, dsurface->crtc->buffer_id, dsurface->crtc->x, dsurface->crtc->y, &dsurface->connector->connector_id, 1, &dsurface->crtc->mode);
 
    if (dsurface->crtc)
@@ -354,10 +1047,16 @@ add_output(struct gbm_device *device, struct gbm_surface *surface, struct drm_ou
    dsurface->surface = surface;
    dsurface->device = device;
 
+   if (claim_planes(dsurface, info->crtc_index))
+      bsurface.api.assign_plane = assign_plane;
+
    bsurface.display = (EGLNativeDisplayType)device;
    bsurface.window = (EGLNativeWindowType)surface;
    bsurface.api.sleep = surface_sleep;
    bsurface.api.page_flip = page_flip;
+   bsurface.api.scanout = scanout;
+   bsurface.api.set_cursor = surface_set_cursor;
+   bsurface.api.move_cursor = surface_move_cursor;
 
    struct wlc_output_event ev = { .add = { &bsurface, &info->info }, .type = WLC_OUTPUT_EVENT_ADD };
    wl_signal_emit(&wlc_system_signals()->output, &ev);
@@ -469,6 +1168,12 @@ query_drm(int fd, struct chck_iter_pool *out_infos)
          continue;
       }
 
+      // Planes refer to crtcs by their index in resources
+      for (int i = 0; i < resources->count_crtcs; ++i) {
+         if (resources->crtcs[i] == (uint32_t)crtc_id)
+            info->crtc_index = i;
+      }
+
       wlc_output_information(&info->info);
       chck_string_set_cstr(&info->info.make, "drm", false); // we can use colord for real info
       chck_string_set_cstr(&info->info.model, "unknown", false); // ^
@@ -522,6 +1227,11 @@ terminate(void)
    if (drm.event_source)
       wl_event_source_remove(drm.event_source);
 
+   struct drm_plane *plane;
+   chck_iter_pool_for_each(&drm.planes, plane)
+      drm.api.drmModeFreePlane(plane->plane);
+   chck_iter_pool_release(&drm.planes);
+
    if (gbm.device)
       gbm.api.gbm_device_destroy(gbm.device);
 
@@ -540,11 +1250,54 @@ terminate(void)
 }
 
 static bool
-output_exists_for_connector(struct chck_pool *outputs, drmModeConnector *connector)
+query_planes(void)
+{
+   drmModePlaneRes *resources;
+   if (!(resources = drm.api.drmModeGetPlaneResources(drm.fd)))
+      return false;
+
+   if (!chck_iter_pool(&drm.planes, 8, resources->count_planes, sizeof(struct drm_plane)))
+      goto fail;
+
+   for (uint32_t i = 0; i < resources->count_planes; ++i) {
+      struct drm_plane plane = {0};
+      if (!(plane.plane = drm.api.drmModeGetPlane(drm.fd, resources->planes[i])))
+         continue;
+
+      const uint32_t id = plane.plane->plane_id, type = DRM_MODE_OBJECT_PLANE;
+      if (!get_property(id, type, "type", &plane.type) ||
+          !(plane.props.fb_id = get_property(id, type, "FB_ID", NULL)) ||
+          !(plane.props.crtc_id = get_property(id, type, "CRTC_ID", NULL)) ||
+          !(plane.props.src_x = get_property(id, type, "SRC_X", NULL)) ||
+          !(plane.props.src_y = get_property(id, type, "SRC_Y", NULL)) ||
+          !(plane.props.src_w = get_property(id, type, "SRC_W", NULL)) ||
+          !(plane.props.src_h = get_property(id, type, "SRC_H", NULL)) ||
+          !(plane.props.crtc_x = get_property(id, type, "CRTC_X", NULL)) ||
+          !(plane.props.crtc_y = get_property(id, type, "CRTC_Y", NULL)) ||
+          !(plane.props.crtc_w = get_property(id, type, "CRTC_W", NULL)) ||
+          !(plane.props.crtc_h = get_property(id, type, "CRTC_H", NULL)) ||
+          !chck_iter_pool_push_back(&drm.planes, &plane)) {
+         drm.api.drmModeFreePlane(plane.plane);
+         continue;
+      }
+
+      wlc_log(WLC_LOG_INFO, "PLANE: %u (%s) with %u formats", id, (plane.type == DRM_PLANE_TYPE_PRIMARY ? "primary" : (plane.type == DRM_PLANE_TYPE_OVERLAY ? "overlay" : "cursor")), plane.plane->count_formats);
+   }
+
+   drm.api.drmModeFreePlaneResources(resources);
+   return true;
+
+fail:
+   drm.api.drmModeFreePlaneResources(resources);
+   return false;
+}
+
+static bool
+output_exists_for_connector(struct wlc_slab *outputs, drmModeConnector *connector)
 {
    assert(outputs && connector);
    struct wlc_output *o;
-   chck_pool_for_each(outputs, o) {
+   wlc_slab_for_each(outputs, o) {
       struct drm_surface *dsurface = o->bsurface.internal;
       if (dsurface && dsurface->connector->connector_id == connector->connector_id)
          return true;
@@ -565,7 +1318,7 @@ info_exists_for_drm_surface(struct chck_iter_pool *infos, struct drm_surface *ds
 }
 
 static uint32_t
-update_outputs(struct chck_pool *outputs)
+update_outputs(struct wlc_slab *outputs)
 {
    struct chck_iter_pool infos;
    if (!chck_iter_pool(&infos, 4, 0, sizeof(struct drm_output_information)) || !query_drm(drm.fd, &infos))
@@ -573,7 +1326,7 @@ update_outputs(struct chck_pool *outputs)
 
    if (outputs) {
       struct wlc_output *o;
-      chck_pool_for_each(outputs, o) {
+      wlc_slab_for_each(outputs, o) {
          struct drm_surface *dsurface;
          if (!(dsurface = o->bsurface.internal))
             continue;
@@ -632,6 +1385,24 @@ wlc_drm(struct wlc_backend *backend)
    if (!(gbm.device = gbm.api.gbm_create_device(drm.fd)))
       goto gbm_device_fail;
 
+   {
+      uint64_t cap;
+      drm.monotonic = (!drm.api.drmGetCap(drm.fd, DRM_CAP_TIMESTAMP_MONOTONIC, &cap) && cap);
+   }
+
+   {
+      bool use_atomic = true;
+      chck_cstr_to_bool(getenv("WLC_DRM_ATOMIC"), &use_atomic);
+
+      // Planes are exposed only to clients that ask for them
+      drm.atomic = (use_atomic && drm.atomic &&
+                    !drm.api.drmSetClientCap(drm.fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) &&
+                    !drm.api.drmSetClientCap(drm.fd, DRM_CLIENT_CAP_ATOMIC, 1) &&
+                    query_planes());
+
+      wlc_log(WLC_LOG_INFO, "%s modesetting", (drm.atomic ? "Atomic" : "Legacy"));
+   }
+
    if (!(drm.event_source = wl_event_loop_add_fd(wlc_event_loop(), drm.fd, WL_EVENT_READABLE, drm_event, NULL)))
       goto fail;
 
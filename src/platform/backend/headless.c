@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <wayland-server.h>
+#include <chck/math/math.h>
+#include <chck/string/string.h>
+#include "internal.h"
+#include "macros.h"
+#include "headless.h"
+#include "backend.h"
+#include "compositor/output.h"
+
+struct headless_surface {
+   struct wl_event_source *timer;
+   struct timespec vblank; // time of last virtual vblank
+   uint32_t refresh; // mHz
+   wlc_handle output;
+};
+
+static struct {
+   struct wlc_backend *backend;
+   struct wlc_output_mode mode;
+   uint32_t outputs;
+} headless;
+
+static int
+cb_vblank_timer(void *data)
+{
+   struct headless_surface *surface = data;
+   assert(surface);
+   wlc_output_finish_frame(convert_from_wlc_handle(surface->output, WLC_TYPE_OUTPUT), &surface->vblank, 0, 0);
+   return 0;
+}
+
+static bool
+page_flip(struct wlc_backend_surface *bsurface)
+{
+   struct headless_surface *surface;
+   if (!(surface = bsurface->internal))
+      return false;
+
+   struct wlc_output *o;
+   surface->output = convert_to_wlc_handle(wl_container_of(bsurface, o, bsurface));
+
+   struct timespec now;
+   wlc_get_time(&now);
+
+   // Advance to the first virtual vblank after now, keeping the refresh cadence
+   const int64_t interval = 1000000000000LL / surface->refresh;
+   const int64_t now_ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+   int64_t vblank_ns = (int64_t)surface->vblank.tv_sec * 1000000000LL + surface->vblank.tv_nsec;
+
+   if (vblank_ns + interval <= now_ns) {
+      vblank_ns = now_ns + interval;
+   } else {
+      vblank_ns += interval;
+   }
+
+   surface->vblank.tv_sec = vblank_ns / 1000000000LL;
+   surface->vblank.tv_nsec = vblank_ns % 1000000000LL;
+
+   const int32_t ms = (vblank_ns - now_ns + 999999) / 1000000;
+   wl_event_source_timer_update(surface->timer, chck_max32(ms, 1));
+   return true;
+}
+
+static void
+surface_release(struct wlc_backend_surface *bsurface)
+{
+   struct headless_surface *surface;
+   if (!(surface = bsurface->internal))
+      return;
+
+   if (surface->timer)
+      wl_event_source_remove(surface->timer);
+}
+
+static bool
+add_output(struct wlc_output_information *info)
+{
+   struct wlc_backend_surface bsurface;
+   if (!wlc_backend_surface(&bsurface, surface_release, sizeof(struct headless_surface)))
+      return false;
+
+   struct headless_surface *surface = bsurface.internal;
+   surface->refresh = headless.mode.refresh;
+
+   if (!(surface->timer = wl_event_loop_add_timer(wlc_event_loop(), cb_vblank_timer, surface))) {
+      wlc_backend_surface_release(&bsurface);
+      return false;
+   }
+
+   // There is no native display nor window, context renders offscreen.
+   // Display only marks the surface as valid for the output.
+   bsurface.display = (EGLNativeDisplayType)&headless;
+   bsurface.offscreen = (struct wlc_size){ headless.mode.width, headless.mode.height };
+   bsurface.api.page_flip = page_flip;
+
+   struct wlc_output_event ev = { .add = { &bsurface, info }, .type = WLC_OUTPUT_EVENT_ADD };
+   wl_signal_emit(&wlc_system_signals()->output, &ev);
+   return true;
+}
+
+static void
+fake_information(struct wlc_output_information *info, uint32_t id)
+{
+   assert(info);
+   wlc_output_information(info);
+   chck_string_set_cstr(&info->make, "wlc", false);
+   chck_string_set_cstr(&info->model, "Headless", false);
+   info->scale = 1;
+   info->connector = WLC_CONNECTOR_WLC;
+   info->connector_id = id;
+   wlc_output_information_add_mode(info, &headless.mode);
+}
+
+static uint32_t
+update_outputs(struct wlc_slab *outputs)
+{
+   uint32_t alive = 0;
+   if (outputs) {
+      struct wlc_output *o;
+      wlc_slab_for_each(outputs, o) {
+         if (o->bsurface.display == (EGLNativeDisplayType)&headless)
+            ++alive;
+      }
+   }
+
+   uint32_t count = 0;
+   for (uint32_t i = alive; i < headless.outputs; ++i) {
+      struct wlc_output_information info;
+      fake_information(&info, 1 + i);
+      count += (add_output(&info) ? 1 : 0);
+   }
+
+   return count;
+}
+
+static void
+terminate(void)
+{
+   memset(&headless, 0, sizeof(headless));
+}
+
+bool
+wlc_headless(struct wlc_backend *backend)
+{
+   headless.backend = backend;
+
+   headless.outputs = 1;
+   const char *env;
+   if ((env = getenv("WLC_OUTPUTS"))) {
+      chck_cstr_to_u32(env, &headless.outputs);
+      headless.outputs = chck_maxu32(headless.outputs, 1);
+   }
+
+   // WLC_HEADLESS_MODE=WIDTHxHEIGHT[@HZ]
+   uint32_t w = 800, h = 480, hz = 60;
+   if ((env = getenv("WLC_HEADLESS_MODE")) && sscanf(env, "%ux%u@%u", &w, &h, &hz) < 2) {
+      wlc_log(WLC_LOG_WARN, "Invalid WLC_HEADLESS_MODE '%s', expected WIDTHxHEIGHT[@HZ]", env);
+      w = 800, h = 480, hz = 60;
+   }
+
+   if (w == 0 || h == 0 || w > INT32_MAX || h > INT32_MAX || hz == 0 || hz > INT32_MAX / 1000) {
+      wlc_log(WLC_LOG_WARN, "Invalid headless mode %ux%u@%u, using 800x480@60", w, h, hz);
+      w = 800, h = 480, hz = 60;
+   }
+
+   headless.mode.refresh = hz * 1000; // mHz
+   headless.mode.width = w;
+   headless.mode.height = h;
+   headless.mode.flags = WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED;
+
+   wlc_log(WLC_LOG_INFO, "Headless backend with %u output(s) of %ux%u@%u", headless.outputs, w, h, hz);
+
+   backend->api.update_outputs = update_outputs;
+   backend->api.terminate = terminate;
+   return true;
+}
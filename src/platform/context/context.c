@@ -30,7 +30,7 @@ wlc_context_query_buffer(struct wlc_context *context, struct wl_resource *buffer
 EGLImageKHR
 wlc_context_create_image(struct wlc_context *context, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list)
 {
-   assert(context && buffer);
+   assert(context);
 
    if (!context->api.create_image)
       return 0;
@@ -49,6 +49,28 @@ wlc_context_destroy_image(struct wlc_context *context, EGLImageKHR image)
    return context->api.destroy_image(context->context, image);
 }
 
+EGLBoolean
+wlc_context_query_dmabuf_formats(struct wlc_context *context, EGLint max, EGLint *formats, EGLint *num)
+{
+   assert(context && num);
+
+   if (!context->api.query_dmabuf_formats)
+      return EGL_FALSE;
+
+   return context->api.query_dmabuf_formats(context->context, max, formats, num);
+}
+
+EGLBoolean
+wlc_context_query_dmabuf_modifiers(struct wlc_context *context, EGLint format, EGLint max, EGLuint64KHR *modifiers, EGLint *num)
+{
+   assert(context && num);
+
+   if (!context->api.query_dmabuf_modifiers)
+      return EGL_FALSE;
+
+   return context->api.query_dmabuf_modifiers(context->context, format, max, modifiers, num);
+}
+
 bool
 wlc_context_bind(struct wlc_context *context)
 {
@@ -64,6 +86,17 @@ fail:
    return false;
 }
 
+bool
+wlc_context_shares(struct wlc_context *context, struct wlc_context *other)
+{
+   assert(context && other);
+
+   if (!context->context || !other->context || !context->api.shares || context->api.shares != other->api.shares)
+      return false;
+
+   return context->api.shares(context->context, other->context);
+}
+
 bool
 wlc_context_bind_to_wl_display(struct wlc_context *context, struct wl_display *display)
 {
@@ -76,12 +109,23 @@ wlc_context_bind_to_wl_display(struct wlc_context *context, struct wl_display *d
 }
 
 void
-wlc_context_swap(struct wlc_context *context, struct wlc_backend_surface *bsurface)
+wlc_context_swap(struct wlc_context *context, struct wlc_backend_surface *bsurface, pixman_region32_t *damage)
 {
    assert(context);
 
    if (context->api.swap)
-      context->api.swap(context->context, bsurface);
+      context->api.swap(context->context, bsurface, damage);
+}
+
+uint32_t
+wlc_context_get_buffer_age(struct wlc_context *context)
+{
+   assert(context);
+
+   if (!context->api.buffer_age)
+      return 0;
+
+   return context->api.buffer_age(context->context);
 }
 
 void
@@ -1,7 +1,9 @@
 #ifndef _WLC_CONTEXT_H_
 #define _WLC_CONTEXT_H_
 
+#include <stdint.h>
 #include <stdbool.h>
+#include <pixman.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
@@ -12,14 +14,18 @@ struct ctx;
 struct wlc_context_api {
    WLC_NONULL void (*terminate)(struct ctx *context);
    WLC_NONULL bool (*bind)(struct ctx *context);
+   WLC_NONULL bool (*shares)(struct ctx *context, struct ctx *other); // objects of one context can be used in the other
    WLC_NONULL bool (*bind_to_wl_display)(struct ctx *context, struct wl_display *display);
-   WLC_NONULL void (*swap)(struct ctx *context, struct wlc_backend_surface *bsurface);
+   WLC_NONULLV(1,2) void (*swap)(struct ctx *context, struct wlc_backend_surface *bsurface, pixman_region32_t *damage); // damage in surface pixels, NULL == everything
+   WLC_NONULL uint32_t (*buffer_age)(struct ctx *context); // 0 == contents of back buffer are undefined, n == contents are from n frames ago
    WLC_NONULL void* (*get_proc_address)(struct ctx *context, const char *procname);
 
    // EGL
    WLC_NONULL EGLBoolean (*query_buffer)(struct ctx *context, struct wl_resource *buffer, EGLint attribute, EGLint *value);
-   WLC_NONULL EGLImageKHR (*create_image)(struct ctx *context, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list);
+   WLC_NONULLV(1) EGLImageKHR (*create_image)(struct ctx *context, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list); // buffer is NULL for EGL_LINUX_DMA_BUF_EXT
    WLC_NONULL EGLBoolean (*destroy_image)(struct ctx *context, EGLImageKHR image);
+   WLC_NONULLV(1,4) EGLBoolean (*query_dmabuf_formats)(struct ctx *context, EGLint max, EGLint *formats, EGLint *num); // max == 0 queries only num, EGL_FALSE == dmabufs can't be imported
+   WLC_NONULLV(1,5) EGLBoolean (*query_dmabuf_modifiers)(struct ctx *context, EGLint format, EGLint max, EGLuint64KHR *modifiers, EGLint *num);
 };
 
 struct wlc_context {
@@ -29,11 +35,15 @@ struct wlc_context {
 
 WLC_NONULL void* wlc_context_get_proc_address(struct wlc_context *context, const char *procname);
 WLC_NONULL EGLBoolean wlc_context_query_buffer(struct wlc_context *context, struct wl_resource *buffer, EGLint attribute, EGLint *value);
-WLC_NONULL EGLImageKHR wlc_context_create_image(struct wlc_context *context, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list);
+WLC_NONULLV(1) EGLImageKHR wlc_context_create_image(struct wlc_context *context, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list);
 WLC_NONULL EGLBoolean wlc_context_destroy_image(struct wlc_context *context, EGLImageKHR image);
+WLC_NONULLV(1,4) EGLBoolean wlc_context_query_dmabuf_formats(struct wlc_context *context, EGLint max, EGLint *formats, EGLint *num);
+WLC_NONULLV(1,5) EGLBoolean wlc_context_query_dmabuf_modifiers(struct wlc_context *context, EGLint format, EGLint max, EGLuint64KHR *modifiers, EGLint *num);
 WLC_NONULL bool wlc_context_bind(struct wlc_context *context);
+WLC_NONULL bool wlc_context_shares(struct wlc_context *context, struct wlc_context *other);
 WLC_NONULL bool wlc_context_bind_to_wl_display(struct wlc_context *context, struct wl_display *display);
-WLC_NONULL void wlc_context_swap(struct wlc_context *context, struct wlc_backend_surface *bsurface);
+WLC_NONULLV(1,2) void wlc_context_swap(struct wlc_context *context, struct wlc_backend_surface *bsurface, pixman_region32_t *damage);
+WLC_NONULL uint32_t wlc_context_get_buffer_age(struct wlc_context *context);
 void wlc_context_release(struct wlc_context *context);
 WLC_NONULL bool wlc_context(struct wlc_context *context, struct wlc_backend_surface *bsurface);
 
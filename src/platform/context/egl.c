@@ -4,8 +4,10 @@
 #include <assert.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
+#include <drm_fourcc.h>
 #include <wayland-server.h>
 #include <chck/string/string.h>
+#include <chck/overflow/overflow.h>
 #include "internal.h"
 #include "macros.h"
 #include "egl.h"
@@ -21,7 +23,11 @@ struct ctx {
    EGLContext context;
    EGLSurface surface;
    EGLConfig config;
+   bool shared; // context is in the share group of egl.share
    bool flip_failed;
+   bool preserved;
+   bool buffer_age;
+   bool dmabuf; // EGL_EXT_image_dma_buf_import
 
    struct {
       // Needed for EGL hw surfaces
@@ -31,6 +37,8 @@ struct ctx {
       PFNEGLBINDWAYLANDDISPLAYWL eglBindWaylandDisplayWL;
       PFNEGLUNBINDWAYLANDDISPLAYWL eglUnbindWaylandDisplayWL;
       PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC eglSwapBuffersWithDamage;
+      PFNEGLQUERYDMABUFFORMATSEXTPROC eglQueryDmaBufFormatsEXT;
+      PFNEGLQUERYDMABUFMODIFIERSEXTPROC eglQueryDmaBufModifiersEXT;
    } api;
 };
 
@@ -49,7 +57,10 @@ static struct {
       EGLContext (*eglCreateContext)(EGLDisplay, EGLConfig, EGLContext, EGLint const*);
       EGLBoolean (*eglDestroyContext)(EGLDisplay, EGLContext);
       EGLSurface (*eglCreateWindowSurface)(EGLDisplay, EGLConfig, NativeWindowType, EGLint const*);
+      EGLSurface (*eglCreatePbufferSurface)(EGLDisplay, EGLConfig, EGLint const*);
       EGLBoolean (*eglDestroySurface)(EGLDisplay, EGLSurface);
+      EGLBoolean (*eglSurfaceAttrib)(EGLDisplay, EGLSurface, EGLint, EGLint);
+      EGLBoolean (*eglQuerySurface)(EGLDisplay, EGLSurface, EGLint, EGLint*);
       EGLBoolean (*eglMakeCurrent)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
       EGLBoolean (*eglSwapBuffers)(EGLDisplay, EGLSurface);
       EGLBoolean (*eglSwapInterval)(EGLDisplay, EGLint);
@@ -61,8 +72,27 @@ static struct {
       PFNEGLBINDWAYLANDDISPLAYWL eglBindWaylandDisplayWL;
       PFNEGLUNBINDWAYLANDDISPLAYWL eglUnbindWaylandDisplayWL;
       PFNEGLQUERYWAYLANDBUFFERWL eglQueryWaylandBufferWL;
-      PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC eglSwapBuffersWithDamage;
+      PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC eglSwapBuffersWithDamageEXT;
+      PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC eglSwapBuffersWithDamageKHR;
+
+      // Needed for advertising dmabuf formats and modifiers
+      PFNEGLQUERYDMABUFFORMATSEXTPROC eglQueryDmaBufFormatsEXT;
+      PFNEGLQUERYDMABUFMODIFIERSEXTPROC eglQueryDmaBufModifiersEXT;
+
+      // Needed for offscreen surfaces
+      PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT;
    } api;
+
+   // Contexts of all outputs share textures, buffers and images through this context.
+   // It is never made current, it only keeps the share group alive while outputs come and go.
+   struct {
+      EGLDisplay display;
+      EGLContext context;
+      uint32_t refs;
+   } share;
+
+   struct ctx *bound;
+   bool debug; // WLC_DEBUG=gl, check errors after every call
 } egl;
 
 static bool
@@ -101,8 +131,14 @@ egl_load(void)
       goto function_pointer_exception;
    if (!load(eglCreateWindowSurface))
       goto function_pointer_exception;
+   if (!load(eglCreatePbufferSurface))
+      goto function_pointer_exception;
    if (!load(eglDestroySurface))
       goto function_pointer_exception;
+   if (!load(eglSurfaceAttrib))
+      goto function_pointer_exception;
+   if (!load(eglQuerySurface))
+      goto function_pointer_exception;
    if (!load(eglMakeCurrent))
       goto function_pointer_exception;
    if (!load(eglSwapBuffers))
@@ -123,6 +159,17 @@ egl_load(void)
    load(eglUnbindWaylandDisplayWL);
    load(eglQueryWaylandBufferWL);
 
+   // Optional, used for submitting damage on swap
+   load(eglSwapBuffersWithDamageEXT);
+   load(eglSwapBuffersWithDamageKHR);
+
+   // Optional, used for advertising dmabuf formats and modifiers
+   load(eglQueryDmaBufFormatsEXT);
+   load(eglQueryDmaBufModifiersEXT);
+
+   // Optional, used for offscreen surfaces
+   load(eglGetPlatformDisplayEXT);
+
 #undef load
 
    return true;
@@ -193,18 +240,23 @@ egl_call(const char *func, uint32_t line, const char *eglfunc)
 #  define __STRING(x) #x
 #endif
 
-#define EGL_CALL(x) x; egl_call(__PRETTY_FUNCTION__, __LINE__, __STRING(x))
+#ifdef WLC_GL_CALL_CHECKS
+#  define EGL_CALL(x) do { x; egl_call(__PRETTY_FUNCTION__, __LINE__, __STRING(x)); } while (0)
+#else
+// Errors are checked once per frame after the swap in swap(), EGL only keeps the error of the last call anyway
+#  define EGL_CALL(x) do { x; if (egl.debug) egl_call(__PRETTY_FUNCTION__, __LINE__, __STRING(x)); } while (0)
+#endif
 
 WLC_PURE static bool
-has_extension(const struct ctx *context, const char *extension)
+has_extension(const char *extensions, const char *extension)
 {
-   assert(context && extension);
+   assert(extension);
 
-   if (!context->extensions)
+   if (!extensions)
       return false;
 
    size_t len = strlen(extension), pos;
-   const char *s = context->extensions;
+   const char *s = extensions;
    while ((pos = strcspn(s, " ")) != 0) {
       size_t next = pos + (s[pos] != 0);
 
@@ -217,6 +269,40 @@ has_extension(const struct ctx *context, const char *extension)
    return false;
 }
 
+static EGLContext
+share_context_ref(EGLDisplay display, EGLConfig config, const EGLint *attribs)
+{
+   if (egl.share.refs > 0) {
+      // Contexts can only share on the same display
+      if (egl.share.display != display)
+         return EGL_NO_CONTEXT;
+
+      egl.share.refs++;
+      return egl.share.context;
+   }
+
+   EGLContext share;
+   if ((share = egl.api.eglCreateContext(display, config, EGL_NO_CONTEXT, attribs)) == EGL_NO_CONTEXT)
+      return EGL_NO_CONTEXT;
+
+   egl.share.display = display;
+   egl.share.context = share;
+   egl.share.refs = 1;
+   return share;
+}
+
+static void
+share_context_unref(void)
+{
+   assert(egl.share.refs > 0);
+
+   if (--egl.share.refs > 0)
+      return;
+
+   EGL_CALL(egl.api.eglDestroyContext(egl.share.display, egl.share.context));
+   memset(&egl.share, 0, sizeof(egl.share));
+}
+
 static void
 terminate(struct ctx *context)
 {
@@ -224,6 +310,9 @@ terminate(struct ctx *context)
 
    EGL_CALL(egl.api.eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT));
 
+   if (egl.bound == context)
+      egl.bound = NULL;
+
    if (context->surface) {
       EGL_CALL(egl.api.eglDestroySurface(context->display, context->surface));
    }
@@ -232,6 +321,9 @@ terminate(struct ctx *context)
       EGL_CALL(egl.api.eglDestroyContext(context->display, context->context));
    }
 
+   if (context->shared)
+      share_context_unref();
+
    // XXX: This is shared on all backends
 #if 0
    if (context->display) {
@@ -246,6 +338,26 @@ terminate(struct ctx *context)
    free(context);
 }
 
+static EGLDisplay
+get_display(struct wlc_backend_surface *bsurface)
+{
+   assert(bsurface);
+
+   if (!bsurface->offscreen.w)
+      return egl.api.eglGetDisplay(bsurface->display);
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#  define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+   // Surfaceless platform needs no windowing system nor GPU (llvmpipe)
+   const char *client_extensions = egl.api.eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+   if (egl.api.eglGetPlatformDisplayEXT && has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+      return egl.api.eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+   return egl.api.eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
 static struct ctx*
 create_context(struct wlc_backend_surface *bsurface)
 {
@@ -255,7 +367,10 @@ create_context(struct wlc_backend_surface *bsurface)
    if (!(context = calloc(1, sizeof(struct ctx))))
       return NULL;
 
-   if (!(context->display = egl.api.eglGetDisplay(bsurface->display)))
+   const bool offscreen = (bsurface->offscreen.w > 0 && bsurface->offscreen.h > 0);
+   const EGLint surface_type = (offscreen ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT);
+
+   if (!(context->display = get_display(bsurface)))
       goto egl_fail;
 
    EGLint major, minor;
@@ -265,12 +380,28 @@ create_context(struct wlc_backend_surface *bsurface)
    if (!egl.api.eglBindAPI(EGL_OPENGL_ES_API))
       goto egl_fail;
 
+   EGL_CALL(context->extensions = egl.api.eglQueryString(context->display, EGL_EXTENSIONS));
+   context->buffer_age = has_extension(context->extensions, "EGL_EXT_buffer_age");
+
    const struct {
       const EGLint *attribs;
    } configs[] = {
+      {
+         // Preserved back buffer lets us repaint only damaged areas
+         (const EGLint[]){
+            EGL_SURFACE_TYPE, surface_type | EGL_SWAP_BEHAVIOR_PRESERVED_BIT,
+            EGL_RED_SIZE, 1,
+            EGL_GREEN_SIZE, 1,
+            EGL_BLUE_SIZE, 1,
+            EGL_ALPHA_SIZE, 0,
+            EGL_DEPTH_SIZE, 0,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_NONE
+         }
+      },
       {
          (const EGLint[]){
-            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+            EGL_SURFACE_TYPE, surface_type,
             EGL_RED_SIZE, 1,
             EGL_GREEN_SIZE, 1,
             EGL_BLUE_SIZE, 1,
@@ -282,7 +413,9 @@ create_context(struct wlc_backend_surface *bsurface)
       }
    };
 
-   for (uint32_t i = 0; i < LENGTH(configs); ++i) {
+   // With buffer age there is no need to pay for preserving the back buffer.
+   // Offscreen surfaces are single buffered and always keep their contents.
+   for (uint32_t i = (context->buffer_age || offscreen ? 1 : 0); i < LENGTH(configs); ++i) {
       EGLint n;
       if (egl.api.eglChooseConfig(context->display, configs[i].attribs, &context->config, 1, &n) && n > 0)
          break;
@@ -298,11 +431,34 @@ create_context(struct wlc_backend_surface *bsurface)
       EGL_NONE
    };
 
-   if ((context->context = egl.api.eglCreateContext(context->display, context->config, EGL_NO_CONTEXT, context_attribs)) == EGL_NO_CONTEXT)
-      goto egl_fail;
+   EGLContext share;
+   if ((share = share_context_ref(context->display, context->config, context_attribs)) != EGL_NO_CONTEXT) {
+      if ((context->context = egl.api.eglCreateContext(context->display, context->config, share, context_attribs)) != EGL_NO_CONTEXT) {
+         context->shared = true;
+      } else {
+         share_context_unref();
+      }
+   }
+
+   if (!context->shared) {
+      wlc_log(WLC_LOG_WARN, "Could not share EGL context, textures are uploaded separately for this output");
+
+      if ((context->context = egl.api.eglCreateContext(context->display, context->config, EGL_NO_CONTEXT, context_attribs)) == EGL_NO_CONTEXT)
+         goto egl_fail;
+   }
 
-   if ((context->surface = egl.api.eglCreateWindowSurface(context->display, context->config, bsurface->window, NULL)) == EGL_NO_SURFACE)
+   if (offscreen) {
+      const EGLint pbuffer_attribs[] = {
+         EGL_WIDTH, bsurface->offscreen.w,
+         EGL_HEIGHT, bsurface->offscreen.h,
+         EGL_NONE
+      };
+
+      if ((context->surface = egl.api.eglCreatePbufferSurface(context->display, context->config, pbuffer_attribs)) == EGL_NO_SURFACE)
+         goto egl_fail;
+   } else if ((context->surface = egl.api.eglCreateWindowSurface(context->display, context->config, bsurface->window, NULL)) == EGL_NO_SURFACE) {
       goto egl_fail;
+   }
 
    if (!egl.api.eglMakeCurrent(context->display, context->surface, context->surface, context->context))
       goto egl_fail;
@@ -321,12 +477,26 @@ create_context(struct wlc_backend_surface *bsurface)
       default: break;
    }
 
+   if (offscreen) {
+      context->preserved = true;
+      wlc_log(WLC_LOG_INFO, "EGL surface is offscreen pbuffer (%ux%u)", bsurface->offscreen.w, bsurface->offscreen.h);
+   } else if (context->buffer_age) {
+      wlc_log(WLC_LOG_INFO, "EGL surface reports buffer age");
+   } else {
+      EGLint surface_type;
+      if (egl.api.eglGetConfigAttrib(context->display, context->config, EGL_SURFACE_TYPE, &surface_type) && (surface_type & EGL_SWAP_BEHAVIOR_PRESERVED_BIT))
+         context->preserved = egl.api.eglSurfaceAttrib(context->display, context->surface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED);
+
+      if (context->preserved)
+         wlc_log(WLC_LOG_INFO, "EGL surface preserves back buffer on swap");
+   }
+
    const char *str;
-   str = EGL_CALL(egl.api.eglQueryString(context->display, EGL_VERSION));
+   EGL_CALL(str = egl.api.eglQueryString(context->display, EGL_VERSION));
    wlc_log(WLC_LOG_INFO, "EGL version: %s", str ? str : "(null)");
-   str = EGL_CALL(egl.api.eglQueryString(context->display, EGL_VENDOR));
+   EGL_CALL(str = egl.api.eglQueryString(context->display, EGL_VENDOR));
    wlc_log(WLC_LOG_INFO, "EGL vendor: %s", str ? str : "(null)");
-   str = EGL_CALL(egl.api.eglQueryString(context->display, EGL_CLIENT_APIS));
+   EGL_CALL(str = egl.api.eglQueryString(context->display, EGL_CLIENT_APIS));
    wlc_log(WLC_LOG_INFO, "EGL client APIs: %s", str ? str : "(null)");
 
    {
@@ -346,22 +516,32 @@ create_context(struct wlc_backend_surface *bsurface)
       }
    }
 
-   context->extensions = EGL_CALL(egl.api.eglQueryString(context->display, EGL_EXTENSIONS));
-
-   if (has_extension(context, "EGL_WL_bind_wayland_display") && has_extension(context, "EGL_KHR_image_base")) {
+   if (has_extension(context->extensions, "EGL_KHR_image_base")) {
       context->api.eglCreateImageKHR = egl.api.eglCreateImageKHR;
       context->api.eglDestroyImageKHR = egl.api.eglDestroyImageKHR;
-      context->api.eglBindWaylandDisplayWL = egl.api.eglBindWaylandDisplayWL;
-      context->api.eglUnbindWaylandDisplayWL = egl.api.eglUnbindWaylandDisplayWL;
-      context->api.eglQueryWaylandBufferWL = egl.api.eglQueryWaylandBufferWL;
+
+      if (has_extension(context->extensions, "EGL_WL_bind_wayland_display")) {
+         context->api.eglBindWaylandDisplayWL = egl.api.eglBindWaylandDisplayWL;
+         context->api.eglUnbindWaylandDisplayWL = egl.api.eglUnbindWaylandDisplayWL;
+         context->api.eglQueryWaylandBufferWL = egl.api.eglQueryWaylandBufferWL;
+      }
+
+      if ((context->dmabuf = has_extension(context->extensions, "EGL_EXT_image_dma_buf_import"))) {
+         if (has_extension(context->extensions, "EGL_EXT_image_dma_buf_import_modifiers")) {
+            context->api.eglQueryDmaBufFormatsEXT = egl.api.eglQueryDmaBufFormatsEXT;
+            context->api.eglQueryDmaBufModifiersEXT = egl.api.eglQueryDmaBufModifiersEXT;
+         } else {
+            wlc_log(WLC_LOG_INFO, "EGL_EXT_image_dma_buf_import_modifiers not supported, dmabufs use implicit modifiers");
+         }
+      }
    }
 
-   if (has_extension(context, "EGL_EXT_swap_buffers_with_damage")) {
-      // FIXME: get hw that supports this feature
-      context->api.eglSwapBuffersWithDamage = egl.api.eglSwapBuffersWithDamage;
+   if (has_extension(context->extensions, "EGL_KHR_swap_buffers_with_damage") && egl.api.eglSwapBuffersWithDamageKHR) {
+      context->api.eglSwapBuffersWithDamage = egl.api.eglSwapBuffersWithDamageKHR;
+   } else if (has_extension(context->extensions, "EGL_EXT_swap_buffers_with_damage") && egl.api.eglSwapBuffersWithDamageEXT) {
+      context->api.eglSwapBuffersWithDamage = egl.api.eglSwapBuffersWithDamageEXT;
    } else {
-      // FIXME: get hw that supports this feature
-      // wlc_log(WLC_LOG_WARN, "EGL_EXT_swap_buffers_with_damage not supported. Performance could be affected.");
+      wlc_log(WLC_LOG_INFO, "EGL_EXT_swap_buffers_with_damage not supported, swapping full buffers");
    }
 
    EGL_CALL(egl.api.eglSwapInterval(context->display, 1));
@@ -380,20 +560,27 @@ egl_fail:
 static bool
 bind(struct ctx *context)
 {
-   static struct ctx *bound = NULL;
    assert(context);
 
-   if (context == bound)
+   if (context == egl.bound)
       return true;
 
-   EGLBoolean made_current = EGL_CALL(egl.api.eglMakeCurrent(context->display, context->surface, context->surface, context->context));
+   EGLBoolean made_current;
+   EGL_CALL(made_current = egl.api.eglMakeCurrent(context->display, context->surface, context->surface, context->context));
    if (made_current != EGL_TRUE)
       return false;
 
-   bound = context;
+   egl.bound = context;
    return true;
 }
 
+static bool
+shares(struct ctx *context, struct ctx *other)
+{
+   assert(context && other);
+   return (context == other || (context->shared && other->shared && context->display == other->display));
+}
+
 static bool
 bind_to_wl_display(struct ctx *context, struct wl_display *wl_display)
 {
@@ -404,7 +591,8 @@ bind_to_wl_display(struct ctx *context, struct wl_display *wl_display)
       return false;
 
    if (context->api.eglBindWaylandDisplayWL) {
-      EGLBoolean binded = EGL_CALL(context->api.eglBindWaylandDisplayWL(context->display, wl_display));
+      EGLBoolean binded;
+      EGL_CALL(binded = context->api.eglBindWaylandDisplayWL(context->display, wl_display));
       if (binded == EGL_TRUE)
          context->wl_display = wl_display;
    }
@@ -412,8 +600,46 @@ bind_to_wl_display(struct ctx *context, struct wl_display *wl_display)
    return (context->wl_display ? true : false);
 }
 
+static EGLBoolean
+swap_with_damage(struct ctx *context, pixman_region32_t *damage)
+{
+   assert(context && damage);
+
+   // Failed swaps are reported by swap()
+
+   EGLint height;
+   if (!egl.api.eglQuerySurface(context->display, context->surface, EGL_HEIGHT, &height))
+      return egl.api.eglSwapBuffers(context->display, context->surface);
+
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(damage, &nrects);
+
+   // Nothing changed, but swap anyway so frame callbacks stay throttled
+   if (nrects <= 0) {
+      EGLint rect[4] = { 0, 0, 0, 0 };
+      return context->api.eglSwapBuffersWithDamage(context->display, context->surface, rect, 1);
+   }
+
+   EGLint *rects;
+   if (!(rects = chck_malloc_mul_of(nrects, 4 * sizeof(EGLint))))
+      return egl.api.eglSwapBuffers(context->display, context->surface);
+
+   // EGL wants rectangles with bottom-left origin
+   for (int i = 0; i < nrects; ++i) {
+      EGLint *r = &rects[i * 4];
+      r[0] = boxes[i].x1;
+      r[1] = height - boxes[i].y2;
+      r[2] = boxes[i].x2 - boxes[i].x1;
+      r[3] = boxes[i].y2 - boxes[i].y1;
+   }
+
+   EGLBoolean ret = context->api.eglSwapBuffersWithDamage(context->display, context->surface, rects, nrects);
+   free(rects);
+   return ret;
+}
+
 static void
-swap(struct ctx *context, struct wlc_backend_surface *bsurface)
+swap(struct ctx *context, struct wlc_backend_surface *bsurface, pixman_region32_t *damage)
 {
    assert(context);
 
@@ -424,13 +650,39 @@ swap(struct ctx *context, struct wlc_backend_surface *bsurface)
       abort();
    }
 
-   if (!context->flip_failed)
-      ret = EGL_CALL(egl.api.eglSwapBuffers(context->display, context->surface));
+   if (!context->flip_failed) {
+      if (damage && context->api.eglSwapBuffersWithDamage) {
+         ret = swap_with_damage(context, damage);
+      } else {
+         ret = egl.api.eglSwapBuffers(context->display, context->surface);
+      }
+   }
+
+   // Catch errors of the frame when they are not checked after every call
+   egl_call(__PRETTY_FUNCTION__, __LINE__, "swap");
 
    if (ret == EGL_TRUE && bsurface->api.page_flip)
       context->flip_failed = !bsurface->api.page_flip(bsurface);
 }
 
+static uint32_t
+buffer_age(struct ctx *context)
+{
+   assert(context);
+
+   if (context->preserved || !context->buffer_age)
+      return (context->preserved ? 1 : 0);
+
+   if (!bind(context))
+      return 0;
+
+   EGLint age;
+   if (!egl.api.eglQuerySurface(context->display, context->surface, EGL_BUFFER_AGE_EXT, &age) || age < 0)
+      return 0;
+
+   return age;
+}
+
 static void*
 get_proc_address(struct ctx *context, const char *procname)
 {
@@ -443,8 +695,9 @@ static EGLBoolean
 query_buffer(struct ctx *context, struct wl_resource *buffer, EGLint attribute, EGLint *value)
 {
    assert(context);
+   // Failing is an answer here, used to probe buffers and optional attributes
    if (context->api.eglQueryWaylandBufferWL)
-      return EGL_CALL(context->api.eglQueryWaylandBufferWL(context->display, buffer, attribute, value));
+      return context->api.eglQueryWaylandBufferWL(context->display, buffer, attribute, value);
    return EGL_FALSE;
 }
 
@@ -452,18 +705,61 @@ static EGLImageKHR
 create_image(struct ctx *context, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list)
 {
    assert(context);
-   if (context->api.eglCreateImageKHR)
-      return EGL_CALL(context->api.eglCreateImageKHR(context->display, context->context, target, buffer, attrib_list));
-   return NULL;
+   if (!context->api.eglCreateImageKHR)
+      return NULL;
+
+   // dmabuf images are not created from a client API resource, spec wants no context for them
+   EGLContext ctx = (target == EGL_LINUX_DMA_BUF_EXT ? EGL_NO_CONTEXT : context->context);
+   EGLImageKHR image;
+   EGL_CALL(image = context->api.eglCreateImageKHR(context->display, ctx, target, buffer, attrib_list));
+   return image;
 }
 
 static EGLBoolean
 destroy_image(struct ctx *context, EGLImageKHR image)
 {
    assert(context);
-   if (context->api.eglDestroyImageKHR)
-      return EGL_CALL(context->api.eglDestroyImageKHR(context->display, image));
-   return EGL_FALSE;
+   if (!context->api.eglDestroyImageKHR)
+      return EGL_FALSE;
+
+   EGLBoolean ret;
+   EGL_CALL(ret = context->api.eglDestroyImageKHR(context->display, image));
+   return ret;
+}
+
+static EGLBoolean
+query_dmabuf_formats(struct ctx *context, EGLint max, EGLint *formats, EGLint *num)
+{
+   assert(context && num);
+
+   if (!context->dmabuf)
+      return EGL_FALSE;
+
+   if (context->api.eglQueryDmaBufFormatsEXT)
+      return context->api.eglQueryDmaBufFormatsEXT(context->display, max, formats, num);
+
+   // Without the query every importer is expected to handle these
+   static const EGLint fallback[] = { DRM_FORMAT_ARGB8888, DRM_FORMAT_XRGB8888 };
+
+   if (max <= 0) {
+      *num = LENGTH(fallback);
+      return EGL_TRUE;
+   }
+
+   *num = (max < (EGLint)LENGTH(fallback) ? max : (EGLint)LENGTH(fallback));
+   memcpy(formats, fallback, *num * sizeof(EGLint));
+   return EGL_TRUE;
+}
+
+static EGLBoolean
+query_dmabuf_modifiers(struct ctx *context, EGLint format, EGLint max, EGLuint64KHR *modifiers, EGLint *num)
+{
+   assert(context && num);
+
+   if (!context->api.eglQueryDmaBufModifiersEXT)
+      return EGL_FALSE;
+
+   return context->api.eglQueryDmaBufModifiersEXT(context->display, format, max, modifiers, NULL, num);
 }
 
 static void
@@ -485,17 +781,23 @@ wlc_egl(struct wlc_backend_surface *bsurface, struct wlc_context_api *api)
       return NULL;
    }
 
+   egl.debug = wlc_dlog_enabled(WLC_DBG_GL);
+
    struct ctx *context;
    if (!(context = create_context(bsurface)))
       return NULL;
 
    api->terminate = terminate;
    api->bind = bind;
+   api->shares = shares;
    api->bind_to_wl_display = bind_to_wl_display;
    api->swap = swap;
+   api->buffer_age = buffer_age;
    api->get_proc_address = get_proc_address;
    api->destroy_image = destroy_image;
    api->create_image = create_image;
    api->query_buffer = query_buffer;
+   api->query_dmabuf_formats = query_dmabuf_formats;
+   api->query_dmabuf_modifiers = query_dmabuf_modifiers;
    return context;
 }
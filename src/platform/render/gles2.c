@@ -1,27 +1,51 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <dlfcn.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <drm_fourcc.h>
 #include <wayland-server.h>
 #include <chck/string/string.h>
+#include <chck/overflow/overflow.h>
 #include "internal.h"
 #include "gles2.h"
 #include "render.h"
 #include "platform/context/egl.h"
 #include "platform/context/context.h"
+#include "compositor/dmabuf.h"
+#include "compositor/output.h"
 #include "compositor/view.h"
+#include "compositor/seat/pointer.h"
 #include "xwayland/xwm.h"
 #include "resources/types/surface.h"
 #include "resources/types/xdg-surface.h"
 #include "resources/types/buffer.h"
 
+// GLES3 pixel pack buffers and fences, loaded when available
+#ifndef GL_PIXEL_PACK_BUFFER
+#  define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#  define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#  define GL_MAP_READ_BIT 0x0001
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#  define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#  define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#  define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+
 static GLfloat DIM = 0.5f;
 static bool DRAW_OPAQUE = false;
 
-static const GLubyte cursor_palette[];
-
 enum program_type {
    PROGRAM_RGB,
    PROGRAM_RGBA,
@@ -59,6 +83,30 @@ static const char *uniform_names[UNIFORM_LAST] = {
    "dim",
 };
 
+// Each quad is two triangles of interleaved x, y, u, v
+#define QUAD_VERTICES 6
+#define VERTEX_FLOATS 4
+
+// How many batches back a quad may be moved to join one with the same state
+#define MAX_BATCH_LOOKBACK 32
+
+// Draws sharing the state go in with a single glDrawArrays
+struct batch {
+   GLuint textures[3];
+   uint32_t *filters; // sampler state of the textures, surfaces can't be created or destroyed before flush
+   enum program_type program;
+   GLfloat dim;
+   bool filter;
+   bool opaque; // drawn with blending off
+   struct wlc_geometry bounds; // union of the quads, nothing overlapping may be moved past the batch
+   uint32_t quads, first, written;
+};
+
+struct quad {
+   uint32_t batch;
+   GLfloat vertices[QUAD_VERTICES * VERTEX_FLOATS];
+};
+
 struct ctx {
    const char *extensions;
 
@@ -68,13 +116,39 @@ struct ctx {
       GLuint obj;
       GLuint uniforms[UNIFORM_LAST];
       GLuint frames;
+      GLfloat dim, time; // last uploaded values
    } programs[PROGRAM_LAST];
 
    struct wlc_size resolution, mode;
 
    GLuint time;
 
+   bool blend; // current GL_BLEND state, toggled on flush only when batches need it
+
    GLuint textures[TEXTURE_LAST];
+   uint32_t filters[TEXTURE_LAST];
+
+   // Draws queued since the last state change, sent in on flush()
+   struct {
+      struct chck_iter_pool batches, quads;
+      GLfloat *vertices;
+      size_t capacity; // quads vertices and vbo have room for
+      GLuint vbo;
+   } draw;
+
+   // Asynchronous read backs through pixel pack buffers (GLES3)
+   struct {
+      struct readback {
+         GLuint pbo;
+         void *fence; // GLsync
+         size_t size; // storage of pbo
+         size_t pending; // bytes of the read back in flight
+      } slots[WLC_READBACK_SLOT_LAST];
+      bool supported;
+   } readback;
+
+   // Buffers whose cache holds images and textures of this renderer
+   struct chck_iter_pool buffers;
 
    struct {
       PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
@@ -86,6 +160,7 @@ struct paint {
    GLfloat dim;
    enum program_type program;
    bool filter;
+   bool opaque;
 };
 
 static struct {
@@ -95,9 +170,11 @@ static struct {
       GLenum (*glGetError)(void);
       const GLubyte* (*glGetString)(GLenum);
       void (*glEnable)(GLenum);
+      void (*glDisable)(GLenum);
       void (*glClear)(GLbitfield);
       void (*glClearColor)(GLfloat, GLfloat, GLfloat, GLfloat);
       void (*glViewport)(GLint, GLint, GLsizei, GLsizei);
+      void (*glScissor)(GLint, GLint, GLsizei, GLsizei);
       void (*glBlendFunc)(GLenum, GLenum);
       GLuint (*glCreateShader)(GLenum);
       void (*glShaderSource)(GLuint, GLsizei count, const GLchar **string, const GLint *length);
@@ -120,6 +197,11 @@ static struct {
       void (*glEnableVertexAttribArray)(GLuint);
       void (*glVertexAttribPointer)(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid*);
       void (*glDrawArrays)(GLenum, GLint, GLsizei);
+      void (*glGenBuffers)(GLsizei, GLuint*);
+      void (*glDeleteBuffers)(GLsizei, const GLuint*);
+      void (*glBindBuffer)(GLenum, GLuint);
+      void (*glBufferData)(GLenum, GLsizeiptr, const GLvoid*, GLenum);
+      void (*glBufferSubData)(GLenum, GLintptr, GLsizeiptr, const GLvoid*);
       void (*glGenTextures)(GLsizei, GLuint*);
       void (*glDeleteTextures)(GLsizei, GLuint*);
       void (*glBindTexture)(GLenum, GLuint);
@@ -127,8 +209,18 @@ static struct {
       void (*glTexParameteri)(GLenum, GLenum, GLenum);
       void (*glPixelStorei)(GLenum, GLint);
       void (*glTexImage2D)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid*);
+      void (*glTexSubImage2D)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const GLvoid*);
       void (*glReadPixels)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, GLvoid*);
+
+      // GLES3, optional
+      void* (*glMapBufferRange)(GLenum, GLintptr, GLsizeiptr, GLbitfield);
+      GLboolean (*glUnmapBuffer)(GLenum);
+      void* (*glFenceSync)(GLenum, GLbitfield);
+      GLenum (*glClientWaitSync)(void*, GLbitfield, uint64_t);
+      void (*glDeleteSync)(void*);
    } api;
+
+   bool debug; // WLC_DEBUG=gl, check errors after every call
 } gl;
 
 static bool
@@ -149,12 +241,16 @@ gles2_load(void)
       goto function_pointer_exception;
    if (!load(glEnable))
       goto function_pointer_exception;
+   if (!load(glDisable))
+      goto function_pointer_exception;
    if (!load(glClear))
       goto function_pointer_exception;
    if (!load(glClearColor))
       goto function_pointer_exception;
    if (!load(glViewport))
       goto function_pointer_exception;
+   if (!load(glScissor))
+      goto function_pointer_exception;
    if (!load(glBlendFunc))
       goto function_pointer_exception;
    if (!(load(glCreateShader)))
@@ -199,6 +295,16 @@ gles2_load(void)
       goto function_pointer_exception;
    if (!(load(glDrawArrays)))
       goto function_pointer_exception;
+   if (!(load(glGenBuffers)))
+      goto function_pointer_exception;
+   if (!(load(glDeleteBuffers)))
+      goto function_pointer_exception;
+   if (!(load(glBindBuffer)))
+      goto function_pointer_exception;
+   if (!(load(glBufferData)))
+      goto function_pointer_exception;
+   if (!(load(glBufferSubData)))
+      goto function_pointer_exception;
    if (!(load(glGenTextures)))
       goto function_pointer_exception;
    if (!(load(glDeleteTextures)))
@@ -213,9 +319,18 @@ gles2_load(void)
       goto function_pointer_exception;
    if (!(load(glTexImage2D)))
       goto function_pointer_exception;
+   if (!(load(glTexSubImage2D)))
+      goto function_pointer_exception;
    if (!(load(glReadPixels)))
       goto function_pointer_exception;
 
+   // Only needed for asynchronous read back, which falls back to glReadPixels
+   load(glMapBufferRange);
+   load(glUnmapBuffer);
+   load(glFenceSync);
+   load(glClientWaitSync);
+   load(glDeleteSync);
+
 #undef load
 
    return true;
@@ -257,7 +372,12 @@ gl_call(const char *func, uint32_t line, const char *glfunc)
 #  define __STRING(x) #x
 #endif
 
-#define GL_CALL(x) x; gl_call(__PRETTY_FUNCTION__, __LINE__, __STRING(x))
+#ifdef WLC_GL_CALL_CHECKS
+#  define GL_CALL(x) do { x; gl_call(__PRETTY_FUNCTION__, __LINE__, __STRING(x)); } while (0)
+#else
+// glGetError may stall the pipeline, errors are checked once per frame in flush_frame()
+#  define GL_CALL(x) do { x; if (gl.debug) gl_call(__PRETTY_FUNCTION__, __LINE__, __STRING(x)); } while (0)
+#endif
 
 WLC_PURE static bool
 has_extension(const struct ctx *context, const char *extension)
@@ -293,6 +413,200 @@ set_program(struct ctx *context, enum program_type type)
    GL_CALL(gl.api.glUseProgram(context->program->obj));
 }
 
+static bool
+intersects(const struct wlc_geometry *a, const struct wlc_geometry *b)
+{
+   assert(a && b);
+   return (a->origin.x < b->origin.x + (int32_t)b->size.w && b->origin.x < a->origin.x + (int32_t)a->size.w &&
+           a->origin.y < b->origin.y + (int32_t)b->size.h && b->origin.y < a->origin.y + (int32_t)a->size.h);
+}
+
+static bool
+same_state(const struct batch *a, const struct batch *b)
+{
+   assert(a && b);
+   return (a->program == b->program && a->dim == b->dim && a->filter == b->filter && a->opaque == b->opaque && !memcmp(a->textures, b->textures, sizeof(a->textures)));
+}
+
+static bool
+reserve_vertices(struct ctx *context, size_t quads)
+{
+   assert(context);
+
+   if (quads <= context->draw.capacity)
+      return true;
+
+   const size_t capacity = (quads > context->draw.capacity * 2 ? quads : context->draw.capacity * 2);
+
+   GLfloat *vertices;
+   if (!(vertices = chck_realloc_mul_of(context->draw.vertices, capacity, QUAD_VERTICES * VERTEX_FLOATS * sizeof(GLfloat))))
+      return false;
+
+   context->draw.vertices = vertices;
+   context->draw.capacity = capacity;
+   return true;
+}
+
+static void
+flush(struct ctx *context)
+{
+   assert(context);
+
+   const size_t nquads = context->draw.quads.items.count;
+   if (!nquads)
+      return;
+
+   if (!reserve_vertices(context, nquads)) {
+      wlc_log(WLC_LOG_ERROR, "gles2: could not allocate vertices for %zu quads", nquads);
+      goto out;
+   }
+
+   // Lay out the vertices batch after batch, so each batch is a single range
+   uint32_t first = 0;
+   struct batch *b;
+   chck_iter_pool_for_each(&context->draw.batches, b) {
+      b->first = b->written = first;
+      first += b->quads * QUAD_VERTICES;
+   }
+
+   struct quad *q;
+   chck_iter_pool_for_each(&context->draw.quads, q) {
+      b = chck_iter_pool_get(&context->draw.batches, q->batch);
+      memcpy(context->draw.vertices + b->written * VERTEX_FLOATS, q->vertices, sizeof(q->vertices));
+      b->written += QUAD_VERTICES;
+   }
+
+   // Orphan the old storage, so the driver doesn't wait for draws still reading it
+   GL_CALL(gl.api.glBufferData(GL_ARRAY_BUFFER, context->draw.capacity * QUAD_VERTICES * VERTEX_FLOATS * sizeof(GLfloat), NULL, GL_STREAM_DRAW));
+   GL_CALL(gl.api.glBufferSubData(GL_ARRAY_BUFFER, 0, first * VERTEX_FLOATS * sizeof(GLfloat), context->draw.vertices));
+
+   chck_iter_pool_for_each(&context->draw.batches, b) {
+      if (!b->quads)
+         continue;
+
+      set_program(context, b->program);
+
+      if (b->opaque == context->blend) {
+         if (b->opaque) {
+            GL_CALL(gl.api.glDisable(GL_BLEND));
+         } else {
+            GL_CALL(gl.api.glEnable(GL_BLEND));
+         }
+         context->blend = !b->opaque;
+      }
+
+      if (b->dim > 0.0f && b->dim != context->program->dim) {
+         GL_CALL(gl.api.glUniform1fv(context->program->uniforms[UNIFORM_DIM], 1, &b->dim));
+         context->program->dim = b->dim;
+      }
+
+      if (context->program->frames > 0) {
+         const GLfloat frame = ((context->time / 16) % context->program->frames);
+         GLfloat time = frame / context->program->frames;
+         if (time != context->program->time) {
+            GL_CALL(gl.api.glUniform1fv(context->program->uniforms[UNIFORM_TIME], 1, &time));
+            context->program->time = time;
+         }
+      }
+
+      for (GLuint i = 0; i < LENGTH(b->textures) && b->textures[i]; ++i) {
+         GL_CALL(gl.api.glActiveTexture(GL_TEXTURE0 + i));
+         GL_CALL(gl.api.glBindTexture(GL_TEXTURE_2D, b->textures[i]));
+
+         // Filter changes only with the scaling of the surface or output
+         const GLenum filter = (b->filter ? GL_LINEAR : GL_NEAREST);
+         if (b->filters[i] != filter) {
+            GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter));
+            GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter));
+            b->filters[i] = filter;
+         }
+      }
+
+      GL_CALL(gl.api.glDrawArrays(GL_TRIANGLES, b->first, b->quads * QUAD_VERTICES));
+   }
+
+   wlc_dlog(WLC_DBG_RENDER, "-> Drew %zu quads in %zu batches", nquads, context->draw.batches.items.count);
+
+out:
+   chck_iter_pool_flush(&context->draw.batches);
+   chck_iter_pool_flush(&context->draw.quads);
+}
+
+static void
+texture_paint(struct ctx *context, GLuint *textures, uint32_t *filters, GLuint nmemb, const struct wlc_geometry *geometry, const struct wlc_geometry *clip, struct paint *settings)
+{
+   assert(context && geometry && settings);
+   assert(!nmemb || (textures && filters));
+
+   // Clip here instead of scissoring, so quads of different clip rectangles can share a draw
+   int32_t x1 = geometry->origin.x, y1 = geometry->origin.y;
+   int32_t x2 = x1 + (int32_t)geometry->size.w, y2 = y1 + (int32_t)geometry->size.h;
+
+   if (clip) {
+      x1 = chck_max32(x1, clip->origin.x);
+      y1 = chck_max32(y1, clip->origin.y);
+      x2 = chck_min32(x2, clip->origin.x + (int32_t)clip->size.w);
+      y2 = chck_min32(y2, clip->origin.y + (int32_t)clip->size.h);
+   }
+
+   if (x1 >= x2 || y1 >= y2)
+      return;
+
+   const GLfloat u1 = (GLfloat)(x1 - geometry->origin.x) / geometry->size.w, u2 = (GLfloat)(x2 - geometry->origin.x) / geometry->size.w;
+   const GLfloat v1 = (GLfloat)(y1 - geometry->origin.y) / geometry->size.h, v2 = (GLfloat)(y2 - geometry->origin.y) / geometry->size.h;
+
+   struct batch key;
+   memset(&key, 0, sizeof(key));
+   key.program = settings->program;
+   key.dim = settings->dim;
+   key.filter = (settings->filter || !wlc_size_equals(&context->resolution, &context->mode));
+   key.opaque = settings->opaque;
+   key.filters = filters;
+   key.bounds = (struct wlc_geometry){ { x1, y1 }, { x2 - x1, y2 - y1 } };
+
+   for (GLuint i = 0; i < nmemb && i < LENGTH(key.textures) && textures[i]; ++i)
+      key.textures[i] = textures[i];
+
+   // Join the latest batch with the same state, unless a batch in between overlaps the quad and would end up under it
+   struct batch *batch = NULL;
+   size_t index = context->draw.batches.items.count;
+   for (size_t i = index, n = 0; i > 0 && n < MAX_BATCH_LOOKBACK; --i, ++n) {
+      struct batch *b = chck_iter_pool_get(&context->draw.batches, i - 1);
+
+      if (same_state(b, &key)) {
+         batch = b;
+         index = i - 1;
+         break;
+      }
+
+      if (intersects(&b->bounds, &key.bounds))
+         break;
+   }
+
+   if (!batch && !(batch = chck_iter_pool_push_back(&context->draw.batches, &key)))
+      return;
+
+   struct quad q = { index, {
+      x1, y1, u1, v1,
+      x2, y1, u2, v1,
+      x1, y2, u1, v2,
+      x2, y1, u2, v1,
+      x2, y2, u2, v2,
+      x1, y2, u1, v2,
+   } };
+
+   if (!chck_iter_pool_push_back(&context->draw.quads, &q))
+      return;
+
+   if (batch->quads++ > 0) {
+      struct wlc_origin o1, o2;
+      const struct wlc_origin b2 = { batch->bounds.origin.x + batch->bounds.size.w, batch->bounds.origin.y + batch->bounds.size.h };
+      wlc_origin_min(&batch->bounds.origin, &key.bounds.origin, &o1);
+      wlc_origin_max(&b2, &(struct wlc_origin){ x2, y2 }, &o2);
+      batch->bounds = (struct wlc_geometry){ o1, { o2.x - o1.x, o2.y - o1.y } };
+   }
+}
+
 static GLuint
 create_shader(const char *source, GLenum shader_type)
 {
@@ -472,13 +786,30 @@ create_context(void)
    if (!(context = calloc(1, sizeof(struct ctx))))
       return NULL;
 
+   if (!chck_iter_pool(&context->draw.batches, 32, 0, sizeof(struct batch)) ||
+       !chck_iter_pool(&context->draw.quads, 64, 0, sizeof(struct quad)) ||
+       !chck_iter_pool(&context->buffers, 8, 0, sizeof(wlc_resource))) {
+      chck_iter_pool_release(&context->draw.batches);
+      chck_iter_pool_release(&context->draw.quads);
+      free(context);
+      return NULL;
+   }
+
    const char *str;
-   str = (const char*)GL_CALL(gl.api.glGetString(GL_VERSION));
+   GL_CALL(str = (const char*)gl.api.glGetString(GL_VERSION));
    wlc_log(WLC_LOG_INFO, "GL version: %s", str ? str : "(null)");
-   str = (const char*)GL_CALL(gl.api.glGetString(GL_VENDOR));
+
+   // Context is requested as GLES2, but drivers usually give the newest compatible version
+   int major = 0;
+   if (str && sscanf(str, "OpenGL ES %d", &major) == 1 && major >= 3)
+      context->readback.supported = (gl.api.glMapBufferRange && gl.api.glUnmapBuffer && gl.api.glFenceSync && gl.api.glClientWaitSync && gl.api.glDeleteSync);
+
+   if (!context->readback.supported)
+      wlc_log(WLC_LOG_INFO, "gles2: pixel pack buffers not available, reading pixels synchronously");
+   GL_CALL(str = (const char*)gl.api.glGetString(GL_VENDOR));
    wlc_log(WLC_LOG_INFO, "GL vendor: %s", str ? str : "(null)");
 
-   context->extensions = (const char*)GL_CALL(gl.api.glGetString(GL_EXTENSIONS));
+   GL_CALL(context->extensions = (const char*)gl.api.glGetString(GL_EXTENSIONS));
 
    if (!has_extension(context, "GL_OES_EGL_image_external")) {
       wlc_log(WLC_LOG_WARN, "gles2: GL_OES_EGL_image_external not available");
@@ -524,7 +855,7 @@ create_context(void)
       GL_CALL(gl.api.glBindAttribLocation(context->programs[i].obj, 1, "uv"));
 
       for (int u = 0; u < UNIFORM_LAST; ++u) {
-         context->programs[i].uniforms[u] = GL_CALL(gl.api.glGetUniformLocation(context->programs[i].obj, uniform_names[u]));
+         GL_CALL(context->programs[i].uniforms[u] = gl.api.glGetUniformLocation(context->programs[i].obj, uniform_names[u]));
       }
 
       GL_CALL(gl.api.glUniform1i(context->programs[i].uniforms[UNIFORM_TEXTURE0], 0));
@@ -539,7 +870,7 @@ create_context(void)
       const void *data;
    } images[TEXTURE_LAST] = {
       { GL_LUMINANCE, 1, 1, GL_UNSIGNED_BYTE, (GLubyte[]){ 0 } }, // TEXTURE_BLACK
-      { GL_LUMINANCE, 14, 14, GL_UNSIGNED_BYTE, cursor_palette }, // TEXTURE_CURSOR
+      { GL_LUMINANCE, WLC_POINTER_PALETTE_SIZE, WLC_POINTER_PALETTE_SIZE, GL_UNSIGNED_BYTE, wlc_pointer_cursor_palette }, // TEXTURE_CURSOR
    };
 
    GL_CALL(gl.api.glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
@@ -552,10 +883,16 @@ create_context(void)
       GL_CALL(gl.api.glTexImage2D(GL_TEXTURE_2D, 0, images[i].format, images[i].w, images[i].h, 0, images[i].format, images[i].type, images[i].data));
    }
 
+   // Nothing else binds array buffers, so the vbo stays bound and the attribute pointers stay valid
+   GL_CALL(gl.api.glGenBuffers(1, &context->draw.vbo));
+   GL_CALL(gl.api.glBindBuffer(GL_ARRAY_BUFFER, context->draw.vbo));
+   GL_CALL(gl.api.glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (GLvoid*)0));
+   GL_CALL(gl.api.glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat))));
    GL_CALL(gl.api.glEnableVertexAttribArray(0));
    GL_CALL(gl.api.glEnableVertexAttribArray(1));
 
    GL_CALL(gl.api.glEnable(GL_BLEND));
+   context->blend = true;
    GL_CALL(gl.api.glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
    GL_CALL(gl.api.glClearColor(0.0, 0.0, 0.0, 1));
 
@@ -567,6 +904,7 @@ static void
 resolution(struct ctx *context, const struct wlc_size *mode, const struct wlc_size *resolution)
 {
    assert(context && resolution);
+   flush(context);
 
    if (!wlc_size_equals(&context->resolution, resolution)) {
       for (GLuint i = 0; i < PROGRAM_LAST; ++i) {
@@ -584,26 +922,88 @@ resolution(struct ctx *context, const struct wlc_size *mode, const struct wlc_si
    }
 }
 
+// Contents of a buffer, shared by every surface that shows the buffer
+struct buffer_cache {
+   EGLImageKHR images[3];
+   GLuint textures[3];
+   uint32_t filters[3];
+   enum wlc_surface_format format;
+   uint32_t references; // surfaces borrowing the textures and images
+   bool orphaned; // buffer forgot the cache, freed with the last reference
+};
+
+static void
+buffer_cache_free(struct wlc_context *bound, struct buffer_cache *cache)
+{
+   assert(bound && cache);
+
+   for (GLuint i = 0; i < 3; ++i) {
+      if (cache->textures[i]) {
+         GL_CALL(gl.api.glDeleteTextures(1, &cache->textures[i]));
+      }
+
+      if (cache->images[i])
+         wlc_context_destroy_image(bound, cache->images[i]);
+   }
+
+   free(cache);
+}
+
 static void
-surface_gen_textures(struct wlc_surface *surface, const GLuint num_textures)
+surface_return_cache(struct wlc_context *bound, struct wlc_surface *surface)
+{
+   assert(bound && surface);
+
+   struct buffer_cache *cache;
+   if (!(cache = surface->cache))
+      return;
+
+   assert(cache->references > 0);
+   if (--cache->references == 0 && cache->orphaned)
+      buffer_cache_free(bound, cache);
+
+   memset(surface->textures, 0, sizeof(surface->textures));
+   memset(surface->images, 0, sizeof(surface->images));
+   memset(surface->filters, 0, sizeof(surface->filters));
+   surface->cache = NULL;
+}
+
+static uint32_t*
+surface_get_filters(struct wlc_surface *surface)
 {
    assert(surface);
 
+   // Sampler state belongs to the textures, which borrowing surfaces share
+   struct buffer_cache *cache;
+   return ((cache = surface->cache) ? cache->filters : surface->filters);
+}
+
+static void
+surface_gen_textures(struct wlc_context *bound, struct wlc_surface *surface, const GLuint num_textures)
+{
+   assert(bound && surface);
+
+   // Borrowed textures hold contents of a buffer, they must not be respecified
+   surface_return_cache(bound, surface);
+
    for (GLuint i = 0; i < num_textures; ++i) {
       if (surface->textures[i])
          continue;
 
       GL_CALL(gl.api.glGenTextures(1, &surface->textures[i]));
       GL_CALL(gl.api.glBindTexture(GL_TEXTURE_2D, surface->textures[i]));
+      surface->filters[i] = 0;
       GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
       GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
    }
 }
 
 static void
-surface_flush_textures(struct wlc_surface *surface)
+surface_flush_textures(struct wlc_context *bound, struct wlc_surface *surface)
 {
-   assert(surface);
+   assert(bound && surface);
+
+   surface_return_cache(bound, surface);
 
    for (GLuint i = 0; i < 3; ++i) {
       if (surface->textures[i]) {
@@ -612,6 +1012,8 @@ surface_flush_textures(struct wlc_surface *surface)
    }
 
    memset(surface->textures, 0, sizeof(surface->textures));
+   memset(surface->filters, 0, sizeof(surface->filters));
+   memset(&surface->storage, 0, sizeof(surface->storage));
 }
 
 static void
@@ -619,6 +1021,8 @@ surface_flush_images(struct wlc_context *context, struct wlc_surface *surface)
 {
    assert(surface);
 
+   surface_return_cache(context, surface);
+
    for (GLuint i = 0; i < 3; ++i) {
       if (surface->images[i])
          wlc_context_destroy_image(context, surface->images[i]);
@@ -630,68 +1034,232 @@ surface_flush_images(struct wlc_context *context, struct wlc_surface *surface)
 static void
 surface_destroy(struct ctx *context, struct wlc_context *bound, struct wlc_surface *surface)
 {
-   (void)context;
    assert(context && bound && surface);
-   surface_flush_textures(surface);
+   flush(context);
+   surface_flush_textures(bound, surface);
    surface_flush_images(bound, surface);
    wlc_dlog(WLC_DBG_RENDER, "-> Destroyed surface");
 }
 
 static bool
-shm_attach(struct wlc_surface *surface, struct wlc_buffer *buffer, struct wl_shm_buffer *shm_buffer)
+buffer_cache_borrow(struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer)
 {
-   assert(surface && buffer && shm_buffer);
+   assert(bound && surface && buffer);
 
-   buffer->shm_buffer = shm_buffer;
-   buffer->size.w = wl_shm_buffer_get_width(shm_buffer);
-   buffer->size.h = wl_shm_buffer_get_height(shm_buffer);
+   // Cache of another output is usable only when its context shares objects with ours
+   struct buffer_cache *cache;
+   struct wlc_output *output;
+   if (!(cache = buffer->cache.entry) || !(output = convert_from_wlc_handle(buffer->cache.output, WLC_TYPE_OUTPUT)) ||
+       (buffer->cache.output != surface->output && !wlc_context_shares(&output->context, bound)))
+      return false;
+
+   // Referenced before the old contents go, they may be from this same cache
+   cache->references++;
+   surface_flush_textures(bound, surface);
+   surface_flush_images(bound, surface);
+   memcpy(surface->textures, cache->textures, sizeof(surface->textures));
+   memcpy(surface->images, cache->images, sizeof(surface->images));
+   surface->format = cache->format;
+   surface->cache = cache;
+   return true;
+}
+
+static void
+buffer_cache_store(struct ctx *context, struct wlc_surface *surface, struct wlc_buffer *buffer)
+{
+   assert(context && surface && buffer);
 
-   GLint pitch;
+   // Already cached by a renderer we don't share with, surface keeps its own copies
+   if (buffer->cache.entry || !surface->output)
+      return;
+
+   struct buffer_cache *cache;
+   if (!(cache = calloc(1, sizeof(struct buffer_cache))))
+      return;
+
+   wlc_resource r = convert_to_wlc_resource(buffer);
+   if (!chck_iter_pool_push_back(&context->buffers, &r)) {
+      free(cache);
+      return;
+   }
+
+   memcpy(cache->textures, surface->textures, sizeof(cache->textures));
+   memcpy(cache->images, surface->images, sizeof(cache->images));
+   memcpy(cache->filters, surface->filters, sizeof(cache->filters));
+   cache->format = surface->format;
+   cache->references = 1;
+   buffer->cache.entry = cache;
+   buffer->cache.output = surface->output;
+   surface->cache = cache;
+}
+
+static void
+buffer_cache_destroy(struct wlc_context *bound, struct wlc_buffer *buffer)
+{
+   assert(bound && buffer);
+
+   // Surfaces still showing the contents keep them until they attach something else
+   struct buffer_cache *cache;
+   if ((cache = buffer->cache.entry)) {
+      if (cache->references > 0) {
+         cache->orphaned = true;
+      } else {
+         buffer_cache_free(bound, cache);
+      }
+   }
+
+   memset(&buffer->cache, 0, sizeof(buffer->cache));
+}
+
+static void
+buffer_destroy(struct ctx *context, struct wlc_context *bound, struct wlc_buffer *buffer)
+{
+   assert(context && bound && buffer);
+
+   // Queued draws may sample the textures
+   flush(context);
+   buffer_cache_destroy(bound, buffer);
+
+   const wlc_resource r = convert_to_wlc_resource(buffer);
+   for (size_t i = 0; i < context->buffers.items.count; ++i) {
+      if (*(wlc_resource*)chck_iter_pool_get(&context->buffers, i) != r)
+         continue;
+
+      chck_iter_pool_remove(&context->buffers, i);
+      break;
+   }
+
+   wlc_dlog(WLC_DBG_RENDER, "-> Destroyed buffer (%" PRIuWLC ") cache", r);
+}
+
+// Texture of a shm buffer, uploaded as a format the existing programs can sample
+struct shm_plane {
    GLenum gl_format, gl_pixel_type;
-   switch (wl_shm_buffer_get_format(shm_buffer)) {
-      case WL_SHM_FORMAT_XRGB8888:
-         pitch = wl_shm_buffer_get_stride(shm_buffer) / 4;
-         gl_format = GL_BGRA_EXT;
-         gl_pixel_type = GL_UNSIGNED_BYTE;
-         surface->format = SURFACE_RGB;
-         break;
-      case WL_SHM_FORMAT_ARGB8888:
-         pitch = wl_shm_buffer_get_stride(shm_buffer) / 4;
-         gl_format = GL_BGRA_EXT;
-         gl_pixel_type = GL_UNSIGNED_BYTE;
-         surface->format = SURFACE_RGBA;
-         break;
-      case WL_SHM_FORMAT_RGB565:
-         pitch = wl_shm_buffer_get_stride(shm_buffer) / 2;
-         gl_format = GL_RGB;
-         gl_pixel_type = GL_UNSIGNED_SHORT_5_6_5;
-         surface->format = SURFACE_RGB;
-         break;
-      default:
-         /* unknown shm buffer format */
-         return false;
+   uint32_t bpp; // bytes per texel
+   uint32_t hsub, vsub; // subsampling
+};
+
+// Every texture samples the same memory, wl_shm validates only stride * height of it
+static const struct shm_layout {
+   uint32_t format;
+   enum wlc_surface_format surface;
+   GLuint num_planes;
+   struct shm_plane planes[2];
+} shm_layouts[] = {
+   { WL_SHM_FORMAT_XRGB8888, SURFACE_RGB, 1, { { GL_BGRA_EXT, GL_UNSIGNED_BYTE, 4, 1, 1 } } },
+   { WL_SHM_FORMAT_ARGB8888, SURFACE_RGBA, 1, { { GL_BGRA_EXT, GL_UNSIGNED_BYTE, 4, 1, 1 } } },
+   { WL_SHM_FORMAT_RGB565, SURFACE_RGB, 1, { { GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2, 1, 1 } } },
+   // Y from pixel pairs and UV from the half width texels
+   { WL_SHM_FORMAT_YUYV, SURFACE_Y_XUXV, 2, { { GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, 2, 1, 1 }, { GL_BGRA_EXT, GL_UNSIGNED_BYTE, 4, 2, 1 } } },
+};
+
+static int
+shm_upload_damage(struct wlc_buffer *buffer, pixman_region32_t *damage, const struct shm_plane *plane, const void *data)
+{
+   assert(buffer && damage && plane);
+
+   // Past this many rectangles it is cheaper to upload the bounding box
+   const int max_rects = 8;
+
+   pixman_region32_t region;
+   pixman_region32_init(&region);
+   pixman_region32_intersect_rect(&region, damage, 0, 0, buffer->size.w, buffer->size.h);
+
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(&region, &nrects);
+   if (nrects > max_rects) {
+      boxes = pixman_region32_extents(&region);
+      nrects = 1;
+   }
+
+   for (int i = 0; i < nrects; ++i) {
+      // Subsampled texels cover several pixels, round outwards
+      const int32_t x1 = boxes[i].x1 / plane->hsub, y1 = boxes[i].y1 / plane->vsub;
+      const int32_t x2 = (boxes[i].x2 + plane->hsub - 1) / plane->hsub, y2 = (boxes[i].y2 + plane->vsub - 1) / plane->vsub;
+      GL_CALL(gl.api.glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, x1));
+      GL_CALL(gl.api.glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, y1));
+      GL_CALL(gl.api.glTexSubImage2D(GL_TEXTURE_2D, 0, x1, y1, x2 - x1, y2 - y1, plane->gl_format, plane->gl_pixel_type, data));
+   }
+
+   pixman_region32_fini(&region);
+   return nrects;
+}
+
+static bool
+shm_attach(struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer, struct wl_shm_buffer *shm_buffer, pixman_region32_t *damage)
+{
+   assert(bound && surface && buffer && shm_buffer);
+
+   const uint32_t shm_format = wl_shm_buffer_get_format(shm_buffer);
+
+   const struct shm_layout *layout = NULL;
+   for (uint32_t i = 0; i < LENGTH(shm_layouts) && !layout; ++i) {
+      if (shm_layouts[i].format == shm_format)
+         layout = &shm_layouts[i];
    }
 
+   if (!layout) {
+      /* unknown shm buffer format */
+      return false;
+   }
+
+   buffer->shm_buffer = shm_buffer;
+   buffer->size.w = wl_shm_buffer_get_width(shm_buffer);
+   buffer->size.h = wl_shm_buffer_get_height(shm_buffer);
+   surface->format = layout->surface;
+
    struct wlc_view *view;
-   if ((view = convert_from_wlc_handle(surface->view, "view")) && view->x11.id)
+   if (layout->num_planes == 1 && (view = convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW)) && view->x11.id)
       surface->format = wlc_x11_window_get_surface_format(&view->x11);
 
-   surface_gen_textures(surface, 1);
-   GL_CALL(gl.api.glBindTexture(GL_TEXTURE_2D, surface->textures[0]));
-   GL_CALL(gl.api.glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, pitch));
-   GL_CALL(gl.api.glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0));
-   GL_CALL(gl.api.glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0));
+   const uint32_t stride = wl_shm_buffer_get_stride(shm_buffer);
+   const GLint pitch = stride / layout->planes[0].bpp;
+
+   // Texture already holds the previous contents, only damaged pixels need to be uploaded
+   const bool reuse = (damage && surface->storage.size.w == (uint32_t)pitch && surface->storage.size.h == buffer->size.h && surface->storage.format == shm_format);
+
+   surface_gen_textures(bound, surface, layout->num_planes);
+
    wl_shm_buffer_begin_access(buffer->shm_buffer);
-   void *data = wl_shm_buffer_get_data(buffer->shm_buffer);
-   GL_CALL(gl.api.glTexImage2D(GL_TEXTURE_2D, 0, gl_format, pitch, buffer->size.h, 0, gl_format, gl_pixel_type, data));
+   uint8_t *data = wl_shm_buffer_get_data(buffer->shm_buffer);
+
+   int nrects = 0;
+   for (GLuint i = 0; i < layout->num_planes; ++i) {
+      const struct shm_plane *plane = &layout->planes[i];
+      const GLint plane_pitch = stride / (layout->planes[0].bpp * plane->hsub);
+      const GLint plane_height = (buffer->size.h + plane->vsub - 1) / plane->vsub;
+
+      GL_CALL(gl.api.glBindTexture(GL_TEXTURE_2D, surface->textures[i]));
+      GL_CALL(gl.api.glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, plane_pitch));
+
+      // Rows are as far apart as the client put them, alignment is the largest that pitch allows
+      const GLint row = plane_pitch * plane->bpp;
+      GL_CALL(gl.api.glPixelStorei(GL_UNPACK_ALIGNMENT, (row % 8 ? (row % 4 ? (row % 2 ? 1 : 2) : 4) : 8)));
+
+      if (reuse) {
+         nrects += shm_upload_damage(buffer, damage, plane, data);
+      } else {
+         GL_CALL(gl.api.glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0));
+         GL_CALL(gl.api.glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0));
+         GL_CALL(gl.api.glTexImage2D(GL_TEXTURE_2D, 0, plane->gl_format, plane_pitch, plane_height, 0, plane->gl_format, plane->gl_pixel_type, data));
+      }
+   }
+
+   if (reuse) {
+      wlc_dlog(WLC_DBG_RENDER, "-> Uploaded %d damage rectangles", nrects);
+   } else {
+      surface->storage.size = (struct wlc_size){ pitch, buffer->size.h };
+      surface->storage.format = shm_format;
+   }
+
    wl_shm_buffer_end_access(buffer->shm_buffer);
    return true;
 }
 
 static bool
-egl_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *surface, struct wlc_buffer *buffer, EGLint format)
+load_image_target(struct ctx *context, struct wlc_context *ectx)
 {
-   assert(context && surface && buffer);
+   assert(context && ectx);
 
    if (!context->api.glEGLImageTargetTexture2DOES) {
       if (!has_extension(context, "GL_OES_EGL_image_external") ||
@@ -702,7 +1270,22 @@ egl_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *su
       assert(context->api.glEGLImageTargetTexture2DOES);
    }
 
-   buffer->legacy_buffer = convert_to_wl_resource(buffer, "buffer");
+   return true;
+}
+
+static bool
+egl_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *surface, struct wlc_buffer *buffer, EGLint format)
+{
+   assert(context && surface && buffer);
+
+   if (!load_image_target(context, ectx))
+      return false;
+
+   // Same buffer attached again, size and orientation are known from the first time
+   if (buffer_cache_borrow(ectx, surface, buffer))
+      return true;
+
+   buffer->legacy_buffer = convert_to_wl_resource(buffer, WLC_TYPE_BUFFER);
    wlc_context_query_buffer(ectx, buffer->legacy_buffer, EGL_WIDTH, (EGLint*)&buffer->size.w);
    wlc_context_query_buffer(ectx, buffer->legacy_buffer, EGL_HEIGHT, (EGLint*)&buffer->size.h);
    wlc_context_query_buffer(ectx, buffer->legacy_buffer, EGL_WAYLAND_Y_INVERTED_WL, (EGLint*)&buffer->y_inverted);
@@ -736,7 +1319,7 @@ egl_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *su
    }
 
    struct wlc_view *view;
-   if ((view = convert_from_wlc_handle(surface->view, "view")) && view->x11.id)
+   if ((view = convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW)) && view->x11.id)
       surface->format = wlc_x11_window_get_surface_format(&view->x11);
 
    if (num_planes > 3) {
@@ -745,7 +1328,10 @@ egl_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *su
    }
 
    surface_flush_images(ectx, surface);
-   surface_gen_textures(surface, num_planes);
+   surface_gen_textures(ectx, surface, num_planes);
+
+   // Textures are backed by images now, next SHM attach must respecify them
+   memset(&surface->storage, 0, sizeof(surface->storage));
 
    for (GLuint i = 0; i < num_planes; ++i) {
       EGLint attribs[] = { EGL_WAYLAND_PLANE_WL, i, EGL_NONE };
@@ -757,16 +1343,174 @@ egl_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *su
       GL_CALL(context->api.glEGLImageTargetTexture2DOES(target, surface->images[i]));
    }
 
+   buffer_cache_store(context, surface, buffer);
+   return true;
+}
+
+// Image of a dmabuf plane as a texture the existing programs can sample
+struct dmabuf_plane {
+   uint32_t format; // DRM_FORMAT code the plane is imported as
+   uint32_t plane; // plane of the buffer
+   uint32_t hsub, vsub; // subsampling
+};
+
+static const struct dmabuf_layout {
+   uint32_t format;
+   enum wlc_surface_format surface;
+   GLuint num_planes;
+   struct dmabuf_plane planes[3];
+} dmabuf_layouts[] = {
+   { DRM_FORMAT_ARGB8888, SURFACE_RGBA, 1, { { DRM_FORMAT_ARGB8888, 0, 1, 1 } } },
+   { DRM_FORMAT_ABGR8888, SURFACE_RGBA, 1, { { DRM_FORMAT_ABGR8888, 0, 1, 1 } } },
+   { DRM_FORMAT_XRGB8888, SURFACE_RGB, 1, { { DRM_FORMAT_XRGB8888, 0, 1, 1 } } },
+   { DRM_FORMAT_XBGR8888, SURFACE_RGB, 1, { { DRM_FORMAT_XBGR8888, 0, 1, 1 } } },
+   { DRM_FORMAT_RGB565, SURFACE_RGB, 1, { { DRM_FORMAT_RGB565, 0, 1, 1 } } },
+   // YUV planes are sampled separately and converted in the shader
+   { DRM_FORMAT_NV12, SURFACE_Y_UV, 2, { { DRM_FORMAT_R8, 0, 1, 1 }, { DRM_FORMAT_GR88, 1, 2, 2 } } },
+   { DRM_FORMAT_YUV420, SURFACE_Y_U_V, 3, { { DRM_FORMAT_R8, 0, 1, 1 }, { DRM_FORMAT_R8, 1, 2, 2 }, { DRM_FORMAT_R8, 2, 2, 2 } } },
+   { DRM_FORMAT_YUYV, SURFACE_Y_XUXV, 2, { { DRM_FORMAT_GR88, 0, 1, 1 }, { DRM_FORMAT_ARGB8888, 0, 2, 1 } } },
+};
+
+static EGLImageKHR
+dmabuf_import_plane(struct wlc_context *ectx, const struct wlc_dmabuf_attributes *attributes, const struct dmabuf_plane *plane)
+{
+   assert(ectx && attributes && plane);
+
+   static const EGLint names[WLC_DMABUF_MAX_PLANES][5] = {
+      { EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT, EGL_DMA_BUF_PLANE0_PITCH_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT },
+      { EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT, EGL_DMA_BUF_PLANE1_PITCH_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT },
+      { EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT, EGL_DMA_BUF_PLANE2_PITCH_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT },
+      { EGL_DMA_BUF_PLANE3_FD_EXT, EGL_DMA_BUF_PLANE3_OFFSET_EXT, EGL_DMA_BUF_PLANE3_PITCH_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT },
+   };
+
+   if (plane->plane >= attributes->planes)
+      return NULL;
+
+   // Buffer imported as is keeps all its planes (auxiliary planes of modifiers), split planes are imported alone
+   const bool whole = (plane->format == attributes->format);
+   const uint32_t first = (whole ? 0 : plane->plane), last = (whole ? attributes->planes : plane->plane + 1);
+
+   EGLint attribs[6 + WLC_DMABUF_MAX_PLANES * 10 + 1];
+   uint32_t n = 0;
+   attribs[n++] = EGL_WIDTH;
+   attribs[n++] = attributes->width / plane->hsub;
+   attribs[n++] = EGL_HEIGHT;
+   attribs[n++] = attributes->height / plane->vsub;
+   attribs[n++] = EGL_LINUX_DRM_FOURCC_EXT;
+   attribs[n++] = plane->format;
+
+   for (uint32_t i = first; i < last; ++i) {
+      const EGLint *name = names[i - first];
+      attribs[n++] = name[0];
+      attribs[n++] = attributes->fd[i];
+      attribs[n++] = name[1];
+      attribs[n++] = attributes->offset[i];
+      attribs[n++] = name[2];
+      attribs[n++] = attributes->stride[i];
+
+      // Implicit layout is left for the driver to figure out
+      if (attributes->modifier[i] == WLC_DMABUF_MOD_INVALID)
+         continue;
+
+      attribs[n++] = name[3];
+      attribs[n++] = attributes->modifier[i] & 0xffffffff;
+      attribs[n++] = name[4];
+      attribs[n++] = attributes->modifier[i] >> 32;
+   }
+
+   attribs[n++] = EGL_NONE;
+   assert(n <= LENGTH(attribs));
+   return wlc_context_create_image(ectx, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+}
+
+static const struct dmabuf_layout*
+dmabuf_get_layout(uint32_t format)
+{
+   for (uint32_t i = 0; i < LENGTH(dmabuf_layouts); ++i) {
+      if (dmabuf_layouts[i].format == format)
+         return &dmabuf_layouts[i];
+   }
+
+   return NULL;
+}
+
+static bool
+dmabuf_importable(struct ctx *context, struct wlc_context *bound, const struct wlc_dmabuf_attributes *attributes)
+{
+   assert(context && bound && attributes);
+
+   const struct dmabuf_layout *layout;
+   if (!load_image_target(context, bound) || !(layout = dmabuf_get_layout(attributes->format)))
+      return false;
+
+   // Planes are imported the same way dmabuf_attach does, images are thrown away right after
+   for (GLuint i = 0; i < layout->num_planes; ++i) {
+      EGLImageKHR image;
+      if (!(image = dmabuf_import_plane(bound, attributes, &layout->planes[i])))
+         return false;
+
+      wlc_context_destroy_image(bound, image);
+   }
+
+   return true;
+}
+
+static bool
+dmabuf_attach(struct ctx *context, struct wlc_context *ectx, struct wlc_surface *surface, struct wlc_buffer *buffer, const struct wlc_dmabuf_attributes *attributes)
+{
+   assert(context && ectx && surface && buffer && attributes);
+
+   if (!load_image_target(context, ectx))
+      return false;
+
+   if (buffer_cache_borrow(ectx, surface, buffer))
+      return true;
+
+   const struct dmabuf_layout *layout;
+   if (!(layout = dmabuf_get_layout(attributes->format))) {
+      wlc_log(WLC_LOG_WARN, "Unsupported dmabuf format 0x%x", attributes->format);
+      return false;
+   }
+
+   buffer->size = (struct wlc_size){ attributes->width, attributes->height };
+   buffer->y_inverted = !(attributes->flags & WLC_DMABUF_Y_INVERT);
+   surface->format = layout->surface;
+
+   struct wlc_view *view;
+   if ((view = convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW)) && view->x11.id)
+      surface->format = wlc_x11_window_get_surface_format(&view->x11);
+
+   surface_flush_images(ectx, surface);
+   surface_gen_textures(ectx, surface, layout->num_planes);
+
+   // Textures are backed by images now, next SHM attach must respecify them
+   memset(&surface->storage, 0, sizeof(surface->storage));
+
+   for (GLuint i = 0; i < layout->num_planes; ++i) {
+      if (!(surface->images[i] = dmabuf_import_plane(ectx, attributes, &layout->planes[i]))) {
+         wlc_log(WLC_LOG_WARN, "Failed to import plane %u of dmabuf", i);
+         return false;
+      }
+
+      GL_CALL(gl.api.glActiveTexture(GL_TEXTURE0 + i));
+      GL_CALL(gl.api.glBindTexture(GL_TEXTURE_2D, surface->textures[i]));
+      GL_CALL(context->api.glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, surface->images[i]));
+   }
+
+   buffer_cache_store(context, surface, buffer);
    return true;
 }
 
 static bool
-surface_attach(struct ctx *context, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer)
+surface_attach(struct ctx *context, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage)
 {
    assert(context && bound && surface);
 
+   // Queued draws may sample the textures that get respecified here
+   flush(context);
+
    struct wl_resource *wl_buffer;
-   if (!buffer || !(wl_buffer = convert_to_wl_resource(buffer, "buffer"))) {
+   if (!buffer || !(wl_buffer = convert_to_wl_resource(buffer, WLC_TYPE_BUFFER))) {
       surface_destroy(context, bound, surface);
       return true;
    }
@@ -774,9 +1518,12 @@ surface_attach(struct ctx *context, struct wlc_context *bound, struct wlc_surfac
    EGLint format;
    bool attached = false;
 
+   const struct wlc_dmabuf_attributes *attributes;
    struct wl_shm_buffer *shm_buffer = wl_shm_buffer_get(wl_buffer);
    if (shm_buffer) {
-      attached = shm_attach(surface, buffer, shm_buffer);
+      attached = shm_attach(bound, surface, buffer, shm_buffer, damage);
+   } else if ((attributes = wlc_dmabuf_get_attributes(wl_buffer))) {
+      attached = dmabuf_attach(context, bound, surface, buffer, attributes);
    } else if (wlc_context_query_buffer(bound, (void*)wl_buffer, EGL_TEXTURE_FORMAT, &format)) {
       attached = egl_attach(context, bound, surface, buffer, format);
    } else {
@@ -790,58 +1537,54 @@ surface_attach(struct ctx *context, struct wlc_context *bound, struct wlc_surfac
    return attached;
 }
 
+static bool
+program_is_opaque(enum program_type program)
+{
+   return (program == PROGRAM_RGB || program == PROGRAM_Y_UV || program == PROGRAM_Y_U_V || program == PROGRAM_Y_XUXV);
+}
+
 static void
-texture_paint(struct ctx *context, GLuint *textures, GLuint nmemb, const struct wlc_geometry *geometry, struct paint *settings)
+surface_get_opaque(struct wlc_surface *surface, const struct wlc_geometry *geometry, pixman_region32_t *out_opaque)
 {
-   const GLfloat vertices[8] = {
-      geometry->origin.x + geometry->size.w, geometry->origin.y,
-      geometry->origin.x, geometry->origin.y,
-      geometry->origin.x + geometry->size.w, geometry->origin.y + geometry->size.h,
-      geometry->origin.x, geometry->origin.y + geometry->size.h,
-   };
+   assert(surface && geometry && out_opaque);
 
-   const GLfloat coords[8] = {
-      1, 0,
-      0, 0,
-      1, 1,
-      0, 1
-   };
+   // Every rectangle is a quad of its own, past this many blending everything is cheaper
+   const int max_rects = 16;
 
-   set_program(context, settings->program);
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(&surface->commit.opaque, &nrects);
+   if (!surface->size.w || !surface->size.h || nrects > max_rects)
+      return;
 
-   if (settings->dim > 0.0f) {
-      GL_CALL(gl.api.glUniform1fv(context->program->uniforms[UNIFORM_DIM], 1, &settings->dim));
-   }
+   for (int i = 0; i < nrects; ++i) {
+      // Surface is scaled to the geometry, round inwards so no translucent pixel ends up unblended
+      const int64_t sw = surface->size.w, sh = surface->size.h, gw = geometry->size.w, gh = geometry->size.h;
+      const int32_t x1 = geometry->origin.x + (boxes[i].x1 * gw + sw - 1) / sw, x2 = geometry->origin.x + boxes[i].x2 * gw / sw;
+      const int32_t y1 = geometry->origin.y + (boxes[i].y1 * gh + sh - 1) / sh, y2 = geometry->origin.y + boxes[i].y2 * gh / sh;
 
-   if (context->program->frames > 0) {
-      const GLfloat frame = ((context->time / 16) % context->program->frames);
-      GLfloat time = frame / context->program->frames;
-      GL_CALL(gl.api.glUniform1fv(context->program->uniforms[UNIFORM_TIME], 1, &time));
+      if (x1 < x2 && y1 < y2)
+         pixman_region32_union_rect(out_opaque, out_opaque, x1, y1, x2 - x1, y2 - y1);
    }
+}
 
-   for (GLuint i = 0; i < nmemb; ++i) {
-      if (!textures[i])
-         break;
+static void
+surface_paint_region(struct ctx *context, struct wlc_surface *surface, const struct wlc_geometry *geometry, const struct wlc_geometry *clip, struct paint *settings, pixman_region32_t *region)
+{
+   assert(context && surface && geometry && settings && region);
 
-      GL_CALL(gl.api.glActiveTexture(GL_TEXTURE0 + i));
-      GL_CALL(gl.api.glBindTexture(GL_TEXTURE_2D, textures[i]));
+   if (clip)
+      pixman_region32_intersect_rect(region, region, clip->origin.x, clip->origin.y, clip->size.w, clip->size.h);
 
-      if (settings->filter || !wlc_size_equals(&context->resolution, &context->mode)) {
-         GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-         GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-      } else {
-         GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
-         GL_CALL(gl.api.glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
-      }
+   int nrects;
+   const pixman_box32_t *boxes = pixman_region32_rectangles(region, &nrects);
+   for (int i = 0; i < nrects; ++i) {
+      const struct wlc_geometry c = { { boxes[i].x1, boxes[i].y1 }, { boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1 } };
+      texture_paint(context, surface->textures, surface_get_filters(surface), 3, geometry, &c, settings);
    }
-
-   GL_CALL(gl.api.glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices));
-   GL_CALL(gl.api.glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords));
-   GL_CALL(gl.api.glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
 }
 
 static void
-surface_paint_internal(struct ctx *context, struct wlc_surface *surface, const struct wlc_geometry *geometry, struct paint *settings)
+surface_paint_internal(struct ctx *context, struct wlc_surface *surface, const struct wlc_geometry *geometry, const struct wlc_geometry *clip, struct paint *settings)
 {
    assert(context && surface && geometry && settings);
 
@@ -854,12 +1597,72 @@ surface_paint_internal(struct ctx *context, struct wlc_surface *surface, const s
          // black borders are requested
          struct paint settings2 = *settings;
          settings2.program = (settings2.program == PROGRAM_RGBA || settings2.program == PROGRAM_RGB ? settings2.program : PROGRAM_RGB);
-         texture_paint(context, &context->textures[TEXTURE_BLACK], 1, geometry, &settings2);
+         settings2.opaque = program_is_opaque(settings2.program);
+         texture_paint(context, &context->textures[TEXTURE_BLACK], &context->filters[TEXTURE_BLACK], 1, geometry, clip, &settings2);
          g = &settings->visible;
       }
    }
 
-   texture_paint(context, surface->textures, 3, g, settings);
+   if (program_is_opaque(settings->program)) {
+      settings->opaque = true;
+      texture_paint(context, surface->textures, surface_get_filters(surface), 3, g, clip, settings);
+      return;
+   }
+
+   // Only the translucent remainder of the surface needs blending
+   pixman_region32_t opaque;
+   pixman_region32_init(&opaque);
+   surface_get_opaque(surface, g, &opaque);
+
+   if (!pixman_region32_not_empty(&opaque)) {
+      pixman_region32_fini(&opaque);
+      settings->opaque = false;
+      texture_paint(context, surface->textures, surface_get_filters(surface), 3, g, clip, settings);
+      return;
+   }
+
+   pixman_region32_t translucent;
+   pixman_region32_init_rect(&translucent, g->origin.x, g->origin.y, g->size.w, g->size.h);
+   pixman_region32_subtract(&translucent, &translucent, &opaque);
+
+   settings->opaque = true;
+   surface_paint_region(context, surface, g, clip, settings, &opaque);
+   settings->opaque = false;
+   surface_paint_region(context, surface, g, clip, settings, &translucent);
+
+   pixman_region32_fini(&translucent);
+   pixman_region32_fini(&opaque);
+}
+
+static void
+tree_paint(struct ctx *context, struct wlc_surface *surface, const struct wlc_geometry *geometry, const struct wlc_geometry *clip, const struct paint *settings)
+{
+   assert(context && surface && geometry && settings);
+
+   if (!surface->tree.current.items.count) {
+      struct paint s = *settings;
+      surface_paint_internal(context, surface, geometry, clip, &s);
+      return;
+   }
+
+   // Sub-surfaces and the surface itself (0), from bottom to top
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->tree.current, r) {
+      struct paint s = *settings;
+      if (!*r) {
+         surface_paint_internal(context, surface, geometry, clip, &s);
+         continue;
+      }
+
+      struct wlc_surface *child;
+      if (!(child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) || !child->commit.attached)
+         continue;
+
+      s.program = (enum program_type)child->format;
+      wlc_surface_get_subsurface_geometry(surface, child, &settings->visible, &s.visible);
+      const struct wlc_geometry g = s.visible;
+      tree_paint(context, child, &g, clip, &s);
+   }
 }
 
 static void
@@ -870,16 +1673,16 @@ surface_paint(struct ctx *context, struct wlc_surface *surface, const struct wlc
    settings.dim = 1.0f;
    settings.program = (enum program_type)surface->format;
    settings.visible = *geometry;
-   surface_paint_internal(context, surface, geometry, &settings);
+   surface_paint_internal(context, surface, geometry, NULL, &settings);
 }
 
 static void
-view_paint(struct ctx *context, struct wlc_view *view)
+view_paint(struct ctx *context, struct wlc_view *view, const struct wlc_origin *offset, const struct wlc_geometry *clip)
 {
    assert(context && view);
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return;
 
    struct paint settings;
@@ -889,14 +1692,23 @@ view_paint(struct ctx *context, struct wlc_view *view)
 
    struct wlc_geometry geometry;
    wlc_view_get_bounds(view, &geometry, &settings.visible);
-   surface_paint_internal(context, surface, &geometry, &settings);
+
+   // View belongs to another output of the layout
+   const struct wlc_origin o = (offset ? *offset : wlc_origin_zero);
+   geometry.origin.x += o.x, geometry.origin.y += o.y;
+   settings.visible.origin.x += o.x, settings.visible.origin.y += o.y;
+
+   tree_paint(context, surface, &geometry, clip, &settings);
 
    if (DRAW_OPAQUE) {
       wlc_view_get_opaque(view, &geometry);
+      geometry.origin.x += o.x, geometry.origin.y += o.y;
       settings.visible = geometry;
       settings.program = PROGRAM_CURSOR;
+      flush(context);
       GL_CALL(gl.api.glBlendFunc(GL_ONE, GL_DST_COLOR));
-      texture_paint(context, &context->textures[TEXTURE_BLACK], 1, &geometry, &settings);
+      texture_paint(context, &context->textures[TEXTURE_BLACK], &context->filters[TEXTURE_BLACK], 1, &geometry, clip, &settings);
+      flush(context);
       GL_CALL(gl.api.glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
    }
 }
@@ -908,16 +1720,110 @@ pointer_paint(struct ctx *context, const struct wlc_origin *pos)
    struct paint settings;
    memset(&settings, 0, sizeof(settings));
    settings.program = PROGRAM_CURSOR;
-   struct wlc_geometry g = { *pos, { 14, 14 } };
-   texture_paint(context, &context->textures[TEXTURE_CURSOR], 1, &g, &settings);
+   struct wlc_geometry g = { *pos, { WLC_POINTER_PALETTE_SIZE, WLC_POINTER_PALETTE_SIZE } };
+   texture_paint(context, &context->textures[TEXTURE_CURSOR], &context->filters[TEXTURE_CURSOR], 1, &g, NULL, &settings);
+}
+
+WLC_PURE static bool
+in_framebuffer(const struct ctx *context, const struct wlc_geometry *geometry)
+{
+   assert(context && geometry);
+   return (geometry->origin.x >= 0 && geometry->origin.y >= 0 &&
+           geometry->origin.x + geometry->size.w <= context->mode.w && geometry->origin.y + geometry->size.h <= context->mode.h);
 }
 
 static void
 read_pixels(struct ctx *context, struct wlc_geometry *geometry, void *out_data)
 {
-   (void)context;
-   assert(context && geometry && out_data);
-   GL_CALL(gl.api.glReadPixels(geometry->origin.x, geometry->origin.y, geometry->size.w, geometry->size.h, GL_RGBA, GL_UNSIGNED_BYTE, out_data));
+   assert(context && geometry && out_data && in_framebuffer(context, geometry));
+   flush(context);
+
+   // Geometry is in mode space with origin at top left, framebuffer at bottom left
+   GL_CALL(gl.api.glReadPixels(geometry->origin.x, context->mode.h - (geometry->origin.y + (int32_t)geometry->size.h), geometry->size.w, geometry->size.h, GL_RGBA, GL_UNSIGNED_BYTE, out_data));
+}
+
+static bool
+read_pixels_queue(struct ctx *context, enum wlc_readback_slot slot, struct wlc_geometry *geometry)
+{
+   assert(context && geometry && slot < WLC_READBACK_SLOT_LAST && in_framebuffer(context, geometry));
+
+   size_t size;
+   if (!context->readback.supported || chck_mul_ofsz(geometry->size.w, geometry->size.h, &size) || chck_mul_ofsz(size, 4, &size))
+      return false;
+
+   flush(context);
+   struct readback *r = &context->readback.slots[slot];
+
+   // Read back that was never fetched is dropped
+   if (r->fence) {
+      GL_CALL(gl.api.glDeleteSync(r->fence));
+      r->fence = NULL;
+   }
+
+   if (!r->pbo) {
+      GL_CALL(gl.api.glGenBuffers(1, &r->pbo));
+   }
+
+   GL_CALL(gl.api.glBindBuffer(GL_PIXEL_PACK_BUFFER, r->pbo));
+
+   if (r->size < size) {
+      GL_CALL(gl.api.glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ));
+      r->size = size;
+   }
+
+   // With a pack buffer bound glReadPixels only queues the copy, the fence tells when it is done
+   GL_CALL(gl.api.glReadPixels(geometry->origin.x, context->mode.h - (geometry->origin.y + (int32_t)geometry->size.h), geometry->size.w, geometry->size.h, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)0));
+   GL_CALL(gl.api.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+   GL_CALL(r->fence = gl.api.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+   r->pending = size;
+   return true;
+}
+
+static enum wlc_render_readback
+read_pixels_fetch(struct ctx *context, enum wlc_readback_slot slot, void *out_data, bool wait)
+{
+   assert(context && out_data && slot < WLC_READBACK_SLOT_LAST);
+   struct readback *r = &context->readback.slots[slot];
+
+   if (!r->pending)
+      return WLC_READBACK_FAILED;
+
+   if (r->fence) {
+      GLenum status;
+      GL_CALL(status = gl.api.glClientWaitSync(r->fence, GL_SYNC_FLUSH_COMMANDS_BIT, (wait ? UINT64_MAX : 0)));
+
+      if (status == GL_TIMEOUT_EXPIRED)
+         return WLC_READBACK_PENDING;
+
+      GL_CALL(gl.api.glDeleteSync(r->fence));
+      r->fence = NULL;
+   }
+
+   GL_CALL(gl.api.glBindBuffer(GL_PIXEL_PACK_BUFFER, r->pbo));
+
+   void *data;
+   GL_CALL(data = gl.api.glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, r->pending, GL_MAP_READ_BIT));
+
+   if (data) {
+      memcpy(out_data, data, r->pending);
+      GL_CALL(gl.api.glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+   }
+
+   GL_CALL(gl.api.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+   r->pending = 0;
+   return (data ? WLC_READBACK_DONE : WLC_READBACK_FAILED);
+}
+
+static void
+flush_frame(struct ctx *context)
+{
+   assert(context);
+   flush(context);
+
+   // Catch errors of the frame when they are not checked after every call
+   GLenum error;
+   while ((error = gl.api.glGetError()) != GL_NO_ERROR)
+      wlc_log(WLC_LOG_ERROR, "gles2: %s during frame, set WLC_DEBUG=gl to find the call", gl_error_string(error));
 }
 
 static void
@@ -934,22 +1840,69 @@ background(struct ctx *context)
    struct paint settings;
    memset(&settings, 0, sizeof(settings));
    settings.program = PROGRAM_BG;
+   settings.opaque = true;
    struct wlc_geometry g = { { 0, 0 }, context->resolution };
-   texture_paint(context, NULL, 0, &g, &settings);
+   texture_paint(context, NULL, NULL, 0, &g, NULL, &settings);
 }
 
 static void
 clear(struct ctx *context)
 {
-   (void)context;
    assert(context);
+   flush(context);
    GL_CALL(gl.api.glClear(GL_COLOR_BUFFER_BIT));
 }
 
 static void
-terminate(struct ctx *context)
+scissor(struct ctx *context, const struct wlc_geometry *geometry)
 {
    assert(context);
+   flush(context);
+
+   if (!geometry || context->resolution.w == 0 || context->resolution.h == 0) {
+      GL_CALL(gl.api.glDisable(GL_SCISSOR_TEST));
+      return;
+   }
+
+   // Geometry is in resolution space, scissor box in mode space with origin at bottom left
+   const int64_t x1 = (int64_t)geometry->origin.x * context->mode.w / context->resolution.w;
+   const int64_t y1 = (int64_t)geometry->origin.y * context->mode.h / context->resolution.h;
+   const int64_t x2 = ((int64_t)(geometry->origin.x + geometry->size.w) * context->mode.w + context->resolution.w - 1) / context->resolution.w;
+   const int64_t y2 = ((int64_t)(geometry->origin.y + geometry->size.h) * context->mode.h + context->resolution.h - 1) / context->resolution.h;
+
+   GL_CALL(gl.api.glEnable(GL_SCISSOR_TEST));
+   GL_CALL(gl.api.glScissor(x1, context->mode.h - y2, x2 - x1, y2 - y1));
+}
+
+static void
+terminate(struct ctx *context, struct wlc_context *bound)
+{
+   assert(context && bound);
+
+   // Buffers outlive the renderer, they forget what was cached here
+   wlc_resource *r;
+   chck_iter_pool_for_each(&context->buffers, r) {
+      struct wlc_buffer *buffer;
+      if ((buffer = convert_from_wlc_resource(*r, WLC_TYPE_BUFFER)))
+         buffer_cache_destroy(bound, buffer);
+   }
+
+   chck_iter_pool_release(&context->buffers);
+   GL_CALL(gl.api.glDeleteBuffers(1, &context->draw.vbo));
+
+   for (uint32_t i = 0; i < WLC_READBACK_SLOT_LAST; ++i) {
+      if (context->readback.slots[i].fence) {
+         GL_CALL(gl.api.glDeleteSync(context->readback.slots[i].fence));
+      }
+
+      if (context->readback.slots[i].pbo) {
+         GL_CALL(gl.api.glDeleteBuffers(1, &context->readback.slots[i].pbo));
+      }
+   }
+
+   chck_iter_pool_release(&context->draw.batches);
+   chck_iter_pool_release(&context->draw.quads);
+   free(context->draw.vertices);
 
    for (GLuint i = 0; i < PROGRAM_LAST; ++i) {
       GL_CALL(gl.api.glDeleteProgram(context->programs[i].obj));
@@ -978,6 +1931,8 @@ wlc_gles2(struct wlc_render_api *api)
       return NULL;
    }
 
+   gl.debug = wlc_dlog_enabled(WLC_DBG_GL);
+
    struct ctx *ctx;
    if (!(ctx = create_context()))
       return NULL;
@@ -986,12 +1941,18 @@ wlc_gles2(struct wlc_render_api *api)
    api->resolution = resolution;
    api->surface_destroy = surface_destroy;
    api->surface_attach = surface_attach;
+   api->buffer_destroy = buffer_destroy;
+   api->dmabuf_importable = dmabuf_importable;
    api->view_paint = view_paint;
    api->surface_paint = surface_paint;
    api->pointer_paint = pointer_paint;
    api->read_pixels = read_pixels;
+   api->read_pixels_queue = read_pixels_queue;
+   api->read_pixels_fetch = read_pixels_fetch;
    api->background = background;
    api->clear = clear;
+   api->scissor = scissor;
+   api->flush = flush_frame;
    api->time = frame_time;
 
    chck_cstr_to_f(getenv("WLC_DIM"), &DIM);
@@ -1000,21 +1961,3 @@ wlc_gles2(struct wlc_render_api *api)
    wlc_log(WLC_LOG_INFO, "GLES2 renderer initialized");
    return ctx;
 }
-
-// 0 == black, 1 == white, 2 == transparent
-static const GLubyte cursor_palette[] = {
-   0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02,
-   0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
-   0x01, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02,
-   0x01, 0x00, 0x01, 0x02, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02,
-   0x01, 0x01, 0x02, 0x02, 0x02, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0x02,
-   0x01, 0x01, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, 0x00, 0x01, 0x02, 0x02, 0x02, 0x02,
-   0x01, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, 0x02, 0x02, 0x02, 0x02, 0x02
-};
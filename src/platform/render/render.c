@@ -28,25 +28,47 @@ wlc_render_surface_destroy(struct wlc_render *render, struct wlc_context *bound,
 }
 
 bool
-wlc_render_surface_attach(struct wlc_render *render, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer)
+wlc_render_surface_attach(struct wlc_render *render, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage)
 {
    assert(render && bound && surface);
 
    if (!render->api.surface_attach || !wlc_context_bind(bound))
       return false;
 
-   return render->api.surface_attach(render->render, bound, surface, buffer);
+   return render->api.surface_attach(render->render, bound, surface, buffer, damage);
 }
 
 void
-wlc_render_view_paint(struct wlc_render *render, struct wlc_context *bound, struct wlc_view *view)
+wlc_render_buffer_destroy(struct wlc_render *render, struct wlc_context *bound, struct wlc_buffer *buffer)
+{
+   assert(render && bound && buffer);
+
+   if (!render->api.buffer_destroy || !wlc_context_bind(bound))
+      return;
+
+   render->api.buffer_destroy(render->render, bound, buffer);
+}
+
+bool
+wlc_render_dmabuf_importable(struct wlc_render *render, struct wlc_context *bound, const struct wlc_dmabuf_attributes *attributes)
+{
+   assert(render && bound && attributes);
+
+   if (!render->api.dmabuf_importable || !wlc_context_bind(bound))
+      return false;
+
+   return render->api.dmabuf_importable(render->render, bound, attributes);
+}
+
+void
+wlc_render_view_paint(struct wlc_render *render, struct wlc_context *bound, struct wlc_view *view, const struct wlc_origin *offset, const struct wlc_geometry *clip)
 {
    assert(render && view);
 
    if (!render->api.view_paint || !wlc_context_bind(bound))
       return;
 
-   render->api.view_paint(render->render, view);
+   render->api.view_paint(render->render, view, offset, clip);
 }
 
 void
@@ -82,6 +104,28 @@ wlc_render_read_pixels(struct wlc_render *render, struct wlc_context *bound, str
    render->api.read_pixels(render->render, geometry, out_data);
 }
 
+bool
+wlc_render_read_pixels_queue(struct wlc_render *render, struct wlc_context *bound, enum wlc_readback_slot slot, struct wlc_geometry *geometry)
+{
+   assert(render);
+
+   if (!render->api.read_pixels_queue || !wlc_context_bind(bound))
+      return false;
+
+   return render->api.read_pixels_queue(render->render, slot, geometry);
+}
+
+enum wlc_render_readback
+wlc_render_read_pixels_fetch(struct wlc_render *render, struct wlc_context *bound, enum wlc_readback_slot slot, void *out_data, bool wait)
+{
+   assert(render);
+
+   if (!render->api.read_pixels_fetch || !wlc_context_bind(bound))
+      return WLC_READBACK_FAILED;
+
+   return render->api.read_pixels_fetch(render->render, slot, out_data, wait);
+}
+
 void
 wlc_render_background(struct wlc_render *render, struct wlc_context *bound)
 {
@@ -104,6 +148,17 @@ wlc_render_clear(struct wlc_render *render, struct wlc_context *bound)
    render->api.clear(render->render);
 }
 
+void
+wlc_render_scissor(struct wlc_render *render, struct wlc_context *bound, const struct wlc_geometry *geometry)
+{
+   assert(render);
+
+   if (!render->api.scissor || !wlc_context_bind(bound))
+      return;
+
+   render->api.scissor(render->render, geometry);
+}
+
 void
 wlc_render_time(struct wlc_render *render, struct wlc_context *bound, uint32_t time)
 {
@@ -115,6 +170,17 @@ wlc_render_time(struct wlc_render *render, struct wlc_context *bound, uint32_t t
    render->api.time(render->render, time);
 }
 
+void
+wlc_render_flush(struct wlc_render *render, struct wlc_context *bound)
+{
+   assert(render);
+
+   if (!render->api.flush || !wlc_context_bind(bound))
+      return;
+
+   render->api.flush(render->render);
+}
+
 void
 wlc_render_release(struct wlc_render *render, struct wlc_context *bound)
 {
@@ -124,7 +190,7 @@ wlc_render_release(struct wlc_render *render, struct wlc_context *bound)
       if (!wlc_context_bind(bound))
          return;
 
-      render->api.terminate(render->render);
+      render->api.terminate(render->render, bound);
    }
 
    memset(render, 0, sizeof(struct wlc_render));
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pixman.h>
 #include "resources/resources.h"
 
 struct wlc_context;
@@ -13,20 +14,41 @@ struct wlc_output;
 struct wlc_render;
 struct wlc_origin;
 struct wlc_geometry;
+struct wlc_dmabuf_attributes;
 struct ctx;
 
+// Read backs that may be in flight at the same time
+enum wlc_readback_slot {
+   WLC_READBACK_SLOT_PIXELS, // wlc_output_get_pixels
+   WLC_READBACK_SLOT_CAPTURE, // continuous capture
+   WLC_READBACK_SLOT_LAST,
+};
+
+enum wlc_render_readback {
+   WLC_READBACK_FAILED,
+   WLC_READBACK_PENDING, // gpu has not finished yet
+   WLC_READBACK_DONE,
+};
+
 struct wlc_render_api {
-   WLC_NONULL void (*terminate)(struct ctx *render);
+   WLC_NONULL void (*terminate)(struct ctx *render, struct wlc_context *bound);
    WLC_NONULL void (*resolution)(struct ctx *render, const struct wlc_size *mode, const struct wlc_size *resolution);
    WLC_NONULL void (*surface_destroy)(struct ctx *render, struct wlc_context *bound, struct wlc_surface *surface);
-   WLC_NONULLV(1,2,3) bool (*surface_attach)(struct ctx *render, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer);
-   WLC_NONULL void (*view_paint)(struct ctx *render, struct wlc_view *view);
+   WLC_NONULLV(1,2,3) bool (*surface_attach)(struct ctx *render, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage); // NULL damage == everything
+   WLC_NONULL void (*buffer_destroy)(struct ctx *render, struct wlc_context *bound, struct wlc_buffer *buffer); // drop what is cached for the buffer
+   WLC_NONULL bool (*dmabuf_importable)(struct ctx *render, struct wlc_context *bound, const struct wlc_dmabuf_attributes *attributes); // test import, nothing is kept
+   WLC_NONULLV(1,2) void (*view_paint)(struct ctx *render, struct wlc_view *view, const struct wlc_origin *offset, const struct wlc_geometry *clip); // NULL offset == view is in output coordinates, NULL clip == whole view
    WLC_NONULL void (*surface_paint)(struct ctx *render, struct wlc_surface *surface, const struct wlc_geometry *geometry);
    WLC_NONULL void (*pointer_paint)(struct ctx *render, const struct wlc_origin *pos);
+   // Read back geometry is in surface (mode) coordinates, which differ from resolution on scaled outputs
    WLC_NONULL void (*read_pixels)(struct ctx *render, struct wlc_geometry *geometry, void *out_data);
+   WLC_NONULL bool (*read_pixels_queue)(struct ctx *render, enum wlc_readback_slot slot, struct wlc_geometry *geometry); // false == use read_pixels instead
+   WLC_NONULL enum wlc_render_readback (*read_pixels_fetch)(struct ctx *render, enum wlc_readback_slot slot, void *out_data, bool wait); // pixels of last read_pixels_queue to slot
    WLC_NONULL void (*background)(struct ctx *render);
    WLC_NONULL void (*clear)(struct ctx *render);
+   WLC_NONULLV(1) void (*scissor)(struct ctx *render, const struct wlc_geometry *geometry);
    WLC_NONULL void (*time)(struct ctx *render, uint32_t time);
+   WLC_NONULL void (*flush)(struct ctx *render); // paints may be queued until this, or until other state changes
 };
 
 struct wlc_render {
@@ -36,14 +58,20 @@ struct wlc_render {
 
 WLC_NONULL void wlc_render_resolution(struct wlc_render *render, struct wlc_context *bound, const struct wlc_size *mode, const struct wlc_size *resolution);
 WLC_NONULL void wlc_render_surface_destroy(struct wlc_render *render, struct wlc_context *bound, struct wlc_surface *surface);
-WLC_NONULLV(1,2,3) bool wlc_render_surface_attach(struct wlc_render *render, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer);
-WLC_NONULL void wlc_render_view_paint(struct wlc_render *render, struct wlc_context *bound, struct wlc_view *view);
+WLC_NONULLV(1,2,3) bool wlc_render_surface_attach(struct wlc_render *render, struct wlc_context *bound, struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage);
+WLC_NONULL void wlc_render_buffer_destroy(struct wlc_render *render, struct wlc_context *bound, struct wlc_buffer *buffer);
+WLC_NONULL bool wlc_render_dmabuf_importable(struct wlc_render *render, struct wlc_context *bound, const struct wlc_dmabuf_attributes *attributes);
+WLC_NONULLV(1,2,3) void wlc_render_view_paint(struct wlc_render *render, struct wlc_context *bound, struct wlc_view *view, const struct wlc_origin *offset, const struct wlc_geometry *clip);
 WLC_NONULL void wlc_render_surface_paint(struct wlc_render *render, struct wlc_context *bound, struct wlc_surface *surface, const struct wlc_geometry *geometry);
 WLC_NONULL void wlc_render_pointer_paint(struct wlc_render *render, struct wlc_context *bound, const struct wlc_origin *pos);
 WLC_NONULL void wlc_render_read_pixels(struct wlc_render *render, struct wlc_context *bound, struct wlc_geometry *geometry, void *out_data);
+WLC_NONULL bool wlc_render_read_pixels_queue(struct wlc_render *render, struct wlc_context *bound, enum wlc_readback_slot slot, struct wlc_geometry *geometry);
+WLC_NONULL enum wlc_render_readback wlc_render_read_pixels_fetch(struct wlc_render *render, struct wlc_context *bound, enum wlc_readback_slot slot, void *out_data, bool wait);
 WLC_NONULL void wlc_render_background(struct wlc_render *render, struct wlc_context *bound);
 WLC_NONULL void wlc_render_clear(struct wlc_render *render, struct wlc_context *bound);
+WLC_NONULLV(1,2) void wlc_render_scissor(struct wlc_render *render, struct wlc_context *bound, const struct wlc_geometry *geometry);
 WLC_NONULL void wlc_render_time(struct wlc_render *render, struct wlc_context *bound, uint32_t time);
+WLC_NONULL void wlc_render_flush(struct wlc_render *render, struct wlc_context *bound);
 void wlc_render_release(struct wlc_render *render, struct wlc_context *context);
 WLC_NONULL bool wlc_render(struct wlc_render *render, struct wlc_context *context);
 
@@ -1,6 +1,5 @@
 #include <wayland-util.h>
 #include <chck/math/math.h>
-#include <chck/string/string.h>
 #include "visibility.h"
 #include "internal.h"
 #include "macros.h"
@@ -25,12 +24,25 @@ struct handle_public {
    void *userdata;
 };
 
+/**
+ * Resources of one client, so wl_resource_for_client does not walk resources of every client.
+ * Found through the destroy listener of the client, lives until the client is destroyed. */
+struct client_resources {
+   struct wl_listener destroy;
+   struct chck_iter_pool resources; // wlc_resource
+};
+
 struct resource {
    struct {
       struct wl_listener destructor;
       struct wl_resource *r;
    } wl;
 
+   struct {
+      struct client_resources *index; // NULL when not indexed
+      size_t slot; // position in index
+   } client;
+
    struct handle handle;
 };
 
@@ -39,84 +51,139 @@ struct handle_info {
    wlc_resource public, private;
 };
 
-struct chck_pool resources;
-struct chck_pool handles;
+struct wlc_slab resources;
+struct wlc_slab handles;
+
+// Names of the types, for logging
+static const char *type_names[WLC_TYPE_LAST] = {
+   "none",
+   "output",
+   "view",
+   "surface",
+   "subsurface",
+   "region",
+   "buffer",
+   "callback",
+   "pointer",
+   "keyboard",
+   "touch",
+   "data-device",
+   "data-offer",
+   "data-source",
+   "shell-surface",
+   "xdg-surface",
+   "xdg-popup",
+   "presentation-feedback",
+   "dmabuf-params",
+};
+
+static const char*
+type_name(enum wlc_type type)
+{
+   return (type < WLC_TYPE_LAST ? type_names[type] : "unknown");
+}
 
 static void
-relocate_handle(struct handle *handle, void *dest, const void *start, const void *end)
+cb_client_destroy(struct wl_listener *listener, void *data)
 {
-   assert(handle && dest && start && end);
+   (void)data;
+   assert(listener);
 
-   if ((char*)handle->source < (char*)start || (char*)handle->source > (char*)end)
-      return;
+   struct client_resources *cr;
+   except((cr = wl_container_of(listener, cr, destroy)));
 
-   handle->source = (void*)((char*)dest + ((char*)handle->source - (char*)start));
+   // resources of client are destroyed after this, they are not in any index anymore
+   wlc_resource *p;
+   chck_iter_pool_for_each(&cr->resources, p) {
+      struct resource *r;
+      if ((r = wlc_slab_get(&resources, *p - 1)))
+         r->client.index = NULL;
+   }
+
+   wl_list_remove(&cr->destroy.link);
+   chck_iter_pool_release(&cr->resources);
+   free(cr);
 }
 
-static void
-relocate_handles(struct chck_pool *pool, void *dest, const void *start, const void *end)
+static struct client_resources*
+client_resources_for(struct wl_client *client, bool create)
 {
-   // worst case scenario
-   // when source pool address changes on resize, we need to make sure all inner sources
-   // are relocated to avoid access to garbage location.
+   assert(client);
 
-   assert(dest && end);
-
-   if (!start)
-      return;
+   struct client_resources *cr;
+   struct wl_listener *listener;
+   if ((listener = wl_client_get_destroy_listener(client, cb_client_destroy)))
+      return wl_container_of(listener, cr, destroy);
 
-   wlc_dlog(WLC_DBG_HANDLE, "Relocating %s at range %p-%p to %p", (pool == &handles ? "handles" : "resources"), start, end, dest);
+   if (!create || !(cr = calloc(1, sizeof(struct client_resources))))
+      return NULL;
 
-   if (pool == &resources) {
-      struct resource *r;
-      chck_pool_for_each(pool, r)
-         relocate_handle(&r->handle, dest, start, end);
-   } else {
-      chck_pool_for_each_call(pool, relocate_handle, dest, start, end);
+   if (!chck_iter_pool(&cr->resources, 8, 0, sizeof(wlc_resource))) {
+      free(cr);
+      return NULL;
    }
+
+   cr->destroy.notify = cb_client_destroy;
+   wl_client_add_destroy_listener(client, &cr->destroy);
+   return cr;
 }
 
-static void
-relocate_resources(struct chck_pool *pool)
+static bool
+client_index_add(struct resource *resource)
 {
-   // worst case scenario
-   // when resrouce container pool address changes, we need to reset all destructors again
+   assert(resource && resource->wl.r && !resource->client.index);
 
-   wlc_dlog(WLC_DBG_HANDLE, "Relocating resources");
+   struct client_resources *cr;
+   if (!(cr = client_resources_for(wl_resource_get_client(resource->wl.r), true)))
+      return false;
 
-   struct resource *r;
-   chck_pool_for_each(pool, r) {
-      if (!r->wl.r)
-         continue;
+   if (!chck_iter_pool_push_back(&cr->resources, &resource->handle.public))
+      return false;
+
+   resource->client.index = cr;
+   resource->client.slot = cr->resources.items.count - 1;
+   return true;
+}
+
+static void
+client_index_remove(struct resource *resource)
+{
+   assert(resource);
+
+   struct client_resources *cr;
+   if (!(cr = resource->client.index))
+      return;
 
-      wl_list_remove(&r->wl.destructor.link);
-      wl_resource_add_destroy_listener(r->wl.r, &r->wl.destructor);
+   // move the last resource of client to the freed slot
+   const size_t last = cr->resources.items.count - 1;
+   if (resource->client.slot != last) {
+      wlc_resource *moved = chck_iter_pool_get(&cr->resources, last);
+      wlc_resource *slot = chck_iter_pool_get(&cr->resources, resource->client.slot);
+      struct resource *r = wlc_slab_get(&resources, *moved - 1);
+      assert(r && r->client.index == cr);
+      r->client.slot = resource->client.slot;
+      *slot = *moved;
    }
+
+   chck_iter_pool_remove(&cr->resources, last);
+   resource->client.index = NULL;
 }
 
 static bool
-handle_create(struct chck_pool *pool, struct wlc_source *source, struct handle_info *out_info)
+handle_create(struct wlc_slab *pool, struct wlc_source *source, struct handle_info *out_info)
 {
    assert(pool && source && out_info);
 
    size_t i;
    void *c;
-   uint8_t *original = pool->items.buffer;
-   if (!(c = chck_pool_add(pool, NULL, &i)))
+   if (!(c = wlc_slab_add(pool, NULL, &i)))
       return false;
 
-   if (pool == &resources && original != pool->items.buffer)
-      relocate_resources(pool);
-
    size_t h;
    uint8_t *v;
-   original = source->pool.items.buffer;
-   if (!(v = chck_pool_add(&source->pool, NULL, &h)))
+   if (!(v = wlc_slab_add(&source->pool, NULL, &h)))
       goto error0;
 
-   if (original != source->pool.items.buffer)
-      relocate_handles(pool, source->pool.items.buffer, original, original + source->pool.items.allocated);
-
    if (i >= (wlc_resource)~0 || h >= (wlc_resource)~0)
       goto error1;
 
@@ -124,7 +191,7 @@ handle_create(struct chck_pool *pool, struct wlc_source *source, struct handle_i
    out_info->data = v;
    out_info->public = i + 1;
    out_info->private = h + 1;
-   memcpy(v + source->pool.items.member - sizeof(wlc_handle), &out_info->public, sizeof(wlc_handle));
+   memcpy(v + source->pool.member - sizeof(wlc_handle), &out_info->public, sizeof(wlc_handle));
 
    if (source->constructor) {
       wlc_dlog(WLC_DBG_HANDLE, "=> Calling constructor for (%s) %" PRIuWLC, source->name, out_info->public);
@@ -139,14 +206,14 @@ handle_create(struct chck_pool *pool, struct wlc_source *source, struct handle_i
    return true;
 
 error1:
-   chck_pool_remove(&source->pool, h);
+   wlc_slab_remove(&source->pool, h);
 error0:
-   chck_pool_remove(pool, i);
+   wlc_slab_remove(pool, i);
    return false;
 }
 
 static void
-handle_release(struct chck_pool *pool, struct handle *handle, void (*preremove)())
+handle_release(struct wlc_slab *pool, struct handle *handle, void (*preremove)())
 {
    assert(pool);
 
@@ -155,65 +222,45 @@ handle_release(struct chck_pool *pool, struct handle *handle, void (*preremove)(
 
    if (handle->private) {
       void *v;
-      if (handle->source->destructor && (v = chck_pool_get(&handle->source->pool, handle->private - 1))) {
+      if (handle->source->destructor && (v = wlc_slab_get(&handle->source->pool, handle->private - 1))) {
          wlc_dlog(WLC_DBG_HANDLE, "=> Calling destructor for (%s) %" PRIuWLC, handle->source->name, handle->public);
-
-         // destructor may trigger destruction of other handles
-         // that may then cause relocation of the containing pool
-         // keep track of the address and relocate our handle after.
-         uint8_t *original = pool->items.buffer;
          handle->source->destructor(v);
-
-         if (pool->items.buffer != original) {
-            wlc_dlog(WLC_DBG_HANDLE, "Pool got relocated after calling destructor. Relocating handle...");
-            handle = (struct handle*)(pool->items.buffer + ((uint8_t*)handle - original));
-         }
-
          wlc_dlog(WLC_DBG_HANDLE, "<= Called destructor for (%s) %" PRIuWLC, handle->source->name, handle->public);
       }
 
-      uint8_t *original = handle->source->pool.items.buffer;
-      chck_pool_remove(&handle->source->pool, handle->private - 1);
-
-      if (original != handle->source->pool.items.buffer)
-         relocate_handles(pool, handle->source->pool.items.buffer, original, original + handle->source->pool.items.allocated);
+      wlc_slab_remove(&handle->source->pool, handle->private - 1);
    }
 
    // called right after removal of the container
    // used by resource handles to do final destruction of wayland resource
    if (preremove)
-      preremove(chck_pool_get(pool, handle->public - 1));
+      preremove(wlc_slab_get(pool, handle->public - 1));
 
    wlc_dlog(WLC_DBG_HANDLE, "Released %s (%s) %" PRIuWLC, (pool == &handles ? "handle" : "resource"), handle->source->name, handle->public);
 
-   void *original = pool->items.buffer;
-   chck_pool_remove(pool, handle->public - 1);
-
-   if (pool == &resources && original != pool->items.buffer)
-      relocate_resources(pool);
+   wlc_slab_remove(pool, handle->public - 1);
 }
 
 WLC_PURE static bool
-handle_is(struct handle *handle, const char *name)
+handle_is(struct handle *handle, enum wlc_type type)
 {
-   assert(name);
-   return (handle ? chck_cstreq(handle->source->name, name) : false);
+   return (handle && type ? handle->source->type == type : false);
 }
 
 static void*
-handle_get(struct handle *handle, const char *name, size_t line, const char *file, const char *function)
+handle_get(struct handle *handle, enum wlc_type type, size_t line, const char *file, const char *function)
 {
-   assert(name && file && function);
+   assert(file && function);
 
    if (!handle || !handle->private)
       return NULL;
 
-   if (!handle_is(handle, name)) {
-      wlc_log(WLC_LOG_WARN, "%s: %zu @ %s(): Tried to retrieve handle of wrong type (%s != %s)", file, line, function, handle->source->name, name);
+   if (!handle_is(handle, type)) {
+      wlc_log(WLC_LOG_WARN, "%s: %zu @ %s(): Tried to retrieve handle of wrong type (%s != %s)", file, line, function, handle->source->name, type_name(type));
       return NULL;
    }
 
-   return chck_pool_get(&handle->source->pool, handle->private - 1);
+   return wlc_slab_get(&handle->source->pool, handle->private - 1);
 }
 
 WLC_PURE wlc_handle
@@ -232,6 +279,7 @@ resource_invalidate(struct resource *resource)
       return;
 
    if (resource->wl.r) {
+      client_index_remove(resource);
       wl_list_remove(&resource->wl.destructor.link);
       resource->wl.r = NULL;
    }
@@ -265,28 +313,28 @@ resource_release(struct resource *resource)
 bool
 wlc_resources_init(void)
 {
-   return (chck_pool(&resources, 32, 0, sizeof(struct resource)) && chck_pool(&handles, 32, 0, sizeof(struct handle_public)));
+   return (wlc_slab(&resources, 32, sizeof(struct resource)) && wlc_slab(&handles, 32, sizeof(struct handle_public)));
 }
 
 void
 wlc_resources_terminate(void)
 {
-   chck_pool_for_each_call(&resources, wlc_resource_release_ptr);
-   chck_pool_for_each_call(&handles, wlc_handle_release_ptr);
-   chck_pool_release(&resources);
-   chck_pool_release(&handles);
+   wlc_slab_for_each_call(&resources, wlc_resource_release_ptr);
+   wlc_slab_for_each_call(&handles, wlc_handle_release_ptr);
+   wlc_slab_release(&resources);
+   wlc_slab_release(&handles);
 }
 
 bool
-wlc_source(struct wlc_source *source, const char *name, bool (*constructor)(), void (*destructor)(), size_t grow, size_t member)
+wlc_source(struct wlc_source *source, enum wlc_type type, bool (*constructor)(), void (*destructor)(), size_t grow, size_t member)
 {
-   assert(source && name && grow);
+   assert(source && type && type < WLC_TYPE_LAST && grow);
    memset(source, 0, sizeof(struct wlc_source));
-
-   source->name = name;
+   source->type = type;
+   source->name = type_name(type);
    source->constructor = constructor;
    source->destructor = destructor;
-   return chck_pool(&source->pool, grow, 0, member + sizeof(wlc_handle));
+   return wlc_slab(&source->pool, grow, member + sizeof(wlc_handle));
 }
 
 void
@@ -296,7 +344,7 @@ wlc_source_release(struct wlc_source *source)
       return;
 
    struct handle *h;
-   chck_pool_for_each(&handles, h) {
+   wlc_slab_for_each(&handles, h) {
       if (h->source != source)
          continue;
 
@@ -304,14 +352,14 @@ wlc_source_release(struct wlc_source *source)
    }
 
    struct resource *r;
-   chck_pool_for_each(&resources, r) {
+   wlc_slab_for_each(&resources, r) {
       if (r->handle.source != source)
          continue;
 
       resource_release(r);
    }
 
-   chck_pool_release(&source->pool);
+   wlc_slab_release(&source->pool);
 }
 
 void*
@@ -331,14 +379,14 @@ wlc_handle_create(struct wlc_source *source)
 }
 
 void*
-convert_from_wlc_handle(wlc_handle handle, const char *name, size_t line, const char *file, const char *function)
+convert_from_wlc_handle(wlc_handle handle, enum wlc_type type, size_t line, const char *file, const char *function)
 {
-   assert(name && file && function);
+   assert(file && function);
 
    if (!handle)
       return NULL;
 
-   return handle_get(chck_pool_get(&handles, handle - 1), name, line, file, function);
+   return handle_get(wlc_slab_get(&handles, handle - 1), type, line, file, function);
 }
 
 void
@@ -347,7 +395,7 @@ wlc_handle_release(wlc_handle handle)
    if (!handle)
       return;
 
-   handle_release(&handles, chck_pool_get(&handles, handle - 1), NULL);
+   handle_release(&handles, wlc_slab_get(&handles, handle - 1), NULL);
 }
 
 struct wl_resource*
@@ -408,6 +456,7 @@ wl_destructor(struct wl_listener *listener, void *data)
 
    struct resource *r;
    except((r = wl_container_of(listener, r, wl.destructor)));
+   client_index_remove(r);
    wl_list_remove(&r->wl.destructor.link);
    r->wl.r = NULL;
 
@@ -434,19 +483,26 @@ wlc_resource_create_from(struct wlc_source *source, struct wl_resource *resource
    r->wl.r = resource;
    r->wl.destructor.notify = wl_destructor;
    wl_resource_add_destroy_listener(resource, &r->wl.destructor);
+
+   if (!client_index_add(r)) {
+      resource_invalidate(r);
+      wlc_resource_release(r->handle.public);
+      return 0;
+   }
+
    return r->handle.public;
 }
 
 void*
-convert_from_wlc_resource(wlc_resource resource, const char *name, size_t line, const char *file, const char *function)
+convert_from_wlc_resource(wlc_resource resource, enum wlc_type type, size_t line, const char *file, const char *function)
 {
-   assert(name && file && function);
+   assert(file && function);
 
    if (!resource)
       return NULL;
 
-   struct resource *r = chck_pool_get(&resources, resource - 1);
-   return (r ? handle_get(&r->handle, name, line, file, function) : NULL);
+   struct resource *r = wlc_slab_get(&resources, resource - 1);
+   return (r ? handle_get(&r->handle, type, line, file, function) : NULL);
 }
 
 wlc_resource
@@ -467,22 +523,22 @@ wlc_resource_from_wl_resource(struct wl_resource *resource)
 }
 
 void*
-convert_from_wl_resource(struct wl_resource *resource, const char *name, size_t line, const char *file, const char *function)
+convert_from_wl_resource(struct wl_resource *resource, enum wlc_type type, size_t line, const char *file, const char *function)
 {
-   return convert_from_wlc_resource(wlc_resource_from_wl_resource(resource), name, line, file, function);
+   return convert_from_wlc_resource(wlc_resource_from_wl_resource(resource), type, line, file, function);
 }
 
 struct wl_resource*
-wl_resource_from_wlc_resource(wlc_resource resource, const char *name, size_t line, const char *file, const char *function)
+wl_resource_from_wlc_resource(wlc_resource resource, enum wlc_type type, size_t line, const char *file, const char *function)
 {
-   assert(name && file && function);
+   assert(file && function);
 
    struct resource *r;
-   if (!resource || !(r = chck_pool_get(&resources, resource - 1)))
+   if (!resource || !(r = wlc_slab_get(&resources, resource - 1)))
       return NULL;
 
-   if (!handle_is(&r->handle, name)) {
-      wlc_log(WLC_LOG_WARN, "%s: %zu @ %s(): Tried to retrieve resource of wrong type (%s != %s)", file, line, function, r->handle.source->name, name);
+   if (!handle_is(&r->handle, type)) {
+      wlc_log(WLC_LOG_WARN, "%s: %zu @ %s(): Tried to retrieve resource of wrong type (%s != %s)", file, line, function, r->handle.source->name, type_name(type));
       return NULL;
    }
 
@@ -494,12 +550,15 @@ wl_resource_for_client(struct wlc_source *source, struct wl_client *client)
 {
    assert(source && client);
 
-   struct resource *r;
-   chck_pool_for_each(&resources, r) {
-      if (r->handle.source != source || wl_resource_get_client(r->wl.r) != client)
-         continue;
+   struct client_resources *cr;
+   if (!(cr = client_resources_for(client, false)))
+      return NULL;
 
-      return r->wl.r;
+   wlc_resource *p;
+   chck_iter_pool_for_each(&cr->resources, p) {
+      struct resource *r = wlc_slab_get(&resources, *p - 1);
+      if (r && r->handle.source == source)
+         return r->wl.r;
    }
 
    return NULL;
@@ -511,7 +570,7 @@ wlc_resource_invalidate(wlc_resource resource)
    if (!resource)
       return;
 
-   resource_invalidate(chck_pool_get(&resources, resource - 1));
+   resource_invalidate(wlc_slab_get(&resources, resource - 1));
 }
 
 void
@@ -520,14 +579,14 @@ wlc_resource_release(wlc_resource resource)
    if (!resource)
       return;
 
-   resource_release(chck_pool_get(&resources, resource - 1));
+   resource_release(wlc_slab_get(&resources, resource - 1));
 }
 
 void
 wlc_resource_implement(wlc_resource resource, const void *implementation, void *userdata)
 {
    struct resource *r;
-   if (!resource || !(r = chck_pool_get(&resources, resource - 1)))
+   if (!resource || !(r = wlc_slab_get(&resources, resource - 1)))
       return;
 
    wl_resource_set_implementation(r->wl.r, implementation, userdata, NULL);
@@ -537,7 +596,7 @@ WLC_API void
 wlc_handle_set_user_data(wlc_handle handle, const void *userdata)
 {
    struct handle_public *h;
-   if (!handle || !(h = chck_pool_get(&handles, handle - 1)))
+   if (!handle || !(h = wlc_slab_get(&handles, handle - 1)))
       return;
 
    h->userdata = (void*)userdata;
@@ -547,7 +606,7 @@ WLC_API WLC_PURE void*
 wlc_handle_get_user_data(wlc_handle handle)
 {
    const struct handle_public *h;
-   if (!handle || !(h = chck_pool_get(&handles, handle - 1)))
+   if (!handle || !(h = wlc_slab_get(&handles, handle - 1)))
       return NULL;
 
    return h->userdata;
@@ -6,13 +6,42 @@
 #include <stdbool.h>
 #include <chck/pool/pool.h>
 #include <wayland-server.h>
+#include "slab.h"
 
 typedef uintptr_t wlc_resource;
 
+/**
+ * Type of the handles / resources a source carries.
+ * Conversions pass the type they expect, which is compared as an integer.
+ */
+enum wlc_type {
+   WLC_TYPE_NONE,
+   WLC_TYPE_OUTPUT,
+   WLC_TYPE_VIEW,
+   WLC_TYPE_SURFACE,
+   WLC_TYPE_SUBSURFACE,
+   WLC_TYPE_REGION,
+   WLC_TYPE_BUFFER,
+   WLC_TYPE_CALLBACK,
+   WLC_TYPE_POINTER,
+   WLC_TYPE_KEYBOARD,
+   WLC_TYPE_TOUCH,
+   WLC_TYPE_DATA_DEVICE,
+   WLC_TYPE_DATA_OFFER,
+   WLC_TYPE_DATA_SOURCE,
+   WLC_TYPE_SHELL_SURFACE,
+   WLC_TYPE_XDG_SURFACE,
+   WLC_TYPE_XDG_POPUP,
+   WLC_TYPE_PRESENTATION_FEEDBACK,
+   WLC_TYPE_DMABUF_PARAMS,
+   WLC_TYPE_LAST,
+};
+
 /** Storage for handles / resources. */
 struct wlc_source {
-   const char *name;
-   struct chck_pool pool;
+   const char *name; // for logging only
+   enum wlc_type type;
+   struct wlc_slab pool; // items never move, containers may embed sources
    bool (*constructor)();
    void (*destructor)();
 };
@@ -39,11 +68,11 @@ void wlc_resources_terminate(void);
 
 /**
  * Initialize source.
- * name should be type name of the handle/resource source will be carrying.
+ * type should be the type of the handle/resource source will be carrying.
  * grow defines the reallocation step for source.
  * member defines the size of item the source will be carrying.
  */
-WLC_NONULLV(1,2) bool wlc_source(struct wlc_source *source, const char *name, bool (*constructor)(), void (*destructor)(), size_t grow, size_t member);
+WLC_NONULLV(1) bool wlc_source(struct wlc_source *source, enum wlc_type type, bool (*constructor)(), void (*destructor)(), size_t grow, size_t member);
 
 /**
  * Release source and all the handles/resources it contains.
@@ -62,9 +91,9 @@ WLC_NONULL void* wlc_handle_create(struct wlc_source *source);
 
 /**
  * Convert from wlc_handle back to the pointer.
- * name should be same as the name in source, otherwise NULL is returned.
+ * type should be same as the type of source, otherwise NULL is returned.
  */
-void* convert_from_wlc_handle(wlc_handle handle, const char *name, size_t line, const char *file, const char *function);
+void* convert_from_wlc_handle(wlc_handle handle, enum wlc_type type, size_t line, const char *file, const char *function);
 #define convert_from_wlc_handle(x, y) convert_from_wlc_handle(x, y, __LINE__, WLC_FILE, __func__)
 
 /**
@@ -98,18 +127,18 @@ void wlc_resource_implement(wlc_resource resource, const void *implementation, v
 wlc_resource wlc_resource_from_wl_resource(struct wl_resource *resource);
 
 /** Convert to wayland resource from wlc_resource. */
-struct wl_resource* wl_resource_from_wlc_resource(wlc_resource resource, const char *name, size_t line, const char *file, const char *function);
+struct wl_resource* wl_resource_from_wlc_resource(wlc_resource resource, enum wlc_type type, size_t line, const char *file, const char *function);
 #define wl_resource_from_wlc_resource(x, y) wl_resource_from_wlc_resource(x, y, __LINE__, WLC_FILE, __func__)
 
 /** Get wayland resource for client from source. */
 WLC_NONULL struct wl_resource* wl_resource_for_client(struct wlc_source *source, struct wl_client *client);
 
 /** Convert to pointer from wlc_resource. */
-void* convert_from_wlc_resource(wlc_resource resource, const char *name, size_t line, const char *file, const char *function);
+void* convert_from_wlc_resource(wlc_resource resource, enum wlc_type type, size_t line, const char *file, const char *function);
 #define convert_from_wlc_resource(x, y) convert_from_wlc_resource(x, y, __LINE__, WLC_FILE, __func__)
 
 /** Convert to pointer from wayland resource. */
-void* convert_from_wl_resource(struct wl_resource *resource, const char *name, size_t line, const char *file, const char *function);
+void* convert_from_wl_resource(struct wl_resource *resource, enum wlc_type type, size_t line, const char *file, const char *function);
 #define convert_from_wl_resource(x, y) convert_from_wl_resource(x, y, __LINE__, WLC_FILE, __func__)
 
 /**
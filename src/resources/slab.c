@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <chck/overflow/overflow.h>
+#include "slab.h"
+
+static bool
+add_chunk(struct wlc_slab *slab)
+{
+   assert(slab);
+
+   size_t size;
+   if (chck_mul_ofsz(slab->grow, slab->member + 1, &size))
+      return false;
+
+   uint8_t **chunks;
+   if (!(chunks = chck_realloc_mul_of(slab->chunks, slab->allocated + 1, sizeof(uint8_t*))))
+      return false;
+
+   slab->chunks = chunks;
+
+   // liveness bytes must start cleared, items are written on add
+   if (!(slab->chunks[slab->allocated] = calloc(1, size)))
+      return false;
+
+   slab->allocated++;
+   return true;
+}
+
+bool
+wlc_slab(struct wlc_slab *slab, size_t grow, size_t member)
+{
+   assert(slab && grow && member);
+   memset(slab, 0, sizeof(struct wlc_slab));
+   slab->grow = grow;
+   slab->member = member;
+   return chck_iter_pool(&slab->removed, 32, 0, sizeof(size_t));
+}
+
+void
+wlc_slab_release(struct wlc_slab *slab)
+{
+   if (!slab)
+      return;
+
+   for (size_t i = 0; i < slab->allocated; ++i)
+      free(slab->chunks[i]);
+
+   free(slab->chunks);
+   chck_iter_pool_release(&slab->removed);
+   memset(slab, 0, sizeof(struct wlc_slab));
+}
+
+void*
+wlc_slab_add(struct wlc_slab *slab, const void *data, size_t *out_index)
+{
+   assert(slab);
+
+   size_t index;
+   if (slab->removed.items.count > 0) {
+      index = *(size_t*)chck_iter_pool_get(&slab->removed, slab->removed.items.count - 1);
+      chck_iter_pool_remove(&slab->removed, slab->removed.items.count - 1);
+   } else {
+      if (slab->used == SIZE_MAX || (slab->used / slab->grow >= slab->allocated && !add_chunk(slab)))
+         return NULL;
+
+      index = slab->used++;
+   }
+
+   uint8_t *chunk = slab->chunks[index / slab->grow];
+   const size_t i = index % slab->grow;
+   uint8_t *item = chunk + i * slab->member;
+
+   if (data) {
+      memcpy(item, data, slab->member);
+   } else {
+      memset(item, 0, slab->member);
+   }
+
+   chunk[slab->grow * slab->member + i] = true;
+   slab->count++;
+
+   if (out_index)
+      *out_index = index;
+
+   return item;
+}
+
+void
+wlc_slab_remove(struct wlc_slab *slab, size_t index)
+{
+   if (!wlc_slab_get(slab, index))
+      return;
+
+   slab->chunks[index / slab->grow][slab->grow * slab->member + index % slab->grow] = false;
+
+   if (--slab->count == 0) {
+      // nothing is alive, start handing out indices from beginning again
+      chck_iter_pool_flush(&slab->removed);
+      slab->used = 0;
+   } else if (index == slab->used - 1) {
+      slab->used--;
+   } else {
+      // on failure the index is not reused, slab stays valid
+      chck_iter_pool_push_back(&slab->removed, &index);
+   }
+}
@@ -0,0 +1,62 @@
+#ifndef _WLC_SLAB_H_
+#define _WLC_SLAB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <wlc/defines.h>
+#include <chck/pool/pool.h>
+
+/**
+ * Pool of equally sized items allocated in chunks.
+ * Growing adds a new chunk and never moves existing items, so pointers to items stay valid until they are removed.
+ * Indices of removed items are reused by later additions.
+ */
+struct wlc_slab {
+   uint8_t **chunks; // grow items, followed by a liveness byte for each item
+   size_t allocated; // chunks
+   size_t grow, member;
+   size_t count; // live items
+   size_t used; // indices handed out, live items are below this
+   struct chck_iter_pool removed; // free indices below used
+};
+
+/** Get item at index, NULL if there is no live item at index. */
+static inline void*
+wlc_slab_get(const struct wlc_slab *slab, size_t index)
+{
+   if (!slab || index >= slab->used)
+      return NULL;
+
+   uint8_t *chunk = slab->chunks[index / slab->grow];
+   const size_t i = index % slab->grow;
+   return (chunk[slab->grow * slab->member + i] ? chunk + i * slab->member : NULL);
+}
+
+/**
+ * Iterate live items of slab.
+ * Items may be removed while iterating.
+ */
+#define wlc_slab_for_each(slab, pos) \
+   for (size_t _I = 0; _I < (slab)->used; ++_I) \
+      if (!((pos) = wlc_slab_get(slab, _I))) {} else
+
+#define wlc_slab_for_each_call(slab, function, ...) \
+   { void *_P; wlc_slab_for_each(slab, _P) function(_P, ##__VA_ARGS__); }
+
+/** Initialize slab, grow is the amount of items in each chunk. */
+WLC_NONULL bool wlc_slab(struct wlc_slab *slab, size_t grow, size_t member);
+
+/** Release slab and all its chunks. */
+void wlc_slab_release(struct wlc_slab *slab);
+
+/**
+ * Add item to slab, data is copied to the item if not NULL, otherwise the item is zeroed.
+ * Index of the item is stored to out_index if not NULL.
+ */
+WLC_NONULLV(1) void* wlc_slab_add(struct wlc_slab *slab, const void *data, size_t *out_index);
+
+/** Remove item at index. */
+void wlc_slab_remove(struct wlc_slab *slab, size_t index);
+
+#endif /* _WLC_SLAB_H_ */
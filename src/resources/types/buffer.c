@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "surface.h"
+#include "compositor/output.h"
 
 void
 wlc_buffer_dispose(struct wlc_buffer *buffer)
@@ -12,7 +13,10 @@ wlc_buffer_dispose(struct wlc_buffer *buffer)
    if (buffer->references && --buffer->references > 0)
       return;
 
-   wlc_resource_release(convert_to_wlc_resource(buffer));
+   // Buffer itself stays with its cache until the wl_buffer is destroyed
+   struct wl_resource *resource;
+   if ((resource = convert_to_wl_resource(buffer, WLC_TYPE_BUFFER)))
+      wl_resource_queue_event(resource, WL_BUFFER_RELEASE);
 }
 
 wlc_resource
@@ -32,17 +36,24 @@ wlc_buffer_release(struct wlc_buffer *buffer)
       return;
 
    struct wlc_surface *surface;
-   if ((surface = convert_from_wlc_resource(buffer->surface, "surface"))) {
+   if ((surface = convert_from_wlc_resource(buffer->surface, WLC_TYPE_SURFACE))) {
       if (surface->commit.buffer == convert_to_wlc_resource(buffer))
          surface->commit.buffer = 0;
       if (surface->pending.buffer == convert_to_wlc_resource(buffer))
          surface->pending.buffer = 0;
+      if (surface->tree.cache.buffer == convert_to_wlc_resource(buffer))
+         surface->tree.cache.buffer = 0;
    }
 
+   wlc_output_buffer_destroy(convert_from_wlc_handle(buffer->cache.output, WLC_TYPE_OUTPUT), buffer);
+
+   // Released with its surface while the wl_buffer lives on, client gets it back if it was still in use
    struct wl_resource *resource;
-   if ((resource = convert_to_wl_resource(buffer, "buffer"))) {
+   if ((resource = convert_to_wl_resource(buffer, WLC_TYPE_BUFFER))) {
       wlc_resource_invalidate(convert_to_wlc_resource(buffer));
-      wl_resource_queue_event(resource, WL_BUFFER_RELEASE);
+
+      if (buffer->references > 0)
+         wl_resource_queue_event(resource, WL_BUFFER_RELEASE);
    }
 }
 
@@ -16,6 +16,16 @@ struct wlc_buffer {
       void *legacy_buffer;
    };
 
+   /**
+    * Images and textures of the contents, reused when the buffer is attached again.
+    * Entry is shared by the surfaces showing the buffer and outlives the buffer while they do.
+    * Managed by the renderer.
+    */
+   struct {
+      void *entry;
+      wlc_handle output;
+   } cache;
+
    uint16_t references;
    bool y_inverted;
 };
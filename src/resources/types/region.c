@@ -12,7 +12,7 @@ wl_cb_region_add(struct wl_client *client, struct wl_resource *resource, int32_t
    (void)client;
 
    struct wlc_region *region;
-   if (!(region = convert_from_wl_resource(resource, "region")))
+   if (!(region = convert_from_wl_resource(resource, WLC_TYPE_REGION)))
       return;
 
    pixman_region32_union_rect(&region->region, &region->region, x, y, width, height);
@@ -24,7 +24,7 @@ wl_cb_region_subtract(struct wl_client *client, struct wl_resource *resource, in
    (void)client;
 
    struct wlc_region *region;
-   if (!(region = convert_from_wl_resource(resource, "region")))
+   if (!(region = convert_from_wl_resource(resource, WLC_TYPE_REGION)))
       return;
 
    pixman_region32_t rect;
@@ -17,8 +17,8 @@ wl_cb_shell_surface_pong(struct wl_client *client, struct wl_resource *resource,
 
    struct wlc_view *view;
    struct wlc_surface *surface;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")) ||
-       !(surface = convert_from_wlc_resource(view->surface, "surface")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)) ||
+       !(surface = convert_from_wlc_resource(view->surface, WLC_TYPE_SURFACE)))
       return;
 
    STUBL(resource);
@@ -64,7 +64,7 @@ wl_cb_shell_surface_set_toplevel(struct wl_client *client, struct wl_resource *r
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    if (!wlc_view_request_state(view, WLC_BIT_FULLSCREEN, false))
@@ -79,11 +79,11 @@ wl_cb_shell_surface_set_transient(struct wl_client *client, struct wl_resource *
    (void)client, (void)flags;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
-   struct wlc_surface *surface = (parent_resource ? convert_from_wl_resource(parent_resource, "surface") : NULL);
-   wlc_view_set_parent_ptr(view, (surface ? convert_from_wlc_handle(surface->view, "view") : NULL));
+   struct wlc_surface *surface = (parent_resource ? convert_from_wl_resource(parent_resource, WLC_TYPE_SURFACE) : NULL);
+   wlc_view_set_parent_ptr(view, (surface ? convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW) : NULL));
    view->pending.geometry.origin = (struct wlc_origin){ x, y };
 }
 
@@ -93,14 +93,14 @@ wl_cb_shell_surface_set_fullscreen(struct wl_client *client, struct wl_resource
    (void)client, (void)method, (void)framerate;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    if (!wlc_view_request_state(view, WLC_BIT_FULLSCREEN, true))
       return;
 
    struct wlc_output *output;
-   if (output_resource && ((output = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(output_resource), "output"))))
+   if (output_resource && ((output = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(output_resource), WLC_TYPE_OUTPUT))))
       wlc_view_set_output_ptr(view, output);
 
    view->data.fullscreen_mode = method;
@@ -112,12 +112,12 @@ wl_cb_shell_surface_set_popup(struct wl_client *client, struct wl_resource *reso
    (void)client, (void)seat, (void)serial, (void)flags;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    wlc_view_set_type_ptr(view, WLC_BIT_POPUP, true);
-   struct wlc_surface *surface = (parent_resource ? convert_from_wl_resource(parent_resource, "surface") : NULL);
-   wlc_view_set_parent_ptr(view, (surface ? convert_from_wlc_handle(surface->view, "view") : NULL));
+   struct wlc_surface *surface = (parent_resource ? convert_from_wl_resource(parent_resource, WLC_TYPE_SURFACE) : NULL);
+   wlc_view_set_parent_ptr(view, (surface ? convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW) : NULL));
    view->pending.geometry.origin = (struct wlc_origin){ x, y };
 
 }
@@ -128,14 +128,14 @@ wl_cb_shell_surface_set_maximized(struct wl_client *client, struct wl_resource *
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    if (!wlc_view_request_state(view, WLC_BIT_MAXIMIZED, true))
       return;
 
    struct wlc_output *output;
-   if (output_resource && ((output = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(output_resource), "output"))))
+   if (output_resource && ((output = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(output_resource), WLC_TYPE_OUTPUT))))
       wlc_view_set_output_ptr(view, output);
 }
 
@@ -143,14 +143,14 @@ static void
 wl_cb_shell_surface_set_title(struct wl_client *client, struct wl_resource *resource, const char *title)
 {
    (void)client;
-   wlc_view_set_title_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view"), title);
+   wlc_view_set_title_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW), title);
 }
 
 static void
 wl_cb_shell_surface_set_class(struct wl_client *client, struct wl_resource *resource, const char *class_)
 {
    (void)client;
-   wlc_view_set_class_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view"), class_);
+   wlc_view_set_class_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW), class_);
 }
 
 WLC_CONST const struct wl_shell_surface_interface*
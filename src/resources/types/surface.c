@@ -10,21 +10,149 @@
 #include "macros.h"
 #include "compositor/output.h"
 #include "compositor/view.h"
+#include "compositor/presentation.h"
+
+static struct wlc_surface*
+get_parent(struct wlc_surface *surface)
+{
+   assert(surface);
+   return convert_from_wlc_resource(surface->parent, WLC_TYPE_SURFACE);
+}
+
+static struct wlc_surface*
+get_root(struct wlc_surface *surface)
+{
+   assert(surface);
+
+   struct wlc_surface *parent;
+   while ((parent = get_parent(surface)))
+      surface = parent;
+
+   return surface;
+}
+
+static struct wlc_output*
+get_output(struct wlc_surface *surface)
+{
+   assert(surface);
+
+   // Sub-surfaces are painted with the tree of their root
+   return convert_from_wlc_handle(get_root(surface)->output, WLC_TYPE_OUTPUT);
+}
+
+static bool
+is_synchronized(struct wlc_surface *surface)
+{
+   assert(surface);
+
+   // Sub-surface is synchronized also when any of its parents is
+   for (struct wlc_surface *s = surface; s && s->parent; s = get_parent(s)) {
+      if (s->synchronized)
+         return true;
+   }
+
+   return false;
+}
 
 static void
-surface_attach(struct wlc_surface *surface, struct wlc_buffer *buffer)
+tree_changed(struct wlc_surface *surface)
+{
+   assert(surface);
+   get_root(surface)->tree.changed = true;
+}
+
+static size_t
+tree_index(struct chck_iter_pool *tree, wlc_resource r)
+{
+   assert(tree);
+
+   for (size_t i = 0; i < tree->items.count; ++i) {
+      if (*(wlc_resource*)chck_iter_pool_get(tree, i) == r)
+         return i;
+   }
+
+   return SIZE_MAX;
+}
+
+static bool
+tree_insert(struct chck_iter_pool *tree, size_t index, wlc_resource r)
+{
+   assert(tree);
+
+   if (index >= tree->items.count)
+      return chck_iter_pool_push_back(tree, &r);
+
+   return chck_iter_pool_insert(tree, index, &r);
+}
+
+static bool
+tree_add(struct chck_iter_pool *tree, wlc_resource r)
+{
+   assert(tree);
+
+   // First sub-surface, the parent itself is below it
+   const wlc_resource self = 0;
+   if (!tree->items.count && !chck_iter_pool_push_back(tree, &self))
+      return false;
+
+   return chck_iter_pool_push_back(tree, &r);
+}
+
+static bool
+tree_equals(const struct chck_iter_pool *a, const struct chck_iter_pool *b)
+{
+   assert(a && b);
+   return (a->items.count == b->items.count && (!a->items.count || !memcmp(a->items.buffer, b->items.buffer, a->items.count * sizeof(wlc_resource))));
+}
+
+static void
+tree_remove(struct chck_iter_pool *tree, wlc_resource r)
+{
+   assert(tree);
+
+   size_t i;
+   if ((i = tree_index(tree, r)) == SIZE_MAX)
+      return;
+
+   chck_iter_pool_remove(tree, i);
+
+   // Only the parent itself is left
+   if (tree->items.count == 1)
+      chck_iter_pool_flush(tree);
+}
+
+static bool
+attach_to_output(struct wlc_surface *surface, struct wlc_output *output, struct wlc_buffer *buffer, pixman_region32_t *damage)
+{
+   assert(output);
+
+   if (!surface || !wlc_output_surface_attach(output, surface, buffer, damage))
+      return false;
+
+   struct wlc_size size = wlc_size_zero;
+
+   if (buffer)
+      size = buffer->size;
+
+   surface->size = size;
+   surface->commit.attached = (buffer ? true : false);
+   return true;
+}
+
+static void
+surface_attach(struct wlc_surface *surface, struct wlc_buffer *buffer, pixman_region32_t *damage)
 {
    assert(surface);
 
    struct wlc_output *output;
-   if (!(output = convert_from_wlc_handle(surface->output, "output")))
+   if (!(output = get_output(surface)))
       return;
 
    if (output)
-      wlc_surface_attach_to_output(surface, output, buffer);
+      attach_to_output(surface, output, buffer, damage);
 
    struct wlc_view *view;
-   if ((view = convert_from_wlc_handle(surface->view, "view"))) {
+   if ((view = convert_from_wlc_handle(surface->view, WLC_TYPE_VIEW))) {
       if (buffer) {
          wlc_view_map(view);
          wlc_view_ack_surface_attach(view, surface);
@@ -40,7 +168,7 @@ state_set_buffer(struct wlc_surface_state *state, struct wlc_buffer *buffer)
    if (state->buffer == convert_to_wlc_resource(buffer))
       return;
 
-   wlc_buffer_dispose(convert_from_wlc_resource(state->buffer, "buffer"));
+   wlc_buffer_dispose(convert_from_wlc_resource(state->buffer, WLC_TYPE_BUFFER));
    state->buffer = wlc_buffer_use(buffer);
 }
 
@@ -48,11 +176,12 @@ static void
 commit_state(struct wlc_surface *surface, struct wlc_surface_state *pending, struct wlc_surface_state *out)
 {
    if (pending->attached) {
-      surface_attach(surface, convert_from_wlc_resource(pending->buffer, "buffer"));
+      // Renderer may upload only the damaged part of the new buffer
+      surface_attach(surface, convert_from_wlc_resource(pending->buffer, WLC_TYPE_BUFFER), &pending->damage);
       pending->attached = false;
    }
 
-   state_set_buffer(out, convert_from_wlc_resource(pending->buffer, "buffer"));
+   state_set_buffer(out, convert_from_wlc_resource(pending->buffer, WLC_TYPE_BUFFER));
    state_set_buffer(pending, NULL);
 
    pending->offset = wlc_origin_zero;
@@ -62,9 +191,17 @@ commit_state(struct wlc_surface *surface, struct wlc_surface_state *pending, str
       chck_iter_pool_push_back(&out->frame_cbs, r);
    chck_iter_pool_flush(&pending->frame_cbs);
 
+   // Content that was not yet presented is replaced by this commit
+   chck_iter_pool_for_each_call(&out->feedbacks, wlc_presentation_feedback_discarded_ptr);
+   chck_iter_pool_flush(&out->feedbacks);
+
+   chck_iter_pool_for_each(&pending->feedbacks, r)
+      chck_iter_pool_push_back(&out->feedbacks, r);
+   chck_iter_pool_flush(&pending->feedbacks);
+
    pixman_region32_union(&out->damage, &out->damage, &pending->damage);
    pixman_region32_intersect_rect(&out->damage, &out->damage, 0, 0, surface->size.w, surface->size.h);
-   pixman_region32_clear(&surface->pending.damage);
+   pixman_region32_clear(&pending->damage);
 
    pixman_region32_t opaque;
    pixman_region32_init(&opaque);
@@ -78,6 +215,116 @@ commit_state(struct wlc_surface *surface, struct wlc_surface_state *pending, str
    pixman_region32_intersect_rect(&out->input, &pending->input, 0, 0, surface->size.w, surface->size.h);
 }
 
+static void
+cache_state(struct wlc_surface_state *pending, struct wlc_surface_state *cache)
+{
+   assert(pending && cache);
+
+   // Newer attach replaces the cached one, other state accumulates like it would on the surface
+   if (pending->attached) {
+      state_set_buffer(cache, convert_from_wlc_resource(pending->buffer, WLC_TYPE_BUFFER));
+      cache->offset = pending->offset;
+      cache->attached = true;
+      pending->attached = false;
+   }
+
+   state_set_buffer(pending, NULL);
+   pending->offset = wlc_origin_zero;
+
+   wlc_resource *r;
+   chck_iter_pool_for_each(&pending->frame_cbs, r)
+      chck_iter_pool_push_back(&cache->frame_cbs, r);
+   chck_iter_pool_flush(&pending->frame_cbs);
+
+   chck_iter_pool_for_each_call(&cache->feedbacks, wlc_presentation_feedback_discarded_ptr);
+   chck_iter_pool_flush(&cache->feedbacks);
+
+   chck_iter_pool_for_each(&pending->feedbacks, r)
+      chck_iter_pool_push_back(&cache->feedbacks, r);
+   chck_iter_pool_flush(&pending->feedbacks);
+
+   pixman_region32_union(&cache->damage, &cache->damage, &pending->damage);
+   pixman_region32_clear(&pending->damage);
+   pixman_region32_copy(&cache->opaque, &pending->opaque);
+   pixman_region32_copy(&cache->input, &pending->input);
+   cache->scale = pending->scale;
+   cache->transform = pending->transform;
+}
+
+static void apply_state(struct wlc_surface *surface, struct wlc_surface_state *state);
+
+static void
+apply_subsurfaces(struct wlc_surface *surface)
+{
+   assert(surface);
+
+   // Order and positions of sub-surfaces are state of the parent
+   struct chck_iter_pool *pending = &surface->tree.pending, *current = &surface->tree.current;
+   if (!tree_equals(pending, current)) {
+      if (pending->items.count) {
+         chck_iter_pool_set_c_array(current, pending->items.buffer, pending->items.count);
+      } else {
+         chck_iter_pool_flush(current);
+      }
+
+      tree_changed(surface);
+   }
+
+   wlc_resource *r;
+   chck_iter_pool_for_each(current, r) {
+      struct wlc_surface *child;
+      if (!*r || !(child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)))
+         continue;
+
+      if (!wlc_origin_equals(&child->tree.position, &child->tree.pending_position)) {
+         child->tree.position = child->tree.pending_position;
+         tree_changed(surface);
+      }
+
+      // Commits of synchronized sub-surfaces wait for their parent
+      if (child->tree.cached && is_synchronized(child)) {
+         child->tree.cached = false;
+         apply_state(child, &child->tree.cache);
+      }
+   }
+}
+
+static void
+apply_state(struct wlc_surface *surface, struct wlc_surface_state *state)
+{
+   assert(surface && state);
+
+   const bool attached = surface->commit.attached;
+   const struct wlc_size size = surface->size;
+   commit_state(surface, state, &surface->commit);
+
+   if (surface->parent && (attached != surface->commit.attached || !wlc_size_equals(&size, &surface->size)))
+      tree_changed(surface);
+
+   apply_subsurfaces(surface);
+}
+
+static void
+apply_desynchronized(struct wlc_surface *surface)
+{
+   assert(surface);
+
+   // Held back commit is applied as soon as nothing holds it anymore
+   if (surface->tree.cached) {
+      surface->tree.cached = false;
+      apply_state(surface, &surface->tree.cache);
+   }
+
+   // Descendants that are not synchronized themselves were only held back by this surface
+   const wlc_resource self = convert_to_wlc_resource(surface);
+   wlc_resource *r;
+   chck_iter_pool_for_each(&surface->tree.pending, r) {
+      struct wlc_surface *child;
+      if (*r && (child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) && child->parent == self && !child->synchronized)
+         apply_desynchronized(child);
+   }
+}
+
 static void
 release_state(struct wlc_surface_state *state)
 {
@@ -91,6 +338,8 @@ release_state(struct wlc_surface_state *state)
    state_set_buffer(state, 0);
    chck_iter_pool_for_each_call(&state->frame_cbs, wlc_resource_release_ptr);
    chck_iter_pool_release(&state->frame_cbs);
+   chck_iter_pool_for_each_call(&state->feedbacks, wlc_presentation_feedback_discarded_ptr);
+   chck_iter_pool_release(&state->feedbacks);
 }
 
 static void
@@ -99,7 +348,7 @@ wl_cb_surface_attach(struct wl_client *client, struct wl_resource *resource, str
    (void)client;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    wlc_resource buffer = 0;
@@ -109,7 +358,7 @@ wl_cb_surface_attach(struct wl_client *client, struct wl_resource *resource, str
    }
 
    struct wlc_buffer *b;
-   if ((b = convert_from_wlc_resource(buffer, "buffer"))) {
+   if ((b = convert_from_wlc_resource(buffer, WLC_TYPE_BUFFER))) {
       b->surface = convert_to_wlc_resource(surface);
       state_set_buffer(&surface->pending, b);
    }
@@ -126,7 +375,7 @@ wl_cb_surface_damage(struct wl_client *client, struct wl_resource *resource, int
    (void)client;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    pixman_region32_union_rect(&surface->pending.damage, &surface->pending.damage, x, y, width, height);
@@ -137,7 +386,7 @@ static void
 wl_cb_surface_frame(struct wl_client *client, struct wl_resource *resource, uint32_t callback_id)
 {
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    wlc_resource r;
@@ -155,11 +404,11 @@ wl_cb_surface_set_opaque_region(struct wl_client *client, struct wl_resource *re
    (void)client;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    struct wlc_region *region;
-   if (region_resource && (region = convert_from_wl_resource(region_resource, "region"))) {
+   if (region_resource && (region = convert_from_wl_resource(region_resource, WLC_TYPE_REGION))) {
       pixman_region32_copy(&surface->pending.opaque, &region->region);
    } else {
       pixman_region32_clear(&surface->pending.opaque);
@@ -172,11 +421,11 @@ wl_cb_surface_set_input_region(struct wl_client *client, struct wl_resource *res
    (void)client;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    struct wlc_region *region;
-   if (region_resource && (region = convert_from_wl_resource(region_resource, "region"))) {
+   if (region_resource && (region = convert_from_wl_resource(region_resource, WLC_TYPE_REGION))) {
       pixman_region32_copy(&surface->pending.input, &region->region);
    } else {
       pixman_region32_fini(&surface->pending.input);
@@ -190,11 +439,26 @@ wl_cb_surface_commit(struct wl_client *client, struct wl_resource *resource)
    (void)client;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
-   commit_state(surface, &surface->pending, &surface->commit);
-   wlc_output_schedule_repaint(convert_from_wlc_handle(surface->output, "output"));
+   if (is_synchronized(surface)) {
+      cache_state(&surface->pending, &surface->tree.cache);
+      surface->tree.cached = true;
+      wlc_dlog(WLC_DBG_RENDER, "-> Commit request (cached)");
+      return;
+   }
+
+   // Cached state is applied together with the new state
+   if (surface->tree.cached) {
+      cache_state(&surface->pending, &surface->tree.cache);
+      surface->tree.cached = false;
+      apply_state(surface, &surface->tree.cache);
+   } else {
+      apply_state(surface, &surface->pending);
+   }
+
+   wlc_output_schedule_repaint(get_output(surface));
    wlc_dlog(WLC_DBG_RENDER, "-> Commit request");
 }
 
@@ -204,7 +468,7 @@ wl_cb_surface_set_buffer_transform(struct wl_client *client, struct wl_resource
    (void)client, (void)resource, (void)transform;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    if (transform < 0 || transform > WL_OUTPUT_TRANSFORM_FLIPPED_270) {
@@ -221,7 +485,7 @@ wl_cb_surface_set_buffer_scale(struct wl_client *client, struct wl_resource *res
    (void)client;
 
    struct wlc_surface *surface;
-   if (!(surface = convert_from_wl_resource(resource, "surface")))
+   if (!(surface = convert_from_wl_resource(resource, WLC_TYPE_SURFACE)))
       return;
 
    if (scale < 0) {
@@ -238,7 +502,7 @@ wlc_surface_get_buffer(struct wlc_surface *surface)
    if (!surface)
       return NULL;
 
-   return convert_from_wlc_resource((surface->commit.buffer ? surface->commit.buffer : surface->pending.buffer), "buffer");
+   return convert_from_wlc_resource((surface->commit.buffer ? surface->commit.buffer : surface->pending.buffer), WLC_TYPE_BUFFER);
 }
 
 void
@@ -249,7 +513,7 @@ wlc_surface_attach_to_view(struct wlc_surface *surface, struct wlc_view *view)
 
    wlc_handle old = surface->view;
    surface->view = convert_to_wlc_handle(view);
-   wlc_view_set_surface(convert_from_wlc_handle(old, "view"), NULL);
+   wlc_view_set_surface(convert_from_wlc_handle(old, WLC_TYPE_VIEW), NULL);
    wlc_view_set_surface(view, surface);
 }
 
@@ -257,27 +521,92 @@ bool
 wlc_surface_attach_to_output(struct wlc_surface *surface, struct wlc_output *output, struct wlc_buffer *buffer)
 {
    assert(output);
+   return attach_to_output(surface, output, buffer, NULL);
+}
 
-   if (!surface || !wlc_output_surface_attach(output, surface, buffer))
-      return false;
+void
+wlc_surface_set_parent(struct wlc_surface *surface, struct wlc_surface *parent)
+{
+   if (!surface || surface->parent == convert_to_wlc_resource(parent))
+      return;
 
-   struct wlc_size size = wlc_size_zero;
+   const wlc_resource r = convert_to_wlc_resource(surface);
 
-   if (buffer)
-      size = buffer->size;
+   struct wlc_surface *old;
+   if ((old = get_parent(surface))) {
+      tree_changed(old);
+      tree_remove(&old->tree.pending, r);
+      tree_remove(&old->tree.current, r);
+      wlc_output_schedule_repaint(get_output(old));
+   }
 
-   surface->size = size;
-   surface->commit.attached = (buffer ? true : false);
-   return true;
+   surface->parent = 0;
+   surface->tree.pending_position = surface->tree.position = wlc_origin_zero;
+
+   // New sub-surface is placed on top of its siblings, it shows up with the next commit of parent
+   if (parent) {
+      if (!tree_add(&parent->tree.pending, r))
+         return;
+
+      surface->parent = convert_to_wlc_resource(parent);
+   }
 }
 
 void
-wlc_surface_set_parent(struct wlc_surface *surface, struct wlc_surface *parent)
+wlc_surface_set_synchronized(struct wlc_surface *surface, bool synchronized)
 {
    if (!surface)
       return;
 
-   surface->parent = convert_to_wlc_resource(parent);
+   surface->synchronized = synchronized;
+
+   if (!synchronized && !is_synchronized(surface)) {
+      apply_desynchronized(surface);
+      wlc_output_schedule_repaint(get_output(surface));
+   }
+}
+
+bool
+wlc_surface_place_subsurface(struct wlc_surface *surface, struct wlc_surface *sibling, bool above)
+{
+   struct wlc_surface *parent;
+   if (!surface || !sibling || surface == sibling || !(parent = get_parent(surface)))
+      return false;
+
+   // Sibling may also be the parent itself
+   const wlc_resource s = (sibling == parent ? 0 : convert_to_wlc_resource(sibling));
+   if (s && sibling->parent != surface->parent)
+      return false;
+
+   const wlc_resource r = convert_to_wlc_resource(surface);
+   struct chck_iter_pool *tree = &parent->tree.pending;
+
+   size_t i;
+   if ((i = tree_index(tree, r)) == SIZE_MAX)
+      return false;
+
+   chck_iter_pool_remove(tree, i);
+
+   if ((i = tree_index(tree, s)) != SIZE_MAX && tree_insert(tree, (above ? i + 1 : i), r))
+      return true;
+
+   // Keep the sub-surface in the tree even if placing it failed
+   tree_insert(tree, SIZE_MAX, r);
+   return false;
+}
+
+void
+wlc_surface_get_subsurface_geometry(struct wlc_surface *parent, struct wlc_surface *child, const struct wlc_geometry *visible, struct wlc_geometry *out_geometry)
+{
+   assert(parent && child && visible && out_geometry);
+
+   // Sub-surfaces scale with the area their parent is painted to
+   const float sx = (parent->size.w ? (float)visible->size.w / parent->size.w : 1.0f);
+   const float sy = (parent->size.h ? (float)visible->size.h / parent->size.h : 1.0f);
+   out_geometry->origin.x = visible->origin.x + child->tree.position.x * sx;
+   out_geometry->origin.y = visible->origin.y + child->tree.position.y * sy;
+   out_geometry->size.w = child->size.w * sx;
+   out_geometry->size.h = child->size.h * sy;
 }
 
 void
@@ -286,7 +615,7 @@ wlc_surface_invalidate(struct wlc_surface *surface)
    if (!surface)
       return;
 
-   wlc_output_surface_destroy(convert_from_wlc_handle(surface->output, "output"), surface);
+   wlc_output_surface_destroy(convert_from_wlc_handle(surface->output, WLC_TYPE_OUTPUT), surface);
 }
 
 void
@@ -299,10 +628,27 @@ wlc_surface_release(struct wlc_surface *surface)
    wl_signal_emit(&wlc_system_signals()->surface, &ev);
 
    wlc_handle_release(surface->view);
+
+   // Sub-surfaces of destroyed parent are unmapped
+   wlc_resource *r;
+   while ((r = chck_iter_pool_get_last(&surface->tree.pending))) {
+      struct wlc_surface *child;
+      if (!*r || !(child = convert_from_wlc_resource(*r, WLC_TYPE_SURFACE)) || child->parent != convert_to_wlc_resource(surface)) {
+         chck_iter_pool_remove(&surface->tree.pending, surface->tree.pending.items.count - 1);
+         continue;
+      }
+
+      wlc_surface_set_parent(child, NULL);
+   }
+
+   wlc_surface_set_parent(surface, NULL);
    wlc_surface_invalidate(surface);
 
    release_state(&surface->commit);
    release_state(&surface->pending);
+   release_state(&surface->tree.cache);
+   chck_iter_pool_release(&surface->tree.pending);
+   chck_iter_pool_release(&surface->tree.current);
 
    wlc_source_release(&surface->buffers);
    wlc_source_release(&surface->callbacks);
@@ -313,12 +659,18 @@ wlc_surface(struct wlc_surface *surface)
 {
    assert(surface);
 
-   if (!wlc_source(&surface->buffers, "buffer", wlc_buffer, wlc_buffer_release, 4, sizeof(struct wlc_buffer)) ||
-       !wlc_source(&surface->callbacks, "callback", NULL, NULL, 4, sizeof(struct wlc_resource)))
+   if (!wlc_source(&surface->buffers, WLC_TYPE_BUFFER, wlc_buffer, wlc_buffer_release, 4, sizeof(struct wlc_buffer)) ||
+       !wlc_source(&surface->callbacks, WLC_TYPE_CALLBACK, NULL, NULL, 4, sizeof(struct wlc_resource)))
       goto fail;
 
    if (!chck_iter_pool(&surface->commit.frame_cbs, 4, 0, sizeof(wlc_resource)) ||
-       !chck_iter_pool(&surface->pending.frame_cbs, 4, 0, sizeof(wlc_resource)))
+       !chck_iter_pool(&surface->pending.frame_cbs, 4, 0, sizeof(wlc_resource)) ||
+       !chck_iter_pool(&surface->commit.feedbacks, 4, 0, sizeof(wlc_resource)) ||
+       !chck_iter_pool(&surface->pending.feedbacks, 4, 0, sizeof(wlc_resource)) ||
+       !chck_iter_pool(&surface->tree.cache.frame_cbs, 4, 0, sizeof(wlc_resource)) ||
+       !chck_iter_pool(&surface->tree.cache.feedbacks, 4, 0, sizeof(wlc_resource)) ||
+       !chck_iter_pool(&surface->tree.pending, 4, 0, sizeof(wlc_resource)) ||
+       !chck_iter_pool(&surface->tree.current, 4, 0, sizeof(wlc_resource)))
       goto fail;
 
    return true;
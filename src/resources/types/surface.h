@@ -14,6 +14,7 @@ struct wlc_view;
 
 struct wlc_surface_state {
    struct chck_iter_pool frame_cbs;
+   struct chck_iter_pool feedbacks; // wp_presentation_feedback for this content
    pixman_region32_t opaque;
    pixman_region32_t input;
    pixman_region32_t damage;
@@ -33,6 +34,25 @@ struct wlc_surface {
    /* Parent surface for subsurface interface */
    wlc_resource parent;
 
+   /* Sub-surface tree */
+   struct {
+      /**
+       * Sub-surfaces from bottom to top, 0 stands for this surface.
+       * Empty when there are no sub-surfaces, pending order is applied on commit.
+       */
+      struct chck_iter_pool pending, current;
+
+      /* Position relative to parent, applied on commit of parent */
+      struct wlc_origin pending_position, position;
+
+      /* Commits held back while synchronized */
+      struct wlc_surface_state cache;
+      bool cached;
+
+      /* Set on the root when anything in the tree moved, mapped or unmapped */
+      bool changed;
+   } tree;
+
    /* Set if this surface is bind to view */
    wlc_resource view;
 
@@ -51,6 +71,27 @@ struct wlc_surface {
     */
    void *images[3];
 
+   /**
+    * Size and format of the texture storage, used to reuse it across attaches.
+    * Managed by the renderer.
+    */
+   struct {
+      struct wlc_size size;
+      uint32_t format;
+   } storage;
+
+   /**
+    * Sampler filter each texture is currently set up with, 0 if not yet set.
+    * Managed by the renderer.
+    */
+   uint32_t filters[3];
+
+   /**
+    * Cache entry of the attached buffer the textures and images are borrowed from, NULL when they are the surface's own.
+    * Every borrowing surface holds a reference to the entry. Managed by the renderer.
+    */
+   void *cache;
+
    enum wlc_surface_format {
       SURFACE_RGB,
       SURFACE_RGBA,
@@ -67,6 +108,9 @@ struct wlc_buffer* wlc_surface_get_buffer(struct wlc_surface *surface);
 void wlc_surface_attach_to_view(struct wlc_surface *surface, struct wlc_view *view);
 bool wlc_surface_attach_to_output(struct wlc_surface *surface, struct wlc_output *output, struct wlc_buffer *buffer);
 void wlc_surface_set_parent(struct wlc_surface *surface, struct wlc_surface *parent);
+void wlc_surface_set_synchronized(struct wlc_surface *surface, bool synchronized);
+bool wlc_surface_place_subsurface(struct wlc_surface *surface, struct wlc_surface *sibling, bool above);
+WLC_NONULL void wlc_surface_get_subsurface_geometry(struct wlc_surface *parent, struct wlc_surface *child, const struct wlc_geometry *visible, struct wlc_geometry *out_geometry);
 void wlc_surface_invalidate(struct wlc_surface *surface);
 void wlc_surface_release(struct wlc_surface *surface);
 WLC_NONULL bool wlc_surface(struct wlc_surface *surface);
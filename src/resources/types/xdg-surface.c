@@ -17,10 +17,10 @@ xdg_cb_surface_set_parent(struct wl_client *client, struct wl_resource *resource
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
-   struct wlc_view *parent = (parent_resource ? convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(parent_resource), "view") : NULL);
+   struct wlc_view *parent = (parent_resource ? convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(parent_resource), WLC_TYPE_VIEW) : NULL);
    wlc_view_set_parent_ptr(view, parent);
 }
 
@@ -28,14 +28,14 @@ static void
 xdg_cb_surface_set_title(struct wl_client *client, struct wl_resource *resource, const char *title)
 {
    (void)client;
-   wlc_view_set_title_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view"), title);
+   wlc_view_set_title_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW), title);
 }
 
 static void
 xdg_cb_surface_set_app_id(struct wl_client *client, struct wl_resource *resource, const char *app_id)
 {
    (void)client;
-   wlc_view_set_app_id_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view"), app_id);
+   wlc_view_set_app_id_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW), app_id);
 }
 
 static void
@@ -91,7 +91,7 @@ xdg_cb_surface_set_window_geometry(struct wl_client *client, struct wl_resource
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    view->surface_pending.visible = (struct wlc_geometry){ { x, y }, { width, height } };
@@ -104,7 +104,7 @@ xdg_cb_surface_set_maximized(struct wl_client *client, struct wl_resource *resou
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    wlc_view_request_state(view, WLC_BIT_MAXIMIZED, true);
@@ -116,7 +116,7 @@ xdg_cb_surface_unset_maximized(struct wl_client *client, struct wl_resource *res
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    wlc_view_request_state(view, WLC_BIT_MAXIMIZED, false);
@@ -128,14 +128,14 @@ xdg_cb_surface_set_fullscreen(struct wl_client *client, struct wl_resource *reso
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    if (!wlc_view_request_state(view, WLC_BIT_FULLSCREEN, true))
       return;
 
    struct wlc_output *output;
-   if (output_resource && ((output = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(output_resource), "output"))))
+   if (output_resource && ((output = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(output_resource), WLC_TYPE_OUTPUT))))
       wlc_view_set_output_ptr(view, output);
 }
 
@@ -145,7 +145,7 @@ xdg_cb_surface_unset_fullscreen(struct wl_client *client, struct wl_resource *re
    (void)client;
 
    struct wlc_view *view;
-   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view")))
+   if (!(view = convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW)))
       return;
 
    wlc_view_request_state(view, WLC_BIT_FULLSCREEN, false);
@@ -155,7 +155,7 @@ static void
 xdg_cb_surface_set_minimized(struct wl_client *client, struct wl_resource *resource)
 {
    (void)client;
-   wlc_view_set_minimized_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), "view"), true);
+   wlc_view_set_minimized_ptr(convert_from_wlc_handle((wlc_handle)wl_resource_get_user_data(resource), WLC_TYPE_VIEW), true);
 }
 
 WLC_CONST const struct xdg_surface_interface*
@@ -51,8 +51,8 @@ wlc_log(enum wlc_log_type type, const char *fmt, ...)
    va_end(argp);
 }
 
-void
-wlc_dlog(enum wlc_debug dbg, const char *fmt, ...)
+bool
+wlc_dlog_enabled(enum wlc_debug dbg)
 {
    static struct {
       const char *name;
@@ -67,6 +67,7 @@ wlc_dlog(enum wlc_debug dbg, const char *fmt, ...)
       { "keyboard", false, false },
       { "commit", false, false },
       { "request", false, false },
+      { "gl", false, false },
    };
 
    if (!channels[dbg].checked) {
@@ -74,12 +75,18 @@ wlc_dlog(enum wlc_debug dbg, const char *fmt, ...)
       const char *s = getenv("WLC_DEBUG");
       for (size_t len = strlen(name); s && *s && !chck_cstrneq(s, name, len); s += strcspn(s, ",") + 1);
       channels[dbg].checked = true;
-      if (!(channels[dbg].active = (s && *s != 0)))
-         return;
-   } else if (!channels[dbg].active) {
-      return;
+      channels[dbg].active = (s && *s != 0);
    }
 
+   return channels[dbg].active;
+}
+
+void
+wlc_dlog(enum wlc_debug dbg, const char *fmt, ...)
+{
+   if (!wlc_dlog_enabled(dbg))
+      return;
+
    va_list argp;
    va_start(argp, fmt);
    wlc_vlog(WLC_LOG_INFO, fmt, argp);
@@ -297,6 +304,8 @@ wlc_init(const struct wlc_interface *interface, int argc, char *argv[])
 
    unsetenv("TERM");
    const char *x11display = getenv("DISPLAY");
+   const char *backend = getenv("WLC_BACKEND");
+   const bool headless = (backend && chck_cstreq(backend, "headless"));
    bool privileged = false;
    const bool has_logind = wlc_logind_available();
 
@@ -305,7 +314,7 @@ wlc_init(const struct wlc_interface *interface, int argc, char *argv[])
       privileged = true;
    } else if (getuid() == 0) {
       die("Do not run wlc compositor as root");
-   } else if (!x11display && !has_logind && access("/dev/input/event0", R_OK | W_OK) != 0) {
+   } else if (!x11display && !headless && !has_logind && access("/dev/input/event0", R_OK | W_OK) != 0) {
       die("Not running from X11 and no access to /dev/input/event0 or logind available");
    }
 
@@ -314,7 +323,7 @@ wlc_init(const struct wlc_interface *interface, int argc, char *argv[])
 #ifdef HAS_LOGIND
    // Init logind if we are not running as SUID.
    // We need event loop for logind to work, and thus we won't allow it on SUID process.
-   if (!privileged && !x11display && has_logind) {
+   if (!privileged && !x11display && !headless && has_logind) {
       if (!(wlc.display = wl_display_create()))
          die("Failed to create wayland display");
       if (!(vt = wlc_logind_init("seat0")))
@@ -324,7 +333,7 @@ wlc_init(const struct wlc_interface *interface, int argc, char *argv[])
    (void)privileged;
 #endif
 
-   if (!x11display)
+   if (!x11display && !headless)
       wlc_tty_init(vt);
 
    // -- we open tty before dropping permissions
@@ -367,11 +376,16 @@ wlc_init(const struct wlc_interface *interface, int argc, char *argv[])
    if (wl_display_init_shm(wlc.display) != 0)
       die("Failed to init shm");
 
-   if (!wlc_udev_init())
+   // Packed video format is converted to RGB by the renderer.
+   // Planar formats are left out, wl_shm only validates the pool for stride * height and chroma planes lie past that.
+   wl_display_add_shm_format(wlc.display, WL_SHM_FORMAT_YUYV);
+
+   // Headless has no devices to watch
+   if (!headless && !wlc_udev_init())
       die("Failed to init udev");
 
    const char *libinput = getenv("WLC_LIBINPUT");
-   if (!x11display || (libinput && !chck_cstreq(libinput, "0"))) {
+   if (!headless && (!x11display || (libinput && !chck_cstreq(libinput, "0")))) {
       if (!wlc_input_init())
          die("Failed to init input");
    }
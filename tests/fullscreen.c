@@ -70,9 +70,8 @@ compositor_main(int argc, char *argv[])
       },
    };
 
-   // This causes nouveau to hang at quit.
-   // Comment out until headless backend is added.
-   // setenv("WLC_OUTPUTS", "2", true);
+   setenv("WLC_BACKEND", "headless", true);
+   setenv("WLC_OUTPUTS", "2", true);
    view_moved_to_output = true;
 
    compositor_test_create(&compositor, argc, argv, "fullscreen", &interface);